@@ -0,0 +1,28 @@
+#include "backoff.h"
+
+void backoff_init(backoff_t *backoff, uint32_t base_ms, uint32_t max_ms) {
+    backoff->base_ms = base_ms;
+    backoff->max_ms = max_ms < base_ms ? base_ms : max_ms;
+    backoff->attempt = 0;
+}
+
+void backoff_reset(backoff_t *backoff) {
+    backoff->attempt = 0;
+}
+
+uint32_t backoff_next(backoff_t *backoff, uint32_t random) {
+    uint32_t delay = backoff->base_ms;
+    for (uint32_t i = 0; i < backoff->attempt && delay < backoff->max_ms;
+         i++) {
+        delay *= 2;
+    }
+    if (delay >= backoff->max_ms) {
+        // Stop counting once capped so attempt cannot overflow
+        delay = backoff->max_ms;
+    } else {
+        backoff->attempt++;
+    }
+
+    uint32_t half = delay / 2;
+    return half + random % (delay - half + 1);
+}
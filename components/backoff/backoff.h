@@ -0,0 +1,24 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/* Capped exponential backoff with "equal jitter": attempt n waits a
+ * random time in [d/2, d] with d = min(max_ms, base_ms * 2^n), so clients
+ * dropped together by one broker or AP restart do not retry in lockstep.
+ * Plain C so it also builds on the host. */
+typedef struct {
+    uint32_t base_ms;
+    uint32_t max_ms;
+    uint32_t attempt;
+} backoff_t;
+
+void backoff_init(backoff_t *backoff, uint32_t base_ms, uint32_t max_ms);
+
+// Call after a successful connection
+void backoff_reset(backoff_t *backoff);
+
+// Delay before the next attempt; random is any uniform 32-bit value
+uint32_t backoff_next(backoff_t *backoff, uint32_t random);
+
+#endif  // BACKOFF_H
@@ -0,0 +1,106 @@
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+
+#define RENDER_BUF_SIZE 512
+
+static metric_t *registry_head = NULL;
+static metric_t **registry_tail = &registry_head;
+static portMUX_TYPE registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void metrics_register(metric_t *metric) {
+    taskENTER_CRITICAL(&registry_lock);
+    bool registered = metric->next != NULL || registry_tail == &metric->next;
+    if (!registered) {
+        // Append so metrics render in registration order
+        *registry_tail = metric;
+        registry_tail = &metric->next;
+    }
+    taskEXIT_CRITICAL(&registry_lock);
+}
+
+typedef struct {
+    char buf[RENDER_BUF_SIZE];
+    size_t len;
+    int error;
+    metrics_emit_fn_t emit;
+    void *ctx;
+} render_t;
+
+static void render_flush(render_t *r) {
+    if (r->len > 0 && r->error == 0) {
+        r->error = r->emit(r->ctx, r->buf, r->len);
+    }
+    r->len = 0;
+}
+
+static void render_line(render_t *r, const char *fmt, ...) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(&r->buf[r->len], sizeof(r->buf) - r->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < sizeof(r->buf) - r->len) {
+            r->len += n;
+            return;
+        }
+        // Did not fit: send what is buffered and retry on an empty buffer
+        render_flush(r);
+    }
+}
+
+static void render_metric(render_t *r, metric_t *m) {
+    static const char *type_names[] = {
+        [METRIC_TYPE_COUNTER] = "counter",
+        [METRIC_TYPE_GAUGE] = "gauge",
+        [METRIC_TYPE_HISTOGRAM] = "histogram",
+    };
+    render_line(r, "# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name,
+                type_names[m->type]);
+
+    uint32_t value = atomic_load_explicit(&m->value, memory_order_relaxed);
+    switch (m->type) {
+        case METRIC_TYPE_COUNTER:
+            render_line(r, "%s %lu\n", m->name, (unsigned long)value);
+            break;
+        case METRIC_TYPE_GAUGE:
+            render_line(r, "%s %ld\n", m->name, (long)(int32_t)value);
+            break;
+        case METRIC_TYPE_HISTOGRAM: {
+            // Buckets are read one by one, so a scrape racing an update may
+            // be off by that one sample
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < m->bucket_count; i++) {
+                cumulative += atomic_load_explicit(&m->buckets[i],
+                                                   memory_order_relaxed);
+                render_line(r, "%s_bucket{le=\"%lu\"} %llu\n", m->name,
+                            (unsigned long)m->bounds[i],
+                            (unsigned long long)cumulative);
+            }
+            cumulative += atomic_load_explicit(&m->buckets[m->bucket_count],
+                                               memory_order_relaxed);
+            render_line(r, "%s_bucket{le=\"+Inf\"} %llu\n", m->name,
+                        (unsigned long long)cumulative);
+            render_line(r, "%s_sum %lu\n%s_count %llu\n", m->name,
+                        (unsigned long)atomic_load_explicit(
+                            &m->sum, memory_order_relaxed),
+                        m->name, (unsigned long long)cumulative);
+            break;
+        }
+    }
+}
+
+int metrics_render_prometheus(metrics_emit_fn_t emit, void *ctx) {
+    render_t r = {.len = 0, .error = 0, .emit = emit, .ctx = ctx};
+
+    // Metrics are only ever appended, so the list can be walked unlocked
+    for (metric_t *m = registry_head; m != NULL && r.error == 0; m = m->next) {
+        render_metric(&r, m);
+    }
+    render_flush(&r);
+    return r.error;
+}
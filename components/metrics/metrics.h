@@ -0,0 +1,99 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+
+/* Lock-free runtime metrics. Counters, gauges and histograms are static
+ * objects owned by the module that updates them; every update is a single
+ * relaxed 32-bit atomic (two for a histogram: bucket and sum), which is
+ * safe from tasks and ISRs on both cores. Metrics are registered once with
+ * metrics_register() and rendered in Prometheus text format. */
+
+typedef enum {
+    METRIC_TYPE_COUNTER,
+    METRIC_TYPE_GAUGE,
+    METRIC_TYPE_HISTOGRAM,
+} metric_type_t;
+
+typedef struct metric {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+    struct metric *next;
+    _Atomic uint32_t value;  // counter, or gauge as int32_t bits
+    // Histogram only: bucket_count upper bounds, buckets has one more for +Inf
+    const uint32_t *bounds;
+    size_t bucket_count;
+    _Atomic uint32_t *buckets;
+    _Atomic uint32_t sum;
+} metric_t;
+
+#define METRIC_COUNTER(var, metric_name, metric_help)            \
+    static metric_t var = {.name = (metric_name),                \
+                           .help = (metric_help),                \
+                           .type = METRIC_TYPE_COUNTER}
+
+#define METRIC_GAUGE(var, metric_name, metric_help)              \
+    static metric_t var = {.name = (metric_name),                \
+                           .help = (metric_help),                \
+                           .type = METRIC_TYPE_GAUGE}
+
+/* Bucket upper bounds must be ascending, e.g.
+ * METRIC_HISTOGRAM(h, ..., 10, 100). They live in DRAM, not flash rodata,
+ * so metric_observe() still works from an IRAM ISR while the flash cache
+ * is off (during a flash erase or write). */
+#define METRIC_HISTOGRAM(var, metric_name, metric_help, ...)               \
+    DRAM_ATTR static const uint32_t var##_bounds[] = {__VA_ARGS__};        \
+    static _Atomic uint32_t                                                \
+        var##_buckets[sizeof(var##_bounds) / sizeof(uint32_t) + 1];        \
+    static metric_t var = {                                                \
+        .name = (metric_name),                                             \
+        .help = (metric_help),                                             \
+        .type = METRIC_TYPE_HISTOGRAM,                                     \
+        .bounds = var##_bounds,                                            \
+        .bucket_count = sizeof(var##_bounds) / sizeof(uint32_t),           \
+        .buckets = var##_buckets,                                          \
+    }
+
+// Adds the metric to the registry; calling it again is a no-op
+void metrics_register(metric_t *metric);
+
+/* Always inlined so IRAM ISRs never call into flash to update a metric */
+
+static inline __attribute__((always_inline)) void metric_inc(
+    metric_t *m) {
+    atomic_fetch_add_explicit(&m->value, 1, memory_order_relaxed);
+}
+
+static inline __attribute__((always_inline)) void metric_add(
+    metric_t *m, uint32_t n) {
+    atomic_fetch_add_explicit(&m->value, n, memory_order_relaxed);
+}
+
+static inline __attribute__((always_inline)) void metric_set(
+    metric_t *m, int32_t v) {
+    atomic_store_explicit(&m->value, (uint32_t)v, memory_order_relaxed);
+}
+
+static inline __attribute__((always_inline)) void metric_observe(
+    metric_t *m, uint32_t v) {
+    size_t i = 0;
+    while (i < m->bucket_count && v > m->bounds[i]) {
+        i++;
+    }
+    atomic_fetch_add_explicit(&m->buckets[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->sum, v, memory_order_relaxed);
+}
+
+// Receives rendered text; returns 0 on success, anything else stops output
+typedef int (*metrics_emit_fn_t)(void *ctx, const char *buf, size_t len);
+
+/* Renders every registered metric in Prometheus text exposition format,
+ * batched through a small internal buffer. Returns the first emit error. */
+int metrics_render_prometheus(metrics_emit_fn_t emit, void *ctx);
+
+#endif  // METRICS_H
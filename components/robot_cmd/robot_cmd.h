@@ -0,0 +1,72 @@
+#ifndef ROBOT_CMD_H
+#define ROBOT_CMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fixed-layout binary command frame, little-endian:
+ *
+ *   offset  size  field
+ *   0       1     opcode
+ *   1       1     payload length (0..ROBOT_CMD_MAX_PAYLOAD)
+ *   2       2     sequence number
+ *   4       4     sender timestamp (us)
+ *   8       16    payload, zero padded
+ *   24      2     CRC-16/CCITT-FALSE over bytes 0..23
+ *
+ * Plain C with no ESP-IDF dependencies so it also builds on the host. */
+#define ROBOT_CMD_MAX_PAYLOAD 16
+#define ROBOT_CMD_FRAME_SIZE 26
+
+typedef enum {
+    ROBOT_CMD_NOP = 0,
+    ROBOT_CMD_STOP = 1,
+    ROBOT_CMD_DRIVE = 2,  // payload: int16 left, int16 right (-1023..1023)
+    ROBOT_CMD_WIFI_PROFILE = 3,  // payload: uint8 wifi_profile_t
+    ROBOT_CMD_OP_COUNT
+} robot_cmd_opcode_t;
+
+typedef enum {
+    ROBOT_CMD_OK = 0,
+    ROBOT_CMD_ERR_LENGTH,
+    ROBOT_CMD_ERR_CRC,
+    ROBOT_CMD_ERR_OPCODE,
+    ROBOT_CMD_STATUS_COUNT
+} robot_cmd_status_t;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t payload_len;
+    uint16_t seq;
+    uint32_t timestamp_us;
+    uint8_t payload[ROBOT_CMD_MAX_PAYLOAD];
+} robot_cmd_t;
+
+typedef void (*robot_cmd_handler_t)(const robot_cmd_t *cmd, void *ctx);
+
+/* Opcode-indexed handler table, meant to be a static const with designated
+ * initializers. Opcodes without a handler are rejected. */
+typedef struct {
+    robot_cmd_handler_t handlers[ROBOT_CMD_OP_COUNT];
+    void *ctx;
+} robot_cmd_table_t;
+
+uint16_t robot_cmd_crc16(const uint8_t *data, size_t len);
+
+// Writes exactly ROBOT_CMD_FRAME_SIZE bytes into buf
+void robot_cmd_encode(const robot_cmd_t *cmd, uint8_t *buf);
+
+robot_cmd_status_t robot_cmd_decode(const uint8_t *buf, size_t len,
+                                    robot_cmd_t *cmd);
+
+// Calls the table handler for an already decoded command
+robot_cmd_status_t robot_cmd_handle(const robot_cmd_table_t *table,
+                                    const robot_cmd_t *cmd);
+
+// Decodes the frame and calls its handler from the table
+robot_cmd_status_t robot_cmd_dispatch(const robot_cmd_table_t *table,
+                                      const uint8_t *buf, size_t len);
+
+const char *robot_cmd_status_str(robot_cmd_status_t status);
+
+#endif  // ROBOT_CMD_H
@@ -0,0 +1,110 @@
+#include "robot_cmd_seq.h"
+
+#include <string.h>
+
+static robot_cmd_sender_t *find_sender(robot_cmd_seq_t *seq,
+                                       uint64_t sender_id) {
+    robot_cmd_sender_t *oldest = &seq->senders[0];
+    for (int i = 0; i < ROBOT_CMD_SEQ_MAX_SENDERS; i++) {
+        robot_cmd_sender_t *sender = &seq->senders[i];
+        if (sender->active && sender->id == sender_id) {
+            return sender;
+        }
+        if (!sender->active) {
+            oldest = sender;
+        } else if (oldest->active &&
+                   sender->last_seen_us < oldest->last_seen_us) {
+            oldest = sender;
+        }
+    }
+
+    // Unknown sender: reuse a free slot or evict the least recently seen
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->id = sender_id;
+    return oldest;
+}
+
+static void resync(robot_cmd_sender_t *sender, const robot_cmd_t *cmd,
+                   uint32_t delta, int64_t now_us) {
+    sender->active = true;
+    sender->last_seq = cmd->seq;
+    sender->last_tx_us = cmd->timestamp_us;
+    sender->delta_min_prev = delta;
+    sender->delta_min_cur = delta;
+    sender->epoch_start_us = now_us;
+}
+
+static uint32_t one_way_latency(robot_cmd_sender_t *sender, uint32_t delta,
+                                int64_t now_us) {
+    if (now_us - sender->epoch_start_us >= ROBOT_CMD_SEQ_EPOCH_US) {
+        // Start a new epoch so clock drift cannot skew the baseline forever
+        sender->delta_min_prev = sender->delta_min_cur;
+        sender->delta_min_cur = delta;
+        sender->epoch_start_us = now_us;
+    } else if ((int32_t)(delta - sender->delta_min_cur) < 0) {
+        sender->delta_min_cur = delta;
+    }
+
+    uint32_t base = sender->delta_min_cur;
+    if ((int32_t)(sender->delta_min_prev - base) < 0) {
+        base = sender->delta_min_prev;
+    }
+    return delta - base;
+}
+
+robot_cmd_seq_verdict_t robot_cmd_seq_check(robot_cmd_seq_t *seq,
+                                            uint64_t sender_id,
+                                            const robot_cmd_t *cmd,
+                                            int64_t now_us,
+                                            uint32_t *one_way_us) {
+    robot_cmd_sender_t *sender = find_sender(seq, sender_id);
+    uint32_t delta = (uint32_t)now_us - cmd->timestamp_us;
+
+    if (!sender->active ||
+        now_us - sender->last_seen_us >= ROBOT_CMD_SEQ_IDLE_US) {
+        if (sender->active) {
+            seq->resyncs++;
+        }
+        resync(sender, cmd, delta, now_us);
+        sender->last_seen_us = now_us;
+        seq->accepted++;
+        *one_way_us = 0;
+        return ROBOT_CMD_SEQ_ACCEPT;
+    }
+
+    int16_t diff = (int16_t)(cmd->seq - sender->last_seq);
+    if (diff == 0) {
+        seq->duplicate++;
+        return ROBOT_CMD_SEQ_DUPLICATE;
+    }
+    // A late frame was sent before the last applied one; a restarted
+    // sender's clock has moved on, or its count starts over
+    bool restarted =
+        diff < 0 &&
+        ((int32_t)(cmd->timestamp_us - sender->last_tx_us) >= 0 ||
+         (cmd->seq == 0 && diff < -ROBOT_CMD_SEQ_WINDOW));
+    if (diff < 0 && !restarted) {
+        // A newer command has already been applied
+        seq->stale++;
+        if (diff >= -ROBOT_CMD_SEQ_WINDOW) {
+            seq->reordered++;
+            if (seq->lost > 0) {
+                seq->lost--;
+            }
+        }
+        return ROBOT_CMD_SEQ_STALE;
+    }
+
+    if (restarted) {
+        seq->resyncs++;
+        resync(sender, cmd, delta, now_us);
+    } else {
+        seq->lost += diff - 1;
+        sender->last_seq = cmd->seq;
+        sender->last_tx_us = cmd->timestamp_us;
+    }
+    sender->last_seen_us = now_us;
+    seq->accepted++;
+    *one_way_us = one_way_latency(sender, delta, now_us);
+    return ROBOT_CMD_SEQ_ACCEPT;
+}
@@ -0,0 +1,58 @@
+#ifndef ROBOT_CMD_SEQ_H
+#define ROBOT_CMD_SEQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "robot_cmd.h"
+
+/* Per-sender sequence tracking. Only commands newer than the last applied
+ * one from the same sender are accepted; anything behind it is a late
+ * frame and is dropped (counted as reordered when within
+ * ROBOT_CMD_SEQ_WINDOW). A sender resynchronises after
+ * ROBOT_CMD_SEQ_IDLE_US of silence, or when a frame behind it shows a
+ * restart: a sender timestamp not older than the last applied one, or seq
+ * 0 from outside the window. */
+#define ROBOT_CMD_SEQ_MAX_SENDERS 4
+#define ROBOT_CMD_SEQ_WINDOW 64
+#define ROBOT_CMD_SEQ_IDLE_US 1000000
+#define ROBOT_CMD_SEQ_EPOCH_US 10000000  // clock offset re-estimation period
+
+typedef enum {
+    ROBOT_CMD_SEQ_ACCEPT = 0,
+    ROBOT_CMD_SEQ_STALE,
+    ROBOT_CMD_SEQ_DUPLICATE,
+} robot_cmd_seq_verdict_t;
+
+typedef struct {
+    uint64_t id;
+    bool active;
+    uint16_t last_seq;
+    uint32_t last_tx_us;  // sender clock, of the last applied frame
+    int64_t last_seen_us;
+    // Minimum (rx - tx) clock delta over the previous and current epoch
+    uint32_t delta_min_prev;
+    uint32_t delta_min_cur;
+    int64_t epoch_start_us;
+} robot_cmd_sender_t;
+
+typedef struct {
+    robot_cmd_sender_t senders[ROBOT_CMD_SEQ_MAX_SENDERS];
+    uint32_t accepted;
+    uint32_t stale;
+    uint32_t duplicate;
+    uint32_t lost;       // sequence gaps not (yet) filled by late frames
+    uint32_t reordered;  // late frames that arrived after a newer one
+    uint32_t resyncs;
+} robot_cmd_seq_t;
+
+/* Checks cmd from sender_id received at now_us (receiver clock). On
+ * ACCEPT, *one_way_us is the one-way latency above the best case seen from
+ * that sender, since sender and receiver clocks are not synchronised. */
+robot_cmd_seq_verdict_t robot_cmd_seq_check(robot_cmd_seq_t *seq,
+                                            uint64_t sender_id,
+                                            const robot_cmd_t *cmd,
+                                            int64_t now_us,
+                                            uint32_t *one_way_us);
+
+#endif  // ROBOT_CMD_SEQ_H
@@ -0,0 +1,240 @@
+#include "sensor_log.h"
+
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+static const char *TAG = "sensor log";
+
+static struct {
+    sensor_log_config_t config;
+    const esp_partition_t *partition;
+    sensor_log_ring_t ring;
+    TaskHandle_t task;
+    bool running;
+    _Atomic bool flush;
+
+    // Flush task only
+    sensor_log_page_t page;
+    uint32_t sector;  // where the page goes
+    uint32_t last_dropped;
+
+    // Guards the stats
+    portMUX_TYPE lock;
+    sensor_log_stats_t stats;
+} s_log = {.lock = portMUX_INITIALIZER_UNLOCKED};
+
+/* Finds where the previous boot stopped: the page with the highest
+ * sequence number. Only headers are read; a page torn by a reset still
+ * counts, and the decoder drops it on its CRC. */
+static void resume(uint32_t *seq, uint32_t *boot) {
+    uint32_t sectors = s_log.stats.sectors;
+    bool found = false;
+    *seq = 0;
+    *boot = 0;
+    s_log.sector = 0;
+    for (uint32_t i = 0; i < sectors; i++) {
+        sensor_log_page_header_t h;
+        if (esp_partition_read(s_log.partition, i * SENSOR_LOG_PAGE_SIZE, &h,
+                               sizeof(h)) != ESP_OK ||
+            h.magic != SENSOR_LOG_MAGIC) {
+            continue;
+        }
+        if (!found || h.seq >= *seq) {
+            *seq = h.seq + 1;
+            s_log.sector = (i + 1) % sectors;
+        }
+        if (!found || h.boot >= *boot) {
+            *boot = h.boot + 1;
+        }
+        found = true;
+    }
+}
+
+static void write_page(void) {
+    sensor_log_page_finish(&s_log.page);
+    size_t offset = (size_t)s_log.sector * SENSOR_LOG_PAGE_SIZE;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(s_log.partition, offset,
+                                              SENSOR_LOG_PAGE_SIZE);
+    if (err == ESP_OK) {
+        // The rest of the sector stays erased
+        err = esp_partition_write(s_log.partition, offset, s_log.page.buf,
+                                  s_log.page.used);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write sector %lu: %s",
+                 (unsigned long)s_log.sector, esp_err_to_name(err));
+    }
+
+    uint32_t dropped =
+        atomic_load_explicit(&s_log.ring.dropped, memory_order_relaxed);
+    portENTER_CRITICAL(&s_log.lock);
+    if (err == ESP_OK) {
+        s_log.stats.records += s_log.page.records;
+        s_log.stats.pages++;
+        s_log.stats.bytes += s_log.page.used;
+    } else {
+        s_log.stats.flash_errors++;
+    }
+    s_log.stats.flash_us += elapsed;
+    s_log.stats.dropped = dropped;
+    s_log.stats.ring_high_water = s_log.ring.high_water;
+    s_log.stats.seq++;
+    portEXIT_CRITICAL(&s_log.lock);
+
+    // A failed sector is skipped rather than retried, so one bad sector
+    // cannot stall the log
+    s_log.sector = (s_log.sector + 1) % s_log.stats.sectors;
+    uint32_t lost = dropped - s_log.last_dropped;
+    sensor_log_page_begin(&s_log.page, s_log.stats.seq, s_log.stats.boot,
+                          lost > UINT16_MAX ? UINT16_MAX : (uint16_t)lost);
+    s_log.last_dropped = dropped;
+}
+
+static void flush_task(void *arg) {
+    sensor_log_record_t rec;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_log.config.drain_ms));
+        while (sensor_log_ring_peek(&s_log.ring, &rec)) {
+            if (!sensor_log_page_add(&s_log.page, &rec)) {
+                write_page();  // the record starts the next page
+                continue;
+            }
+            sensor_log_ring_pop(&s_log.ring);
+        }
+
+        if (s_log.page.records == 0) {
+            continue;
+        }
+        const sensor_log_page_header_t *h =
+            (const sensor_log_page_header_t *)s_log.page.buf;
+        bool stale = s_log.config.max_page_age_ms > 0 &&
+                     esp_timer_get_time() - h->base_us >=
+                         (int64_t)s_log.config.max_page_age_ms * 1000;
+        if (atomic_exchange(&s_log.flush, false) || stale) {
+            write_page();
+        }
+    }
+}
+
+esp_err_t sensor_log_start(const sensor_log_config_t *config) {
+    if (s_log.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_log.partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+        config->partition_label);
+    if (s_log.partition == NULL) {
+        ESP_LOGE(TAG, "No \"%s\" partition in the partition table",
+                 config->partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t sectors = s_log.partition->size / SENSOR_LOG_PAGE_SIZE;
+    if (sectors < 2) {
+        ESP_LOGE(TAG, "Partition \"%s\" is too small",
+                 config->partition_label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Internal RAM, so ISRs can log while the flash cache is off
+    void *buf = heap_caps_malloc(config->ring_size,
+                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!sensor_log_ring_init(&s_log.ring, buf, config->ring_size)) {
+        ESP_LOGE(TAG, "Ring size %u is not a power of two >= 1024",
+                 (unsigned)config->ring_size);
+        heap_caps_free(buf);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_log.config = *config;
+    memset(&s_log.stats, 0, sizeof(s_log.stats));
+    s_log.stats.sectors = sectors;
+    s_log.stats.ring_size = config->ring_size;
+    resume(&s_log.stats.seq, &s_log.stats.boot);
+    s_log.last_dropped = 0;
+    sensor_log_page_begin(&s_log.page, s_log.stats.seq, s_log.stats.boot, 0);
+    atomic_init(&s_log.flush, false);
+
+    if (xTaskCreatePinnedToCore(flush_task, "sensor log", 3072, NULL,
+                                config->task_priority, &s_log.task,
+                                config->task_core) != pdPASS) {
+        heap_caps_free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+    s_log.running = true;
+    ESP_LOGI(TAG, "Logging to \"%s\": %lu sectors, boot %lu, from page %lu",
+             config->partition_label, (unsigned long)sectors,
+             (unsigned long)s_log.stats.boot,
+             (unsigned long)s_log.stats.seq);
+    return ESP_OK;
+}
+
+bool IRAM_ATTR sensor_log_write(uint8_t source, int64_t t_us,
+                                const void *payload, size_t len) {
+    if (!s_log.running) {
+        return false;
+    }
+    return sensor_log_ring_put(&s_log.ring, source, t_us, payload, len);
+}
+
+void sensor_log_flush(void) {
+    if (s_log.running) {
+        atomic_store(&s_log.flush, true);
+        xTaskNotifyGive(s_log.task);
+    }
+}
+
+void sensor_log_get_stats(sensor_log_stats_t *stats) {
+    portENTER_CRITICAL(&s_log.lock);
+    *stats = s_log.stats;
+    portEXIT_CRITICAL(&s_log.lock);
+    // Drops are counted by the producers, so read them live
+    if (s_log.running) {
+        stats->dropped = atomic_load_explicit(&s_log.ring.dropped,
+                                              memory_order_relaxed);
+    }
+}
+
+void sensor_log_print_stats(void) {
+    static sensor_log_stats_t last;
+    static int64_t last_us;
+    sensor_log_stats_t stats;
+    sensor_log_get_stats(&stats);
+    int64_t now = esp_timer_get_time();
+    float elapsed_s = (now - last_us) / 1e6f;
+    uint64_t flash_us = stats.flash_us - last.flash_us;
+    uint32_t pages = stats.pages - last.pages;
+
+    ESP_LOGI(TAG, "%.0f records/s, %.1f KB/s to flash, dropped %lu (+%lu), "
+             "ring peak %lu/%lu B",
+             (stats.records - last.records) / elapsed_s,
+             (stats.bytes - last.bytes) / 1024.0f / elapsed_s,
+             (unsigned long)stats.dropped,
+             (unsigned long)(stats.dropped - last.dropped),
+             (unsigned long)stats.ring_high_water,
+             (unsigned long)stats.ring_size);
+    if (pages > 0) {
+        // Full pages back to back, at this interval's cost per page
+        ESP_LOGI(TAG, "Flash: %.1f ms/page, sustains %.0f KB/s, "
+                 "%.1f%% busy, page %lu (lap %lu of %lu sectors), "
+                 "errors %lu",
+                 flash_us / 1000.0f / pages,
+                 SENSOR_LOG_PAGE_SIZE * 1e6f / 1024.0f * pages / flash_us,
+                 flash_us / 1e4f / elapsed_s, (unsigned long)stats.seq,
+                 (unsigned long)(stats.seq / stats.sectors),
+                 (unsigned long)stats.sectors,
+                 (unsigned long)stats.flash_errors);
+    }
+    last = stats;
+    last_us = now;
+}
@@ -0,0 +1,78 @@
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "sensor_log_core.h"
+
+/* Binary sensor log on a dedicated flash partition. Producers append
+ * timestamped records to a RAM ring without locks or text formatting;
+ * a low-priority task moves them into 4 KB pages and writes each full
+ * page to the next sector of the partition, which it walks as a circle so
+ * every sector is erased once per lap, the oldest data being overwritten
+ * first. On start the task resumes after the newest page, so the log
+ * survives resets. Read it back with
+ *
+ *   parttool.py read_partition --partition-name sensorlog --output log.bin
+ *   tools/sensor_log_decode.py log.bin > log.csv
+ *
+ * While a sector is being erased or written the flash cache is off, and
+ * code running from flash on either core waits; the ring must hold what
+ * the producers log meanwhile. */
+typedef struct {
+    const char *partition_label;
+    size_t ring_size;  // bytes, a power of two
+    UBaseType_t task_priority;
+    BaseType_t task_core;
+    uint32_t drain_ms;         // how often the task empties the ring
+    uint32_t max_page_age_ms;  // write a partly filled page this old; 0 never
+} sensor_log_config_t;
+
+#define SENSOR_LOG_DEFAULT_CONFIG()                                  \
+    {                                                                \
+        .partition_label = CONFIG_SENSOR_LOG_PARTITION,              \
+        .ring_size = CONFIG_SENSOR_LOG_RING_SIZE,                    \
+        .task_priority = CONFIG_SENSOR_LOG_TASK_PRIORITY,            \
+        .task_core = tskNO_AFFINITY,                                 \
+        .drain_ms = CONFIG_SENSOR_LOG_DRAIN_MS,                      \
+        .max_page_age_ms = CONFIG_SENSOR_LOG_MAX_PAGE_AGE_S * 1000u, \
+    }
+
+esp_err_t sensor_log_start(const sensor_log_config_t *config);
+
+/* From any task or ISR, never blocks. False when the record was dropped:
+ * the ring is full, the payload is longer than SENSOR_LOG_MAX_PAYLOAD, or
+ * the log is not running. */
+bool sensor_log_write(uint8_t source, int64_t t_us, const void *payload,
+                      size_t len);
+
+// Has the task write the partly filled page on its next pass
+void sensor_log_flush(void);
+
+// Counters since sensor_log_start()
+typedef struct {
+    uint32_t records;  // in pages written to flash
+    uint32_t dropped;  // ring full or payload too long
+    uint32_t pages;
+    uint32_t flash_errors;
+    uint64_t bytes;     // written to flash, page headers included
+    uint64_t flash_us;  // spent erasing and writing
+    uint32_t ring_size;
+    uint32_t ring_high_water;  // most bytes waiting at once
+    uint32_t seq;              // of the next page
+    uint32_t boot;
+    uint32_t sectors;  // in the partition
+} sensor_log_stats_t;
+
+void sensor_log_get_stats(sensor_log_stats_t *stats);
+
+/* Logs throughput and drops since the previous call: record and byte
+ * rates, how fast the flash would sustain at the measured write cost, and
+ * the ring's peak fill */
+void sensor_log_print_stats(void);
+
+#endif  // SENSOR_LOG_H
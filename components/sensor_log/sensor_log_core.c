@@ -0,0 +1,204 @@
+#include "sensor_log_core.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#else  // host builds (tools/sensor_log_bench.c)
+#define IRAM_ATTR
+#endif
+
+/* An entry in the ring; the payload follows, padded to 4 bytes. word is
+ * zero until the producer is done, then the entry size, and it is written
+ * last. A pad entry fills the end of the buffer when a record would not
+ * fit before the wrap. */
+typedef struct {
+    _Atomic uint32_t word;
+    uint8_t source;
+    uint8_t len;
+    uint16_t reserved;
+    uint32_t t_us[2];  // split so entries need only 4-byte alignment
+} entry_t;
+
+#define ENTRY_SIZE_MASK 0xFFFF
+#define ENTRY_PAD 0x10000
+
+static inline entry_t *entry_at(sensor_log_ring_t *ring, uint32_t pos) {
+    return (entry_t *)&ring->buf[pos & (ring->size - 1)];
+}
+
+bool sensor_log_ring_init(sensor_log_ring_t *ring, void *buf, size_t size) {
+    if (size < 1024 || (size & (size - 1)) || ((uintptr_t)buf & 3)) {
+        return false;
+    }
+    memset(buf, 0, size);
+    ring->buf = buf;
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    ring->high_water = 0;
+    return true;
+}
+
+bool IRAM_ATTR sensor_log_ring_put(sensor_log_ring_t *ring, uint8_t source,
+                                   int64_t t_us, const void *payload,
+                                   size_t len) {
+    if (len > SENSOR_LOG_MAX_PAYLOAD) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    uint32_t need = (sizeof(entry_t) + len + 3) & ~3u;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t skip;
+    do {
+        uint32_t to_end = ring->size - (head & (ring->size - 1));
+        skip = to_end < need ? to_end : 0;
+        // Acquire: the consumer has zeroed everything before tail
+        uint32_t tail =
+            atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head + skip + need - tail > ring->size) {
+            atomic_fetch_add_explicit(&ring->dropped, 1,
+                                      memory_order_relaxed);
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(
+        &ring->head, &head, head + skip + need, memory_order_relaxed,
+        memory_order_relaxed));
+
+    if (skip > 0) {
+        atomic_store_explicit(&entry_at(ring, head)->word, skip | ENTRY_PAD,
+                              memory_order_release);
+    }
+    entry_t *e = entry_at(ring, head + skip);
+    e->source = source;
+    e->len = (uint8_t)len;
+    e->t_us[0] = (uint32_t)t_us;
+    e->t_us[1] = (uint32_t)((uint64_t)t_us >> 32);
+    memcpy(e + 1, payload, len);
+    atomic_store_explicit(&e->word, need, memory_order_release);
+    return true;
+}
+
+// Zeroes the oldest entry, so its bytes read as uncommitted next lap
+static void release(sensor_log_ring_t *ring, entry_t *e, uint32_t size) {
+    memset(e, 0, size);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
+
+bool sensor_log_ring_peek(sensor_log_ring_t *ring, sensor_log_record_t *rec) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t used =
+        atomic_load_explicit(&ring->head, memory_order_relaxed) - tail;
+    if (used > ring->high_water) {
+        ring->high_water = used;
+    }
+    while (true) {
+        entry_t *e = entry_at(ring, tail);
+        uint32_t word = atomic_load_explicit(&e->word, memory_order_acquire);
+        if (word == 0) {
+            return false;
+        }
+        if (!(word & ENTRY_PAD)) {
+            rec->source = e->source;
+            rec->len = e->len;
+            rec->t_us = (int64_t)((uint64_t)e->t_us[1] << 32 | e->t_us[0]);
+            rec->payload = (const uint8_t *)(e + 1);
+            return true;
+        }
+        release(ring, e, word & ENTRY_SIZE_MASK);
+        tail += word & ENTRY_SIZE_MASK;
+    }
+}
+
+void sensor_log_ring_pop(sensor_log_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    entry_t *e = entry_at(ring, tail);
+    uint32_t word = atomic_load_explicit(&e->word, memory_order_relaxed);
+    release(ring, e, word & ENTRY_SIZE_MASK);
+}
+
+static inline sensor_log_page_header_t *header(sensor_log_page_t *page) {
+    return (sensor_log_page_header_t *)page->buf;
+}
+
+void sensor_log_page_begin(sensor_log_page_t *page, uint32_t seq,
+                           uint32_t boot, uint16_t dropped) {
+    memset(page->buf, 0xFF, sizeof(page->buf));
+    *header(page) = (sensor_log_page_header_t){
+        .magic = SENSOR_LOG_MAGIC,
+        .version = SENSOR_LOG_VERSION,
+        .header_size = sizeof(sensor_log_page_header_t),
+        .seq = seq,
+        .boot = boot,
+        .dropped = dropped,
+    };
+    page->used = sizeof(sensor_log_page_header_t);
+    page->records = 0;
+}
+
+bool sensor_log_page_add(sensor_log_page_t *page,
+                         const sensor_log_record_t *rec) {
+    size_t need = sizeof(sensor_log_record_header_t) + rec->len;
+    if (page->used + need > sizeof(page->buf)) {
+        return false;
+    }
+    if (page->records == 0) {
+        header(page)->base_us = rec->t_us;
+    }
+    int64_t dt = rec->t_us - header(page)->base_us;
+    if (dt < INT32_MIN || dt > INT32_MAX) {
+        return false;
+    }
+    sensor_log_record_header_t rh = {
+        .source = rec->source,
+        .len = rec->len,
+        .dt_us = (int32_t)dt,
+    };
+    memcpy(&page->buf[page->used], &rh, sizeof(rh));
+    memcpy(&page->buf[page->used + sizeof(rh)], rec->payload, rec->len);
+    page->used += need;
+    page->records++;
+    return true;
+}
+
+void sensor_log_page_finish(sensor_log_page_t *page) {
+    sensor_log_page_header_t *h = header(page);
+    h->records = page->records;
+    h->used = (uint16_t)(page->used - sizeof(*h));
+    h->crc = 0;
+    h->crc = sensor_log_crc32(0, page->buf, page->used);
+}
+
+bool sensor_log_page_check(const uint8_t *buf) {
+    sensor_log_page_header_t h;
+    memcpy(&h, buf, sizeof(h));
+    if (h.magic != SENSOR_LOG_MAGIC || h.version != SENSOR_LOG_VERSION ||
+        h.header_size != sizeof(h) ||
+        h.used > SENSOR_LOG_PAGE_SIZE - sizeof(h)) {
+        return false;
+    }
+    uint32_t crc = h.crc;
+    h.crc = 0;
+    uint32_t actual = sensor_log_crc32(0, &h, sizeof(h));
+    return sensor_log_crc32(actual, buf + sizeof(h), h.used) == crc;
+}
+
+// Standard CRC-32, the same as zlib's, for the decoder
+uint32_t sensor_log_crc32(uint32_t crc, const void *buf, size_t len) {
+#ifdef ESP_PLATFORM
+    return esp_rom_crc32_le(crc, buf, len);
+#else
+    const uint8_t *p = buf;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+#endif
+}
@@ -0,0 +1,131 @@
+#ifndef SENSOR_LOG_CORE_H
+#define SENSOR_LOG_CORE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The plain C half of the logger, with no FreeRTOS or flash dependencies
+ * so the host tools build it too: the on-flash format, the RAM ring the
+ * producers write into and the page builder the flush task fills from
+ * it. tools/sensor_log_decode.py reads the same format back. */
+
+/* On flash the log is a sequence of pages, one per erase sector. Each
+ * starts with a header; records follow back to back, each a 6-byte header
+ * and its payload, timed relative to the page. Unused bytes stay 0xFF. */
+#define SENSOR_LOG_PAGE_SIZE 4096
+#define SENSOR_LOG_MAGIC 0x474F4C53  // "SLOG"
+#define SENSOR_LOG_VERSION 1
+#define SENSOR_LOG_MAX_PAYLOAD 64
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t header_size;  // sizeof(sensor_log_page_header_t)
+    uint16_t records;
+    uint32_t seq;      // page number since the partition was first used
+    uint32_t boot;     // timestamps restart from zero with each boot
+    int64_t base_us;   // esp_timer time the record offsets count from
+    uint16_t used;     // record bytes after the header
+    uint16_t dropped;  // records lost to a full ring since the last page
+    uint32_t crc;      // CRC-32 of header (this field zero) and records
+} sensor_log_page_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t source;  // sensor_log_source_t
+    uint8_t len;     // payload bytes
+    int32_t dt_us;   // since base_us; below zero when producers race
+} sensor_log_record_header_t;
+
+/* Record sources and their payloads, little-endian and packed. The
+ * decoder has a matching table; add to both. */
+typedef enum {
+    SENSOR_LOG_IMU_RAW = 1,  // sensor_log_imu_raw_t
+    SENSOR_LOG_ORIENTATION,  // sensor_log_orientation_t
+    SENSOR_LOG_RANGE,        // sensor_log_range_t
+    SENSOR_LOG_ENCODER,      // sensor_log_encoder_t
+    SENSOR_LOG_MOTOR,        // sensor_log_motor_t
+} sensor_log_source_t;
+
+typedef struct __attribute__((packed)) {
+    int16_t accel[3];  // MPU6050 register values, FIFO order
+    int16_t temp;
+    int16_t gyro[3];
+} sensor_log_imu_raw_t;
+
+typedef struct __attribute__((packed)) {
+    float roll, pitch, yaw;  // degrees
+} sensor_log_orientation_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t sensor;
+    uint16_t echo_us;      // 0 on timeout
+    uint16_t filtered_mm;
+} sensor_log_range_t;
+
+typedef struct __attribute__((packed)) {
+    int32_t count;
+    float pulses_per_s;
+} sensor_log_encoder_t;
+
+typedef struct __attribute__((packed)) {
+    int8_t direction;  // -1, 0, 1
+    uint16_t duty;
+} sensor_log_motor_t;
+
+/* Lock-free multi-producer, single-consumer byte ring. A producer claims
+ * space with one compare-and-swap on head, fills it in and publishes it
+ * by setting the entry's commit word; the consumer reads committed
+ * entries in order, zeroes them and advances tail. Safe from tasks and
+ * ISRs on both cores; when the ring is full the record is dropped and
+ * counted, never waited for. size must be a power of two. */
+typedef struct {
+    uint8_t *buf;  // zeroed, 4-byte aligned
+    uint32_t size;
+    _Atomic uint32_t head;  // free-running byte counts
+    _Atomic uint32_t tail;
+    _Atomic uint32_t dropped;
+    uint32_t high_water;  // most bytes in use, as seen by the consumer
+} sensor_log_ring_t;
+
+typedef struct {
+    uint8_t source;
+    uint8_t len;
+    int64_t t_us;
+    const uint8_t *payload;  // valid until sensor_log_ring_pop()
+} sensor_log_record_t;
+
+bool sensor_log_ring_init(sensor_log_ring_t *ring, void *buf, size_t size);
+
+// False, and counted in dropped, when the record does not fit
+bool sensor_log_ring_put(sensor_log_ring_t *ring, uint8_t source,
+                         int64_t t_us, const void *payload, size_t len);
+
+// Consumer only. False when the oldest entry is not committed yet.
+bool sensor_log_ring_peek(sensor_log_ring_t *ring, sensor_log_record_t *rec);
+void sensor_log_ring_pop(sensor_log_ring_t *ring);
+
+typedef struct {
+    uint8_t buf[SENSOR_LOG_PAGE_SIZE];
+    size_t used;  // including the header
+    uint16_t records;
+} sensor_log_page_t;
+
+void sensor_log_page_begin(sensor_log_page_t *page, uint32_t seq,
+                           uint32_t boot, uint16_t dropped);
+
+/* False when the record does not fit, or is too far from the page's first
+ * record for its offset: finish the page and start another */
+bool sensor_log_page_add(sensor_log_page_t *page,
+                         const sensor_log_record_t *rec);
+
+// Fills in the header's counts and CRC
+void sensor_log_page_finish(sensor_log_page_t *page);
+
+// False when buf does not hold a complete page with a matching CRC
+bool sensor_log_page_check(const uint8_t *buf);
+
+uint32_t sensor_log_crc32(uint32_t crc, const void *buf, size_t len);
+
+#endif  // SENSOR_LOG_CORE_H
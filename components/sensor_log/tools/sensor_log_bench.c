@@ -0,0 +1,354 @@
+/* Host check and benchmark for the sensor log's ring and page format.
+ *
+ *   cc -O2 -pthread -I.. sensor_log_bench.c ../sensor_log_core.c -lm \
+ *       -o sensor_log_bench
+ *   ./sensor_log_bench [producers] [rate_each] [ring_size] [pause_us]
+ *   ./sensor_log_bench --image log.bin [sectors]
+ *
+ * The first form runs producer threads for a second, each logging
+ * rate_each records/s (0: as fast as it can), against one consumer that
+ * builds pages the way the flush task does and pauses pause_us after each
+ * as if it were writing flash. Every page is checked and parsed back:
+ * each producer's records must arrive intact and in order, and every
+ * record must be either in a page or counted as dropped. It reports the
+ * cost of a put, the consumer's throughput and the drops.
+ *
+ * The second writes a partition image with records from every source
+ * over three boots, more pages than fit so the circle wraps, and one
+ * page torn as a reset would leave it, for checking
+ * sensor_log_decode.py:
+ *
+ *   ./sensor_log_bench --image log.bin && ./sensor_log_decode.py log.bin
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sensor_log_core.h"
+
+#define MAX_PRODUCERS 16
+#define RUN_NS 1000000000.0
+#define UNPACED_RECORDS 2000000  // per producer when rate_each is 0
+
+typedef struct __attribute__((packed)) {
+    uint8_t producer;
+    uint32_t seq;
+    uint8_t fill[SENSOR_LOG_MAX_PAYLOAD - 5];
+} test_payload_t;
+
+typedef struct {
+    sensor_log_ring_t *ring;
+    int id;
+    uint32_t rate;
+    uint32_t records;
+    uint32_t accepted;
+    double ns_per_put;  // unpaced runs only
+} producer_t;
+
+static _Atomic int s_running;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void sleep_until(double ns) {
+    double wait = ns - now_ns();
+    if (wait > 0) {
+        struct timespec ts = {(time_t)(wait / 1e9), (long)fmod(wait, 1e9)};
+        nanosleep(&ts, NULL);
+    }
+}
+
+static size_t payload_len(uint32_t seq) { return 5 + seq % 40; }
+
+static uint8_t fill_byte(int producer, uint32_t seq, size_t i) {
+    return (uint8_t)(producer * 31 + seq * 7 + i);
+}
+
+static void *producer_main(void *arg) {
+    producer_t *p = arg;
+    test_payload_t payload = {.producer = (uint8_t)p->id};
+    double start = now_ns();
+    for (uint32_t seq = 0; seq < p->records; seq++) {
+        if (p->rate > 0) {
+            sleep_until(start + seq * 1e9 / p->rate);
+        }
+        payload.seq = seq;
+        size_t len = payload_len(seq);
+        for (size_t i = 0; i < len - 5; i++) {
+            payload.fill[i] = fill_byte(p->id, seq, i);
+        }
+        p->accepted += sensor_log_ring_put(p->ring, (uint8_t)p->id,
+                                           (int64_t)seq, &payload, len);
+    }
+    p->ns_per_put = (now_ns() - start) / p->records;
+    atomic_fetch_sub(&s_running, 1);
+    return NULL;
+}
+
+typedef struct {
+    uint32_t pages;
+    uint32_t records;
+    uint32_t errors;
+    uint32_t dropped;  // from the page headers
+    uint32_t expected_dropped;
+    int64_t next_seq[MAX_PRODUCERS];
+    uint32_t seen[MAX_PRODUCERS];
+} verify_t;
+
+static void check_record(verify_t *v, const sensor_log_record_header_t *rh,
+                         const uint8_t *data) {
+    test_payload_t payload;
+    memcpy(&payload, data, rh->len);
+    int id = payload.producer;
+    if (id >= MAX_PRODUCERS || id != rh->source ||
+        rh->len != payload_len(payload.seq) ||
+        (int64_t)payload.seq < v->next_seq[id]) {
+        v->errors++;
+        return;
+    }
+    for (size_t i = 0; i < rh->len - 5u; i++) {
+        if (payload.fill[i] != fill_byte(id, payload.seq, i)) {
+            v->errors++;
+            return;
+        }
+    }
+    v->next_seq[id] = payload.seq + 1;
+    v->seen[id]++;
+    v->records++;
+}
+
+static void check_page(verify_t *v, const uint8_t *buf) {
+    if (!sensor_log_page_check(buf)) {
+        v->errors++;
+        return;
+    }
+    sensor_log_page_header_t h;
+    memcpy(&h, buf, sizeof(h));
+    v->pages++;
+    v->dropped += h.dropped;
+    size_t pos = sizeof(h), end = sizeof(h) + h.used;
+    for (uint16_t i = 0; i < h.records; i++) {
+        sensor_log_record_header_t rh;
+        memcpy(&rh, &buf[pos], sizeof(rh));
+        pos += sizeof(rh);
+        if (pos + rh.len > end) {
+            v->errors++;
+            return;
+        }
+        // dt carries the sequence number, so it checks the timestamps too
+        uint32_t seq;
+        memcpy(&seq, &buf[pos + 1], sizeof(seq));
+        if (h.base_us + rh.dt_us != (int64_t)seq) {
+            v->errors++;
+        }
+        check_record(v, &rh, &buf[pos]);
+        pos += rh.len;
+    }
+}
+
+static void finish_page(sensor_log_ring_t *ring, sensor_log_page_t *page,
+                        verify_t *v, uint32_t *last_dropped,
+                        uint32_t pause_us) {
+    sensor_log_page_finish(page);
+    check_page(v, page->buf);
+    if (pause_us > 0) {
+        usleep(pause_us);
+    }
+    // Clamped as in sensor_log.c
+    uint32_t dropped = atomic_load(&ring->dropped);
+    uint32_t lost = dropped - *last_dropped;
+    lost = lost > UINT16_MAX ? UINT16_MAX : lost;
+    sensor_log_page_begin(page, v->pages, 0, (uint16_t)lost);
+    v->expected_dropped += lost;
+    *last_dropped = dropped;
+}
+
+static int run_stress(int producers, uint32_t rate, size_t ring_size,
+                      uint32_t pause_us) {
+    sensor_log_ring_t ring;
+    void *buf = aligned_alloc(4, ring_size);
+    if (!sensor_log_ring_init(&ring, buf, ring_size)) {
+        fprintf(stderr, "ring_size must be a power of two >= 1024\n");
+        return 1;
+    }
+    static sensor_log_page_t page;
+    sensor_log_page_begin(&page, 0, 0, 0);
+    verify_t v = {0};
+    uint32_t last_dropped = 0;
+
+    producer_t p[MAX_PRODUCERS];
+    pthread_t threads[MAX_PRODUCERS];
+    atomic_store(&s_running, producers);
+    double start = now_ns();
+    for (int i = 0; i < producers; i++) {
+        p[i] = (producer_t){
+            .ring = &ring,
+            .id = i,
+            .rate = rate,
+            .records = rate > 0 ? rate * RUN_NS / 1e9 : UNPACED_RECORDS,
+        };
+        pthread_create(&threads[i], NULL, producer_main, &p[i]);
+    }
+
+    // Drains like the flush task, every millisecond
+    sensor_log_record_t rec;
+    bool done = false;
+    double consumer_ns = 0;
+    while (!done) {
+        // Checked first: once no producer runs, everything is in the ring
+        done = atomic_load(&s_running) == 0;
+        double t = now_ns();
+        while (sensor_log_ring_peek(&ring, &rec)) {
+            if (!sensor_log_page_add(&page, &rec)) {
+                consumer_ns += now_ns() - t;
+                finish_page(&ring, &page, &v, &last_dropped, pause_us);
+                t = now_ns();
+                continue;
+            }
+            sensor_log_ring_pop(&ring);
+        }
+        consumer_ns += now_ns() - t;
+        if (!done) {
+            usleep(1000);
+        }
+    }
+    if (page.records > 0) {
+        finish_page(&ring, &page, &v, &last_dropped, pause_us);
+    }
+    double elapsed = now_ns() - start;
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    uint32_t attempted = 0, accepted = 0, seen = 0;
+    double ns = 0;
+    for (int i = 0; i < producers; i++) {
+        attempted += p[i].records;
+        accepted += p[i].accepted;
+        seen += v.seen[i];
+        ns += p[i].ns_per_put;
+        if (v.seen[i] != p[i].accepted) {
+            v.errors++;
+        }
+    }
+    uint32_t dropped = atomic_load(&ring.dropped);
+    bool ok = v.errors == 0 && seen == accepted &&
+              accepted + dropped == attempted &&
+              v.dropped == v.expected_dropped;
+
+    printf("%d producers at %s, %zu-byte ring, %u us per page:\n",
+           producers, rate > 0 ? "a fixed rate" : "full speed", ring_size,
+           pause_us);
+    printf("  %u pages, %u records, %u dropped (%.2f%%), peak %u bytes\n",
+           v.pages, v.records, dropped, 100.0 * dropped / attempted,
+           ring.high_water);
+    if (rate == 0) {
+        printf("  put %.0f ns average with %d contending\n",
+               ns / producers, producers);
+    }
+    printf("  consumer %.0f ns/record, %.1f KB/s of pages over %.2f s\n",
+           consumer_ns / v.records,
+           v.pages * (double)SENSOR_LOG_PAGE_SIZE / 1024 / (elapsed / 1e9),
+           elapsed / 1e9);
+    printf("%s (%u errors)\n", ok ? "PASS" : "FAIL", v.errors);
+    free(buf);
+    return ok ? 0 : 1;
+}
+
+/* Pages as the flush task would write them, with a few of each kind of
+ * record per millisecond */
+static int write_image(const char *path, uint32_t sectors) {
+    uint8_t *image = malloc((size_t)sectors * SENSOR_LOG_PAGE_SIZE);
+    memset(image, 0xFF, (size_t)sectors * SENSOR_LOG_PAGE_SIZE);
+    static sensor_log_page_t page;
+    uint32_t seq = 0, pages_per_boot = sectors * 2 / 3;
+
+    for (uint32_t boot = 0; boot < 3; boot++) {
+        int64_t t_us = 1000000;
+        sensor_log_page_begin(&page, seq, boot, boot);
+        for (uint32_t n = 0; seq < (boot + 1) * pages_per_boot; n++) {
+            t_us += 1000;
+            sensor_log_imu_raw_t imu = {
+                .accel = {(int16_t)(n % 200), -12, 4096},
+                .temp = -1200,
+                .gyro = {3, (int16_t)-(n % 50), 1},
+            };
+            sensor_log_orientation_t orientation = {n * 0.01f, -2.5f, 90.0f};
+            sensor_log_range_t range = {(uint8_t)(n % 2),
+                                        (uint16_t)(580 + n % 100),
+                                        (uint16_t)(100 + n % 17)};
+            sensor_log_encoder_t encoder = {(int32_t)n * 3, 3000.0f};
+            sensor_log_motor_t motor = {1, 768};
+            struct {
+                uint8_t source;
+                const void *payload;
+                size_t len;
+            } recs[] = {
+                {SENSOR_LOG_IMU_RAW, &imu, sizeof(imu)},
+                {SENSOR_LOG_ORIENTATION, &orientation, sizeof(orientation)},
+                {SENSOR_LOG_RANGE, &range, sizeof(range)},
+                {SENSOR_LOG_ENCODER, &encoder, sizeof(encoder)},
+                {SENSOR_LOG_MOTOR, &motor, sizeof(motor)},
+            };
+            size_t count = n % 10 == 0 ? 5 : 1;
+            for (size_t i = 0; i < count; i++) {
+                sensor_log_record_t rec = {
+                    .source = recs[i].source,
+                    .len = (uint8_t)recs[i].len,
+                    .t_us = t_us,
+                    .payload = recs[i].payload,
+                };
+                if (!sensor_log_page_add(&page, &rec)) {
+                    sensor_log_page_finish(&page);
+                    memcpy(&image[(seq % sectors) * SENSOR_LOG_PAGE_SIZE],
+                           page.buf, SENSOR_LOG_PAGE_SIZE);
+                    sensor_log_page_begin(&page, ++seq, boot, 0);
+                    sensor_log_page_add(&page, &rec);
+                }
+            }
+        }
+    }
+    // The newest page, cut short by a reset halfway through its write
+    uint32_t torn = (seq - 1) % sectors;
+    memset(&image[torn * SENSOR_LOG_PAGE_SIZE + SENSOR_LOG_PAGE_SIZE / 2],
+           0xFF, SENSOR_LOG_PAGE_SIZE / 2);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    fwrite(image, SENSOR_LOG_PAGE_SIZE, sectors, file);
+    fclose(file);
+    printf("%s: %u sectors, pages 0-%u over 3 boots, sector %u torn; "
+           "expect %u valid pages\n",
+           path, sectors, seq - 1, torn, sectors - 1);
+    free(image);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--image") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --image FILE [sectors]\n", argv[0]);
+            return 2;
+        }
+        return write_image(argv[2], argc > 3 ? atoi(argv[3]) : 16);
+    }
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    uint32_t rate = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+    size_t ring_size = argc > 3 ? strtoul(argv[3], NULL, 0) : 16384;
+    uint32_t pause_us = argc > 4 ? strtoul(argv[4], NULL, 0) : 0;
+    if (producers < 1 || producers > MAX_PRODUCERS) {
+        fprintf(stderr, "1 to %d producers\n", MAX_PRODUCERS);
+        return 2;
+    }
+    return run_stress(producers, rate, ring_size, pause_us);
+}
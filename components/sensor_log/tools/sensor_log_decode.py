@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Decode a sensor_log partition image into CSV.
+
+Reads the pages written by sensor_log.c, skips erased and torn ones,
+puts the rest in write order and prints one row per record. A summary
+with the records per source and the drops goes to stderr.
+
+    parttool.py read_partition --partition-name sensorlog --output log.bin
+    python3 sensor_log_decode.py log.bin > log.csv
+
+With --source, only that source's records from one boot (the latest
+unless --boot says otherwise), with named columns. The IMU trace this
+gives replays through gyro-accel/tools/imu_fusion_bench:
+
+    python3 sensor_log_decode.py --source imu_raw log.bin > trace.csv
+"""
+
+import argparse
+import collections
+import struct
+import sys
+import zlib
+
+PAGE_SIZE = 4096
+MAGIC = 0x474F4C53
+VERSION = 1
+HEADER = struct.Struct("<IBBHIIqHHI")
+RECORD = struct.Struct("<BBi")
+
+# Mirrors sensor_log_source_t and the payload structs in sensor_log_core.h
+SOURCES = {
+    1: ("imu_raw", "<7h", ("ax", "ay", "az", "temp", "gx", "gy", "gz")),
+    2: ("orientation", "<3f", ("roll", "pitch", "yaw")),
+    3: ("range", "<BHH", ("sensor", "echo_us", "filtered_mm")),
+    4: ("encoder", "<if", ("count", "pulses_per_s")),
+    5: ("motor", "<bH", ("direction", "duty")),
+}
+
+
+def read_pages(image, stats):
+    pages = []
+    for offset in range(0, len(image) - PAGE_SIZE + 1, PAGE_SIZE):
+        page = image[offset:offset + PAGE_SIZE]
+        (magic, version, header_size, records, seq, boot, base_us, used,
+         dropped, crc) = HEADER.unpack_from(page)
+        if magic != MAGIC:
+            continue  # erased
+        if (version != VERSION or header_size != HEADER.size
+                or used > PAGE_SIZE - HEADER.size):
+            stats["bad pages"] += 1
+            continue
+        header = HEADER.pack(magic, version, header_size, records, seq, boot,
+                             base_us, used, dropped, 0)
+        body = page[HEADER.size:HEADER.size + used]
+        if zlib.crc32(header + body) != crc:
+            stats["bad pages"] += 1
+            continue
+        pages.append((seq, boot, base_us, records, dropped, body))
+    pages.sort()
+    return pages
+
+
+def decode(pages, stats):
+    for seq, boot, base_us, records, dropped, body in pages:
+        stats["pages"] += 1
+        stats["dropped"] += dropped
+        pos = 0
+        for _ in range(records):
+            source, length, dt_us = RECORD.unpack_from(body, pos)
+            pos += RECORD.size
+            payload = body[pos:pos + length]
+            pos += length
+            if source in SOURCES:
+                name, fmt, _ = SOURCES[source]
+                values = struct.unpack(fmt, payload)
+            else:
+                name, values = f"source{source}", (payload.hex(),)
+            stats[name] += 1
+            yield boot, base_us + dt_us, name, values
+
+
+def format_value(v):
+    return f"{v:.4f}" if isinstance(v, float) else str(v)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("image", type=argparse.FileType("rb"))
+    parser.add_argument("--source", choices=[s[0] for s in SOURCES.values()],
+                        help="one source, with named columns")
+    parser.add_argument("--boot", type=int,
+                        help="with --source: which boot (default latest)")
+    args = parser.parse_args()
+
+    stats = collections.Counter()
+    pages = read_pages(args.image.read(), stats)
+    boots = sorted({page[1] for page in pages})
+    out = sys.stdout
+
+    if args.source:
+        boot = args.boot if args.boot is not None else (boots or [0])[-1]
+        fields = next(s[2] for s in SOURCES.values() if s[0] == args.source)
+        out.write("t_us," + ",".join(fields) + "\n")
+        for b, t_us, name, values in decode(pages, stats):
+            if b == boot and name == args.source:
+                out.write(f"{t_us}," +
+                          ",".join(format_value(v) for v in values) + "\n")
+    else:
+        out.write("boot,t_us,source,values\n")
+        for boot, t_us, name, values in decode(pages, stats):
+            out.write(f"{boot},{t_us},{name}," +
+                      ",".join(format_value(v) for v in values) + "\n")
+
+    print(f"{stats.pop('pages', 0)} pages ({stats.pop('bad pages', 0)} "
+          f"damaged, skipped), boots {boots[0] if boots else '-'}"
+          f"-{boots[-1] if boots else '-'}, "
+          f"{stats.pop('dropped', 0)} records dropped on the device",
+          file=sys.stderr)
+    for name, count in sorted(stats.items()):
+        print(f"  {name}: {count}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,331 @@
+#include "settings.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "settings";
+
+#define NAMESPACE "settings"
+#define SCHEMA_KEY "schema"
+
+typedef struct {
+    const char *name;  // also the NVS key, so at most 15 characters
+    setting_type_t type;
+    bool secret;
+    uint16_t max_len;  // strings
+    uint32_t min;      // numbers
+    uint32_t max;
+    const char *default_str;
+    uint32_t default_u32;
+} setting_def_t;
+
+#define STR_SETTING(n, len, def, is_secret)                              \
+    {.name = (n), .type = SETTING_TYPE_STR, .secret = (is_secret),       \
+     .max_len = (len), .default_str = (def)}
+#define U32_SETTING(n, lo, hi, def)                                      \
+    {.name = (n), .type = SETTING_TYPE_U32, .min = (lo), .max = (hi),    \
+     .default_u32 = (def)}
+
+// The schema: changing a name or type here needs a SETTINGS_SCHEMA_VERSION
+static const setting_def_t defs[SETTING_COUNT] = {
+    [SETTING_WIFI_SSID] =
+        STR_SETTING("wifi_ssid", 32, CONFIG_SETTINGS_WIFI_SSID, false),
+    [SETTING_WIFI_PASS] =
+        STR_SETTING("wifi_pass", 64, CONFIG_SETTINGS_WIFI_PASS, true),
+    [SETTING_MQTT_URI] =
+        STR_SETTING("mqtt_uri", 128, CONFIG_SETTINGS_MQTT_URI, false),
+    [SETTING_MQTT_USER] =
+        STR_SETTING("mqtt_user", 64, CONFIG_SETTINGS_MQTT_USER, false),
+    [SETTING_MQTT_PASS] =
+        STR_SETTING("mqtt_pass", 64, CONFIG_SETTINGS_MQTT_PASS, true),
+    [SETTING_MQTT_TOPIC] =
+        STR_SETTING("mqtt_topic", 64, CONFIG_SETTINGS_MQTT_TOPIC, false),
+    [SETTING_MQTT_KEEPALIVE] =
+        U32_SETTING("mqtt_keepalive", 5, 3600, CONFIG_SETTINGS_MQTT_KEEPALIVE),
+};
+
+typedef union {
+    char str[SETTINGS_STR_MAX + 1];
+    uint32_t u32;
+} setting_value_t;
+
+/* Written only by settings_init(), before anyone reads it, so lookups
+ * need no lock */
+static setting_value_t cache[SETTING_COUNT];
+static bool initialized;
+static bool restart_needed;
+
+static void load_default(setting_id_t id) {
+    const setting_def_t *def = &defs[id];
+    if (def->type == SETTING_TYPE_STR) {
+        strlcpy(cache[id].str, def->default_str, def->max_len + 1);
+    } else {
+        cache[id].u32 = def->default_u32;
+    }
+}
+
+static void load(nvs_handle_t nvs, setting_id_t id) {
+    const setting_def_t *def = &defs[id];
+    esp_err_t err;
+    if (def->type == SETTING_TYPE_STR) {
+        size_t len = def->max_len + 1;
+        err = nvs_get_str(nvs, def->name, cache[id].str, &len);
+    } else {
+        err = nvs_get_u32(nvs, def->name, &cache[id].u32);
+    }
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Bad stored %s (%s), using the default", def->name,
+                     esp_err_to_name(err));
+        }
+        load_default(id);
+    }
+}
+
+// Erases a store written under another schema version
+static esp_err_t check_schema(nvs_handle_t nvs) {
+    uint32_t version = 0;
+    esp_err_t err = nvs_get_u32(nvs, SCHEMA_KEY, &version);
+    if (err == ESP_OK && version == SETTINGS_SCHEMA_VERSION) {
+        return ESP_OK;
+    }
+    if (err == ESP_OK) {
+        ESP_LOGW(TAG, "Schema %lu stored, expected %d: resetting",
+                 (unsigned long)version, SETTINGS_SCHEMA_VERSION);
+    }
+    err = nvs_erase_all(nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs, SCHEMA_KEY, SETTINGS_SCHEMA_VERSION);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    return err;
+}
+
+esp_err_t settings_init(void) {
+    if (initialized) {
+        return ESP_OK;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = check_schema(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open settings: %s, using the defaults",
+                 esp_err_to_name(err));
+        for (int id = 0; id < SETTING_COUNT; id++) {
+            load_default(id);
+        }
+    } else {
+        for (int id = 0; id < SETTING_COUNT; id++) {
+            load(nvs, id);
+        }
+        nvs_close(nvs);
+    }
+    initialized = true;
+    return err;
+}
+
+const char *settings_get_str(setting_id_t id) {
+    return defs[id].type == SETTING_TYPE_STR ? cache[id].str : "";
+}
+
+uint32_t settings_get_u32(setting_id_t id) {
+    return defs[id].type == SETTING_TYPE_U32 ? cache[id].u32 : 0;
+}
+
+static esp_err_t store(setting_id_t id, const char *str, uint32_t u32) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (defs[id].type == SETTING_TYPE_STR) {
+        err = nvs_set_str(nvs, defs[id].name, str);
+    } else {
+        err = nvs_set_u32(nvs, defs[id].name, u32);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store %s: %s", defs[id].name,
+                 esp_err_to_name(err));
+        return err;
+    }
+    bool changed = defs[id].type == SETTING_TYPE_STR
+                       ? strcmp(cache[id].str, str) != 0
+                       : cache[id].u32 != u32;
+    if (changed) {
+        restart_needed = true;
+        ESP_LOGI(TAG, "%s changed, applies after a restart", defs[id].name);
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_set_str(setting_id_t id, const char *value) {
+    if (id >= SETTING_COUNT || defs[id].type != SETTING_TYPE_STR ||
+        strlen(value) > defs[id].max_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return store(id, value, 0);
+}
+
+esp_err_t settings_set_u32(setting_id_t id, uint32_t value) {
+    if (id >= SETTING_COUNT || defs[id].type != SETTING_TYPE_U32 ||
+        value < defs[id].min || value > defs[id].max) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return store(id, NULL, value);
+}
+
+static int find(const char *name, size_t len) {
+    for (int id = 0; id < SETTING_COUNT; id++) {
+        if (strlen(defs[id].name) == len &&
+            memcmp(defs[id].name, name, len) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+static esp_err_t set_from_text(int id, const char *value) {
+    if (defs[id].type == SETTING_TYPE_STR) {
+        return settings_set_str(id, value);
+    }
+    char *end;
+    unsigned long number = strtoul(value, &end, 10);
+    if (value[0] == '\0' || value[0] == '-' || *end != '\0' ||
+        number > UINT32_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return settings_set_u32(id, number);
+}
+
+esp_err_t settings_set(const char *name, const char *value) {
+    int id = find(name, strlen(name));
+    return id < 0 ? ESP_ERR_NOT_FOUND : set_from_text(id, value);
+}
+
+esp_err_t settings_apply_text(const char *text, size_t len, int *bad_line) {
+    char value[SETTINGS_STR_MAX + 1];
+    const char *end = text + len;
+    int line_no = 0;
+    *bad_line = 0;
+
+    while (text < end) {
+        const char *eol = memchr(text, '\n', end - text);
+        const char *line_end = eol != NULL ? eol : end;
+        line_no++;
+        if (line_end > text && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        if (line_end > text) {
+            const char *eq = memchr(text, '=', line_end - text);
+            esp_err_t err = ESP_ERR_INVALID_ARG;
+            size_t value_len = eq != NULL ? (size_t)(line_end - eq - 1) : 0;
+            int id = eq != NULL ? find(text, eq - text) : -1;
+            if (eq != NULL && id < 0) {
+                err = ESP_ERR_NOT_FOUND;
+            } else if (eq != NULL && value_len < sizeof(value)) {
+                memcpy(value, eq + 1, value_len);
+                value[value_len] = '\0';
+                err = set_from_text(id, value);
+            }
+            if (err != ESP_OK) {
+                *bad_line = line_no;
+                return err;
+            }
+        }
+        text = eol != NULL ? eol + 1 : end;
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_SETTINGS_REMOTE_WRITE
+// Compares every byte, so the time taken does not leak the prefix length
+static bool token_matches(const char *token, size_t len) {
+    const char *secret = CONFIG_SETTINGS_REMOTE_TOKEN;
+    size_t secret_len = strlen(secret);
+    unsigned diff = len != secret_len || secret_len == 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= (unsigned char)token[i] ^
+                (unsigned char)secret[i < secret_len ? i : 0];
+    }
+    return diff == 0;
+}
+#endif
+
+esp_err_t settings_apply_remote(const char *text, size_t len, int *bad_line) {
+    *bad_line = 0;
+#if CONFIG_SETTINGS_REMOTE_WRITE
+    static const char prefix[] = "token=";
+    const char *eol = memchr(text, '\n', len);
+    size_t line_len = eol != NULL ? (size_t)(eol - text) : len;
+    size_t skip = eol != NULL ? line_len + 1 : len;
+    if (line_len > 0 && text[line_len - 1] == '\r') {
+        line_len--;
+    }
+    if (line_len < sizeof(prefix) - 1 ||
+        memcmp(text, prefix, sizeof(prefix) - 1) != 0 ||
+        !token_matches(text + sizeof(prefix) - 1,
+                       line_len - (sizeof(prefix) - 1))) {
+        ESP_LOGW(TAG, "Remote write refused: bad token");
+        *bad_line = 1;
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = settings_apply_text(text + skip, len - skip, bad_line);
+    if (*bad_line > 0) {
+        (*bad_line)++;
+    }
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t settings_reset(void) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // Keep the schema key so the next boot does not log a mismatch
+    err = nvs_erase_all(nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs, SCHEMA_KEY, SETTINGS_SCHEMA_VERSION);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err == ESP_OK) {
+        restart_needed = true;
+    }
+    return err;
+}
+
+const char *settings_name(setting_id_t id) {
+    return defs[id].name;
+}
+
+setting_type_t settings_type(setting_id_t id) {
+    return defs[id].type;
+}
+
+bool settings_is_secret(setting_id_t id) {
+    return defs[id].secret;
+}
+
+bool settings_restart_needed(void) {
+    return restart_needed;
+}
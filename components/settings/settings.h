@@ -0,0 +1,76 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/* Typed device configuration kept in NVS, so broker, credentials and
+ * topics change without a reflash. settings_init() loads every value into
+ * RAM once; reads are plain memory loads and the returned strings stay
+ * valid forever. settings_set*() validates and stores the new value right
+ * away, but the RAM copy keeps the boot value: Wi-Fi and MQTT read theirs
+ * at startup, so changes apply on the next boot.
+ *
+ * The schema version is stored with the values. A store written under a
+ * different version is erased and the Kconfig defaults are used. Bump the
+ * version when a setting changes meaning or type. */
+#define SETTINGS_SCHEMA_VERSION 1
+#define SETTINGS_STR_MAX 128  // longest string value, excluding the NUL
+
+typedef enum {
+    SETTING_WIFI_SSID,
+    SETTING_WIFI_PASS,
+    SETTING_MQTT_URI,
+    SETTING_MQTT_USER,
+    SETTING_MQTT_PASS,
+    SETTING_MQTT_TOPIC,  // command topic the mqtt project subscribes to
+    SETTING_MQTT_KEEPALIVE,
+    SETTING_COUNT,
+} setting_id_t;
+
+typedef enum {
+    SETTING_TYPE_STR,
+    SETTING_TYPE_U32,
+} setting_type_t;
+
+// Needs nvs_flash_init() first; later calls return ESP_OK straight away
+esp_err_t settings_init(void);
+
+const char *settings_get_str(setting_id_t id);
+uint32_t settings_get_u32(setting_id_t id);
+
+esp_err_t settings_set_str(setting_id_t id, const char *value);
+esp_err_t settings_set_u32(setting_id_t id, uint32_t value);
+
+/* Sets a value by name from text, as received over HTTP or MQTT.
+ * ESP_ERR_NOT_FOUND for an unknown name, ESP_ERR_INVALID_ARG for a value
+ * of the wrong type, length or range. */
+esp_err_t settings_set(const char *name, const char *value);
+
+/* Applies "name=value" lines (blank lines are skipped). Stops at the
+ * first bad line and returns its error, with *bad_line set to its 1-based
+ * number; earlier lines stay applied. */
+esp_err_t settings_apply_text(const char *text, size_t len, int *bad_line);
+
+/* settings_apply_text() for requests from the network. The first line
+ * must be "token=<secret>" matching CONFIG_SETTINGS_REMOTE_TOKEN; line
+ * numbers count it. ESP_ERR_NOT_SUPPORTED unless
+ * CONFIG_SETTINGS_REMOTE_WRITE is set, ESP_ERR_INVALID_STATE for a
+ * missing or wrong token. Nothing is stored in either case. */
+esp_err_t settings_apply_remote(const char *text, size_t len, int *bad_line);
+
+// Erases the store; the defaults apply on the next boot
+esp_err_t settings_reset(void);
+
+const char *settings_name(setting_id_t id);
+setting_type_t settings_type(setting_id_t id);
+// Passwords: never reported back
+bool settings_is_secret(setting_id_t id);
+
+// Whether a stored value differs from the one this boot is running with
+bool settings_restart_needed(void);
+
+#endif  // SETTINGS_H
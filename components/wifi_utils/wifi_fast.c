@@ -0,0 +1,58 @@
+#include "wifi_fast.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "wifi fast";
+
+#define NAMESPACE "wifi_fast"
+#define KEY "ap"
+
+// FNV-1a
+static uint32_t ssid_hash(const char *ssid) {
+    uint32_t hash = 2166136261u;
+    for (const char *c = ssid; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    return hash;
+}
+
+bool wifi_fast_load(const char *ssid, wifi_fast_cache_t *cache) {
+    nvs_handle_t nvs;
+    if (nvs_open(NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*cache);
+    esp_err_t err = nvs_get_blob(nvs, KEY, cache, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*cache) &&
+           cache->ssid_hash == ssid_hash(ssid) && cache->channel != 0 &&
+           cache->ip != 0;
+}
+
+void wifi_fast_save(const char *ssid, wifi_fast_cache_t *cache) {
+    cache->ssid_hash = ssid_hash(ssid);
+    wifi_fast_cache_t stored;
+    if (wifi_fast_load(ssid, &stored) &&
+        memcmp(&stored, cache, sizeof(stored)) == 0) {
+        return;  // spare the flash
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, KEY, cache, sizeof(*cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to cache the AP: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Cached AP on channel %u for the next boot",
+                 cache->channel);
+    }
+}
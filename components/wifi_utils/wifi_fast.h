@@ -0,0 +1,26 @@
+#ifndef WIFI_FAST_H
+#define WIFI_FAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* What a boot needs to skip the scan and DHCP: the AP last connected to
+ * and the lease it handed out. Kept in NVS rather than RTC memory so it
+ * survives power cycles, and rewritten only when something changed. The
+ * SSID hash ties an entry to the network it was learned on. */
+typedef struct {
+    uint32_t ssid_hash;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;  // network byte order, as in esp_ip4_addr_t
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_fast_cache_t;
+
+// False when nothing is cached for this SSID
+bool wifi_fast_load(const char *ssid, wifi_fast_cache_t *cache);
+
+void wifi_fast_save(const char *ssid, wifi_fast_cache_t *cache);
+
+#endif  // WIFI_FAST_H
@@ -0,0 +1,72 @@
+#include "wifi_link.h"
+
+#include <string.h>
+
+#define LINK_MASK (WIFI_LINK_HISTORY - 1)
+
+_Static_assert((WIFI_LINK_HISTORY & LINK_MASK) == 0,
+               "WIFI_LINK_HISTORY must be a power of two");
+
+// EWMA weights as shifts: alpha = 1/4 and 1/32
+#define SHORT_SHIFT 2
+#define LONG_SHIFT 5
+
+// Samples on one AP before the short average is trusted
+#define SETTLE_SAMPLES (1 << SHORT_SHIFT)
+
+static int8_t q4_to_dbm(int32_t q4) {
+    // Round half away from zero; RSSI is negative
+    return (int8_t)((q4 - 8) / 16);
+}
+
+void wifi_link_init(wifi_link_t *link) {
+    memset(link, 0, sizeof(*link));
+}
+
+void wifi_link_add(wifi_link_t *link, const wifi_link_sample_t *sample) {
+    wifi_link_stats_t *stats = &link->stats;
+    int32_t rssi_q4 = (int32_t)sample->rssi * 16;
+
+    if (stats->ap_samples == 0 ||
+        memcmp(sample->bssid, stats->last.bssid, sizeof(sample->bssid)) != 0) {
+        link->avg_short_q4 = rssi_q4;
+        link->avg_long_q4 = rssi_q4;
+        stats->rssi_min = sample->rssi;
+        stats->ap_samples = 0;
+    } else {
+        link->avg_short_q4 += (rssi_q4 - link->avg_short_q4) >> SHORT_SHIFT;
+        link->avg_long_q4 += (rssi_q4 - link->avg_long_q4) >> LONG_SHIFT;
+        if (sample->rssi < stats->rssi_min) {
+            stats->rssi_min = sample->rssi;
+        }
+    }
+
+    link->ring[link->head & LINK_MASK] = *sample;
+    link->head++;
+    stats->last = *sample;
+    stats->rssi_avg_short = q4_to_dbm(link->avg_short_q4);
+    stats->rssi_avg_long = q4_to_dbm(link->avg_long_q4);
+    stats->ap_samples++;
+    stats->samples++;
+}
+
+void wifi_link_get_stats(const wifi_link_t *link, wifi_link_stats_t *stats) {
+    *stats = link->stats;
+}
+
+size_t wifi_link_get_history(const wifi_link_t *link, wifi_link_sample_t *out,
+                             size_t max) {
+    uint32_t available =
+        link->head < WIFI_LINK_HISTORY ? link->head : WIFI_LINK_HISTORY;
+    size_t count = available < max ? available : max;
+    uint32_t first = link->head - count;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = link->ring[(first + i) & LINK_MASK];
+    }
+    return count;
+}
+
+bool wifi_link_is_weak(const wifi_link_t *link, int8_t threshold_dbm) {
+    return link->stats.ap_samples >= SETTLE_SAMPLES &&
+           link->stats.rssi_avg_short < threshold_dbm;
+}
@@ -0,0 +1,60 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Link-quality history: one sample per sampler tick while connected, kept
+ * in a fixed ring, plus two exponential moving averages of the RSSI. The
+ * short one (about 4 samples) reacts to a robot driving away from its AP,
+ * the long one (about 32) shows the trend. Both restart when the BSSID
+ * changes. Plain C with no ESP-IDF dependencies so it also builds on the
+ * host; callers serialise access. */
+#define WIFI_LINK_HISTORY 64  // must be a power of two
+
+#define WIFI_LINK_PHY_11B 0x01
+#define WIFI_LINK_PHY_11G 0x02
+#define WIFI_LINK_PHY_11N 0x04
+#define WIFI_LINK_PHY_LR 0x08
+
+typedef struct {
+    uint32_t time_ms;  // since boot
+    int8_t rssi;       // dBm
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint8_t phy;  // WIFI_LINK_PHY_* the AP supports
+} wifi_link_sample_t;
+
+typedef struct {
+    wifi_link_sample_t last;
+    int8_t rssi_avg_short;  // dBm, rounded
+    int8_t rssi_avg_long;
+    int8_t rssi_min;      // since the last BSSID change
+    uint32_t ap_samples;  // since the last BSSID change
+    uint32_t samples;     // in total
+    uint32_t roam_scans;  // scans started because the link was weak
+    uint32_t roams;       // switches to a stronger AP
+} wifi_link_stats_t;
+
+typedef struct {
+    wifi_link_sample_t ring[WIFI_LINK_HISTORY];
+    uint32_t head;         // total samples added
+    int32_t avg_short_q4;  // dBm * 16
+    int32_t avg_long_q4;
+    wifi_link_stats_t stats;
+} wifi_link_t;
+
+void wifi_link_init(wifi_link_t *link);
+void wifi_link_add(wifi_link_t *link, const wifi_link_sample_t *sample);
+void wifi_link_get_stats(const wifi_link_t *link, wifi_link_stats_t *stats);
+
+// Copies up to max samples, oldest first; returns how many
+size_t wifi_link_get_history(const wifi_link_t *link, wifi_link_sample_t *out,
+                             size_t max);
+
+/* True when the short average has settled below threshold_dbm on the
+ * current AP */
+bool wifi_link_is_weak(const wifi_link_t *link, int8_t threshold_dbm);
+
+#endif  // WIFI_LINK_H
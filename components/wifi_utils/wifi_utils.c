@@ -3,59 +3,509 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "backoff.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "metrics.h"
+#include "settings.h"
+#include "wifi_fast.h"
 
-#define WIFI_SSID "#Telia-54AA98"
-#define WIFI_PASS "ZJY%=*pwZ1188cep"
-#define ESP_MAXIMUM_RETRY 3
-
-/* FreeRTOS event group to signal when we are connected*/
+/* Mirrors WIFI_STATE_CONNECTED so callers can block on it */
 static EventGroupHandle_t s_wifi_event_group;
-
-/* The event group allows multiple bits for each event, but we only care about
- * two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT BIT1
 
 static const char* TAG = "wifi station";
 
-static int s_retry_num = 0;
+METRIC_GAUGE(rssi_metric, "wifi_rssi_dbm",
+             "Short moving average of the AP signal strength");
+METRIC_COUNTER(roams_metric, "wifi_roams_total",
+               "Switches to a stronger AP after a weak link");
+
+static esp_netif_t* s_netif;
+static int64_t s_start_us;
+
+/* Our copy of the driver's station config. Changed by the event loop task
+ * (fast connect fallback) and by wifi_set_profile() from any task, so
+ * updates and the esp_wifi_set_config() that follows hold the lock. */
+static wifi_config_t s_wifi_config;
+static SemaphoreHandle_t s_config_lock;
+static bool s_driver_started;  // under s_config_lock
+static bool s_link_profile_pending;  // under s_config_lock, see connect()
+
+typedef struct {
+    wifi_ps_type_t ps;
+    uint16_t listen_interval;  // beacon intervals, used by WIFI_PS_MAX_MODEM
+    int8_t max_tx_power;       // 0.25 dBm units, 8..84
+    uint8_t protocol;          // WIFI_PROTOCOL_* bitmap
+} wifi_profile_def_t;
+
+/* Low latency drops 802.11b so the AP never falls back to its slow rates,
+ * and transmits at full power to keep the PHY rate up. Low power sleeps
+ * through ten beacons (about a second) between wakeups. */
+static const wifi_profile_def_t profiles[WIFI_PROFILE_COUNT] = {
+    [WIFI_PROFILE_LOW_LATENCY] = {.ps = WIFI_PS_NONE,
+                                  .listen_interval = 3,
+                                  .max_tx_power = 80,
+                                  .protocol = WIFI_PROTOCOL_11G |
+                                              WIFI_PROTOCOL_11N},
+    [WIFI_PROFILE_BALANCED] = {.ps = WIFI_PS_MIN_MODEM,
+                               .listen_interval = 3,
+                               .max_tx_power = 80,
+                               .protocol = WIFI_PROTOCOL_11B |
+                                           WIFI_PROTOCOL_11G |
+                                           WIFI_PROTOCOL_11N},
+    [WIFI_PROFILE_LOW_POWER] = {.ps = WIFI_PS_MAX_MODEM,
+                                .listen_interval = 10,
+                                .max_tx_power = 52,
+                                .protocol = WIFI_PROTOCOL_11B |
+                                            WIFI_PROTOCOL_11G |
+                                            WIFI_PROTOCOL_11N},
+};
+
+#if CONFIG_WIFI_PROFILE_LOW_LATENCY
+#define WIFI_PROFILE_DEFAULT WIFI_PROFILE_LOW_LATENCY
+#elif CONFIG_WIFI_PROFILE_LOW_POWER
+#define WIFI_PROFILE_DEFAULT WIFI_PROFILE_LOW_POWER
+#else
+#define WIFI_PROFILE_DEFAULT WIFI_PROFILE_BALANCED
+#endif
+
+static volatile wifi_profile_t s_profile = WIFI_PROFILE_DEFAULT;
+
+/* Written by the event loop task, and by the retry timer; the timer only
+ * runs in BACKOFF, when no attempt is in flight to raise events */
+static volatile wifi_state_t s_state = WIFI_STATE_IDLE;
+static esp_timer_handle_t s_retry_timer;
+static backoff_t s_backoff;
+
+typedef struct {
+    wifi_state_cb_t cb;
+    void* ctx;
+} wifi_subscriber_t;
+
+// Append only, so notifying needs no lock once the count is read
+static wifi_subscriber_t s_subscribers[WIFI_MAX_SUBSCRIBERS];
+static volatile int s_subscriber_count;
+static portMUX_TYPE s_subscribers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Link monitor: a periodic timer samples the AP while connected. When the
+ * short RSSI average stays below WIFI_ROAM_RSSI it scans for the same
+ * SSID (at most once per WIFI_ROAM_INTERVAL_S, since scanning takes the
+ * radio off channel), and pins the station to a clearly stronger AP. A
+ * pinned AP that fails is released like a failed fast connect. */
+static wifi_link_t s_link;
+static portMUX_TYPE s_link_lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_WIFI_LINK_MONITOR
+static esp_timer_handle_t s_link_timer;
+#endif
+#if CONFIG_WIFI_ROAM
+static int64_t s_roam_scan_us;
+#endif
+static bool s_roam_scanning;  // a roaming scan is running
+static bool s_roaming;        // disconnected on purpose to switch AP
+
+/* Fast connect: the first attempt goes straight to the cached BSSID and
+ * channel, optionally with the cached lease as a static IP. Any
+ * disconnect while pinned to that BSSID switches back to the normal scan
+ * and DHCP path; the next successful connection refreshes the cache. */
+static bool s_fast_attempt;  // until the fast attempt got an IP or failed
+static wifi_fast_cache_t s_connected_ap;  // saved once connected
+
+static void log_phase(const char* phase) {
+    int64_t now = esp_timer_get_time();
+    ESP_LOGI(TAG, "%s at %lld ms since boot (+%lld ms)%s", phase,
+             (long long)(now / 1000), (long long)((now - s_start_us) / 1000),
+             s_fast_attempt ? ", fast connect" : "");
+}
+
+const char* wifi_state_name(wifi_state_t state) {
+    switch (state) {
+        case WIFI_STATE_IDLE:
+            return "idle";
+        case WIFI_STATE_CONNECTING:
+            return "connecting";
+        case WIFI_STATE_CONNECTED:
+            return "connected";
+        case WIFI_STATE_BACKOFF:
+            return "backoff";
+    }
+    return "unknown";
+}
+
+static void set_state(wifi_state_t state) {
+    if (state == s_state) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s -> %s", wifi_state_name(s_state),
+             wifi_state_name(state));
+    s_state = state;
+    if (state == WIFI_STATE_CONNECTED) {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    } else {
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    }
+
+    int count = s_subscriber_count;
+    for (int i = 0; i < count; i++) {
+        s_subscribers[i].cb(state, s_subscribers[i].ctx);
+    }
+}
+
+#if CONFIG_WIFI_FAST_CONNECT
+static void fast_connect_apply(const wifi_fast_cache_t* ap) {
+    s_wifi_config.sta.bssid_set = true;
+    memcpy(s_wifi_config.sta.bssid, ap->bssid, sizeof(ap->bssid));
+    s_wifi_config.sta.channel = ap->channel;
+    s_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+#if CONFIG_WIFI_FAST_CONNECT_STATIC_IP
+    esp_netif_ip_info_t ip_info = {.ip.addr = ap->ip,
+                                   .netmask.addr = ap->netmask,
+                                   .gw.addr = ap->gw};
+    esp_netif_dns_info_t dns = {.ip.u_addr.ip4.addr = ap->dns,
+                                .ip.type = ESP_IPADDR_TYPE_V4};
+    esp_netif_dhcpc_stop(s_netif);
+    esp_netif_set_ip_info(s_netif, &ip_info);
+    esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+#endif
+    s_fast_attempt = true;
+    ESP_LOGI(TAG, "Connecting to the cached AP on channel %u",
+             ap->channel);
+}
+
+static void fast_connect_save(const char* ssid) {
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) ==
+        ESP_OK) {
+        s_connected_ap.dns = dns.ip.u_addr.ip4.addr;
+    }
+    wifi_fast_save(ssid, &s_connected_ap);
+}
+#endif
+
+// Cached (fast connect) or roamed-to AP gone: back to scanning and DHCP
+static void release_bssid(uint8_t reason) {
+    ESP_LOGW(TAG, "Lost the pinned AP (reason %u), scanning", reason);
+    s_fast_attempt = false;
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_wifi_config.sta.bssid_set = false;
+    s_wifi_config.sta.channel = 0;
+    s_wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+    xSemaphoreGive(s_config_lock);
+#if CONFIG_WIFI_FAST_CONNECT_STATIC_IP
+    esp_netif_dhcpc_start(s_netif);
+#endif
+}
+
+const char* wifi_profile_name(wifi_profile_t profile) {
+    switch (profile) {
+        case WIFI_PROFILE_LOW_LATENCY:
+            return "low-latency";
+        case WIFI_PROFILE_BALANCED:
+            return "balanced";
+        case WIFI_PROFILE_LOW_POWER:
+            return "low-power";
+        default:
+            return "unknown";
+    }
+}
+
+// Settings the driver takes before esp_wifi_start()
+static void profile_apply_initial(const wifi_profile_def_t* def) {
+    s_wifi_config.sta.listen_interval = def->listen_interval;
+    ESP_ERROR_CHECK(esp_wifi_set_protocol(WIFI_IF_STA, def->protocol));
+    ESP_ERROR_CHECK(esp_wifi_set_ps(def->ps));
+}
+
+esp_err_t wifi_set_profile(wifi_profile_t profile) {
+    if (profile >= WIFI_PROFILE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_config_lock == NULL) {
+        s_profile = profile;  // applied by wifi_start_async()
+        return ESP_OK;
+    }
+
+    const wifi_profile_def_t* def = &profiles[profile];
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_profile = profile;
+    if (!s_driver_started) {
+        xSemaphoreGive(s_config_lock);
+        return ESP_OK;
+    }
+    /* Setting the config or protocol while associated can drop the link,
+     * possibly the one this request came in on, so those wait for the
+     * next connect() */
+    s_link_profile_pending = true;
+    esp_err_t err = esp_wifi_set_ps(def->ps);
+    if (err == ESP_OK) {
+        err = esp_wifi_set_max_tx_power(def->max_tx_power);
+    }
+    xSemaphoreGive(s_config_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply the %s profile: %s",
+                 wifi_profile_name(profile), esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Profile %s, link settings from the next connection",
+             wifi_profile_name(profile));
+    return ESP_OK;
+}
+
+wifi_profile_t wifi_get_profile(void) {
+    return s_profile;
+}
+
+// Listen interval and PHY modes of a profile set while associated
+static void apply_link_profile(void) {
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    if (s_link_profile_pending) {
+        const wifi_profile_def_t* def = &profiles[s_profile];
+        s_link_profile_pending = false;
+        s_wifi_config.sta.listen_interval = def->listen_interval;
+        esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+        if (err == ESP_OK) {
+            err = esp_wifi_set_protocol(WIFI_IF_STA, def->protocol);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to apply the %s profile's link settings: %s",
+                     wifi_profile_name(s_profile), esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(s_config_lock);
+}
+
+static void connect(void) {
+    apply_link_profile();
+    set_state(WIFI_STATE_CONNECTING);
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_connect failed: %s", esp_err_to_name(err));
+    }
+}
+
+#if CONFIG_WIFI_LINK_MONITOR
+static uint8_t phy_bits(const wifi_ap_record_t* ap) {
+    return (ap->phy_11b ? WIFI_LINK_PHY_11B : 0) |
+           (ap->phy_11g ? WIFI_LINK_PHY_11G : 0) |
+           (ap->phy_11n ? WIFI_LINK_PHY_11N : 0) |
+           (ap->phy_lr ? WIFI_LINK_PHY_LR : 0);
+}
+
+#if CONFIG_WIFI_ROAM
+static void roam_scan_start(int64_t now) {
+    // Short dwell per channel to limit how long the link is off channel
+    const wifi_scan_config_t scan_config = {
+        .ssid = s_wifi_config.sta.ssid,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {.min = 20, .max = 40},
+    };
+    s_roam_scan_us = now;
+    if (esp_wifi_scan_start(&scan_config, false) == ESP_OK) {
+        s_roam_scanning = true;
+        taskENTER_CRITICAL(&s_link_lock);
+        s_link.stats.roam_scans++;
+        taskEXIT_CRITICAL(&s_link_lock);
+        ESP_LOGI(TAG, "Weak link, scanning for a stronger AP");
+    }
+}
+
+// Runs on SCAN_DONE: switches to the strongest other AP if clearly better
+static void roam_scan_done(void) {
+    static wifi_ap_record_t records[CONFIG_WIFI_ROAM_MAX_APS];
+    uint16_t count = CONFIG_WIFI_ROAM_MAX_APS;
+    s_roam_scanning = false;
+    if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK ||
+        s_state != WIFI_STATE_CONNECTED) {
+        return;
+    }
+
+    wifi_link_stats_t link;
+    taskENTER_CRITICAL(&s_link_lock);
+    wifi_link_get_stats(&s_link, &link);
+    taskEXIT_CRITICAL(&s_link_lock);
+
+    const wifi_ap_record_t* best = NULL;
+    for (int i = 0; i < count; i++) {
+        if (memcmp(records[i].bssid, link.last.bssid, 6) != 0 &&
+            records[i].rssi >=
+                link.rssi_avg_short + CONFIG_WIFI_ROAM_HYSTERESIS_DB &&
+            (best == NULL || records[i].rssi > best->rssi)) {
+            best = &records[i];
+        }
+    }
+    if (best == NULL) {
+        ESP_LOGI(TAG, "No AP stronger than %d dBm, staying",
+                 link.rssi_avg_short);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Roaming from %d dBm to " MACSTR " at %d dBm, channel %u",
+             link.rssi_avg_short, MAC2STR(best->bssid), best->rssi,
+             best->primary);
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_wifi_config.sta.bssid_set = true;
+    memcpy(s_wifi_config.sta.bssid, best->bssid, sizeof(best->bssid));
+    s_wifi_config.sta.channel = best->primary;
+    s_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+    xSemaphoreGive(s_config_lock);
+
+    taskENTER_CRITICAL(&s_link_lock);
+    s_link.stats.roams++;
+    taskEXIT_CRITICAL(&s_link_lock);
+    metric_inc(&roams_metric);
+    s_roaming = true;
+    esp_wifi_disconnect();
+}
+#endif
+
+static void link_timer_cb(void* arg) {
+    wifi_ap_record_t ap;
+    if (s_state != WIFI_STATE_CONNECTED ||
+        esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    wifi_link_sample_t sample = {
+        .time_ms = (uint32_t)(now / 1000),
+        .rssi = ap.rssi,
+        .channel = ap.primary,
+        .phy = phy_bits(&ap),
+    };
+    memcpy(sample.bssid, ap.bssid, sizeof(sample.bssid));
+
+    taskENTER_CRITICAL(&s_link_lock);
+    wifi_link_add(&s_link, &sample);
+    int8_t rssi_avg = s_link.stats.rssi_avg_short;
+    bool weak = wifi_link_is_weak(&s_link, CONFIG_WIFI_ROAM_RSSI);
+    taskEXIT_CRITICAL(&s_link_lock);
+    metric_set(&rssi_metric, rssi_avg);
+
+#if CONFIG_WIFI_ROAM
+    if (weak && !s_roam_scanning && !s_roaming &&
+        (s_roam_scan_us == 0 ||
+         now - s_roam_scan_us >= CONFIG_WIFI_ROAM_INTERVAL_S * 1000000LL)) {
+        roam_scan_start(now);
+    }
+#else
+    (void)weak;
+#endif
+}
+#endif
+
+static void retry_timer_cb(void* arg) {
+    connect();
+}
+
+static void schedule_retry(uint8_t reason) {
+    uint32_t delay_ms = backoff_next(&s_backoff, esp_random());
+    ESP_LOGI(TAG, "connect to the AP failed (reason %u), retry in %lu ms",
+             reason, (unsigned long)delay_ms);
+    set_state(WIFI_STATE_BACKOFF);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        connect();
+    } else if (event_base == WIFI_EVENT &&
+               event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = event_data;
+        log_phase("Associated");
+        memcpy(s_connected_ap.bssid, event->bssid, sizeof(event->bssid));
+        s_connected_ap.channel = event->channel;
     } else if (event_base == WIFI_EVENT &&
                event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < ESP_MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
+        wifi_event_sta_disconnected_t* event = event_data;
+        s_roam_scanning = false;  // the driver abandons a running scan
+        if (s_roaming) {
+            // Our own disconnect: go straight to the new AP
+            s_roaming = false;
+            connect();
+        } else if (s_wifi_config.sta.bssid_set) {
+            // Not a failure of the AP: scan for it right away
+            release_bssid(event->reason);
+            connect();
         } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            schedule_retry(event->reason);
         }
-        ESP_LOGI(TAG, "connect to the AP failed");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        log_phase("Got IP");
+        s_fast_attempt = false;
+        s_connected_ap.ip = event->ip_info.ip.addr;
+        s_connected_ap.netmask = event->ip_info.netmask.addr;
+        s_connected_ap.gw = event->ip_info.gw.addr;
+#if CONFIG_WIFI_FAST_CONNECT
+        fast_connect_save((const char*)s_wifi_config.sta.ssid);
+#endif
+        backoff_reset(&s_backoff);
+        set_state(WIFI_STATE_CONNECTED);
+#if CONFIG_WIFI_ROAM
+    } else if (event_base == WIFI_EVENT &&
+               event_id == WIFI_EVENT_SCAN_DONE) {
+        if (s_roam_scanning) {
+            roam_scan_done();
+        } else {
+            esp_wifi_clear_ap_list();  // abandoned by a disconnect
+        }
+#endif
     }
 }
 
-wifi_status_t wifi_init_sta(void) {
+esp_err_t wifi_start_async(void) {
+    if (s_wifi_event_group != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Credentials come from the settings store, or its Kconfig defaults
+    settings_init();
+    const char* ssid = settings_get_str(SETTING_WIFI_SSID);
+    s_start_us = esp_timer_get_time();
+
     s_wifi_event_group = xEventGroupCreate();
+    s_config_lock = xSemaphoreCreateMutex();
+    if (s_wifi_event_group == NULL || s_config_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create the Wi-Fi locks");
+        return ESP_ERR_NO_MEM;
+    }
+
+    metrics_register(&rssi_metric);
+    metrics_register(&roams_metric);
+    wifi_link_init(&s_link);
+    backoff_init(&s_backoff, CONFIG_WIFI_RETRY_BASE_MS,
+                 CONFIG_WIFI_RETRY_MAX_MS);
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
+#if CONFIG_WIFI_LINK_MONITOR
+    const esp_timer_create_args_t link_timer_args = {
+        .callback = link_timer_cb,
+        .name = "wifi_link",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&link_timer_args, &s_link_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(
+        s_link_timer, CONFIG_WIFI_LINK_SAMPLE_MS * 1000ULL));
+#endif
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -67,29 +517,86 @@ wifi_status_t wifi_init_sta(void) {
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, &instance_got_ip));
 
-    wifi_config_t wifi_config = {.sta = {
-                                     .ssid = WIFI_SSID,
-                                     .password = WIFI_PASS,
-                                 }};
+    strlcpy((char*)s_wifi_config.sta.ssid, ssid,
+            sizeof(s_wifi_config.sta.ssid));
+    strlcpy((char*)s_wifi_config.sta.password,
+            settings_get_str(SETTING_WIFI_PASS),
+            sizeof(s_wifi_config.sta.password));
 
+#if CONFIG_WIFI_FAST_CONNECT
+    wifi_fast_cache_t cached_ap;
+    if (wifi_fast_load(ssid, &cached_ap)) {
+        fast_connect_apply(&cached_ap);
+    }
+#endif
+
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    const wifi_profile_def_t* profile = &profiles[s_profile];
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    profile_apply_initial(profile);
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Only accepted once the driver runs
+    ESP_ERROR_CHECK(esp_wifi_set_max_tx_power(profile->max_tx_power));
+    s_driver_started = true;
+    xSemaphoreGive(s_config_lock);
 
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
-
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE, pdFALSE, portMAX_DELAY);
+    log_phase("Driver started");
+    ESP_LOGI(TAG, "Profile %s", wifi_profile_name(s_profile));
+    return ESP_OK;
+}
 
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP: %s", WIFI_SSID);
-        return WIFI_STATUS_SUCCESS;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGE(TAG, "Failed to connect to SSID: %s", WIFI_SSID);
-        return WIFI_STATUS_FAIL;
-    } else {
-        ESP_LOGE(TAG, "Unexpected event");
+wifi_status_t wifi_init_sta(void) {
+    if (wifi_start_async() != ESP_OK) {
         return WIFI_STATUS_FAIL;
     }
+    wifi_wait_connected(portMAX_DELAY);
+    ESP_LOGI(TAG, "Connected to AP: %s", (const char*)s_wifi_config.sta.ssid);
+    return WIFI_STATUS_SUCCESS;
+}
+
+wifi_state_t wifi_get_state(void) {
+    return s_state;
+}
+
+esp_err_t wifi_subscribe(wifi_state_cb_t cb, void* ctx) {
+    esp_err_t err = ESP_ERR_NO_MEM;
+    taskENTER_CRITICAL(&s_subscribers_lock);
+    int slot = s_subscriber_count;
+    if (slot < WIFI_MAX_SUBSCRIBERS) {
+        s_subscribers[slot].cb = cb;
+        s_subscribers[slot].ctx = ctx;
+        s_subscriber_count = slot + 1;
+        err = ESP_OK;
+    }
+    taskEXIT_CRITICAL(&s_subscribers_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No free subscriber slot");
+        return err;
+    }
+    cb(s_state, ctx);
+    return ESP_OK;
+}
+
+bool wifi_wait_connected(TickType_t timeout) {
+    if (s_wifi_event_group == NULL) {
+        return false;
+    }
+    EventBits_t bits = xEventGroupWaitBits(
+        s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+void wifi_get_link_stats(wifi_link_stats_t* stats) {
+    taskENTER_CRITICAL(&s_link_lock);
+    wifi_link_get_stats(&s_link, stats);
+    taskEXIT_CRITICAL(&s_link_lock);
+}
+
+size_t wifi_get_link_history(wifi_link_sample_t* out, size_t max) {
+    taskENTER_CRITICAL(&s_link_lock);
+    size_t count = wifi_link_get_history(&s_link, out, max);
+    taskEXIT_CRITICAL(&s_link_lock);
+    return count;
 }
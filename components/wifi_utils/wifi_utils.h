@@ -1,11 +1,70 @@
 #ifndef WIFI_UTILS_H
 #define WIFI_UTILS_H
 
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "wifi_link.h"
+
 typedef enum {
     WIFI_STATUS_SUCCESS = 0,
     WIFI_STATUS_FAIL = 1
 } wifi_status_t;
 
-wifi_status_t wifi_init_sta();
+/* Station connection state. Once started the station never gives up: a
+ * lost or failed connection waits in BACKOFF (capped exponential, with
+ * jitter) and tries again. */
+typedef enum {
+    WIFI_STATE_IDLE = 0,    // not started
+    WIFI_STATE_CONNECTING,  // associating or waiting for an IP
+    WIFI_STATE_CONNECTED,   // has an IP
+    WIFI_STATE_BACKOFF,     // waiting before the next attempt
+} wifi_state_t;
+
+#define WIFI_MAX_SUBSCRIBERS 4
+
+/* Called on the event loop or timer task at every state change; keep it
+ * short and do not block */
+typedef void (*wifi_state_cb_t)(wifi_state_t state, void* ctx);
+
+/* Starts the station and returns at once; the connection comes up in the
+ * background. Sockets bound to INADDR_ANY can be opened straight away. */
+esp_err_t wifi_start_async(void);
+
+// Blocking wrapper: wifi_start_async(), then waits for the first IP
+wifi_status_t wifi_init_sta(void);
+
+wifi_state_t wifi_get_state(void);
+const char* wifi_state_name(wifi_state_t state);
+
+// The callback also runs once right away with the current state
+esp_err_t wifi_subscribe(wifi_state_cb_t cb, void* ctx);
+
+// True once connected; false if the timeout ran out first
+bool wifi_wait_connected(TickType_t timeout);
+
+/* Radio trade-offs. LOW_LATENCY keeps the modem awake for teleop traffic
+ * (modem sleep alone adds tens of ms of jitter), LOW_POWER sleeps across
+ * several beacons for battery-powered nodes. BALANCED is the driver's
+ * default behaviour. */
+typedef enum {
+    WIFI_PROFILE_LOW_LATENCY = 0,
+    WIFI_PROFILE_BALANCED,
+    WIFI_PROFILE_LOW_POWER,
+    WIFI_PROFILE_COUNT
+} wifi_profile_t;
+
+/* Power save and TX power change at once; the listen interval and the
+ * protocol bitmap from the next association. Before wifi_start_async()
+ * this only replaces the Kconfig default. Safe from any task. */
+esp_err_t wifi_set_profile(wifi_profile_t profile);
+wifi_profile_t wifi_get_profile(void);
+const char* wifi_profile_name(wifi_profile_t profile);
+
+/* Link quality, sampled every WIFI_LINK_SAMPLE_MS while connected: RSSI
+ * moving averages and roaming counters, and the most recent samples */
+void wifi_get_link_stats(wifi_link_stats_t* stats);
+size_t wifi_get_link_history(wifi_link_sample_t* out, size_t max);
 
-#endif // WIFI_UTILS_H
+#endif  // WIFI_UTILS_H
@@ -1,51 +1,493 @@
+#include "http_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <unistd.h>
+
+#include "components/json_writer/json_writer.h"
+#include "components/static_assets/static_assets.h"
+#include "components/ws_control/ws_control.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "metrics.h"
+#include "settings.h"
 
 static const char *TAG = "http server";
 
-// Handler for GET /
+METRIC_COUNTER(http_requests, "http_requests_total",
+               "HTTP requests handled");
+METRIC_COUNTER(http_stream_frames, "http_stream_frames_total",
+               "Telemetry frames sent on /stream");
+METRIC_COUNTER(http_connections, "http_connections_total",
+               "TCP connections accepted");
+METRIC_GAUGE(http_open_sockets, "http_open_sockets",
+             "Client sockets currently open");
+METRIC_COUNTER(http_not_modified, "http_not_modified_total",
+               "Asset requests answered 304 from the ETag");
+METRIC_GAUGE(heap_free, "heap_free_bytes", "Free heap at scrape time");
+METRIC_GAUGE(heap_min_free, "heap_min_free_bytes",
+             "Lowest free heap since boot");
+
+/* One open /stream connection. The writer and its chunk buffer are reused
+ * for every frame so a stream allocates nothing after it starts. */
+typedef struct {
+    bool in_use;
+    httpd_req_t *req;
+    TickType_t period;
+    uint32_t seq;
+    json_writer_t writer;
+} stream_ctx_t;
+
+static stream_ctx_t streams[HTTP_STREAM_MAX_CLIENTS];
+static portMUX_TYPE streams_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Per-connection state, kept by httpd in the session context and freed when
+ * the socket closes, so keep-alive requests reuse it instead of rebuilding
+ * a writer on the server task stack each time. */
+typedef struct {
+    uint32_t requests;
+    json_writer_t writer;
+} session_t;
+
+// Only touched from the httpd task, through the open/close callbacks
+static int open_sockets;
+
+static session_t *session_get(httpd_req_t *req) {
+    if (req->sess_ctx == NULL) {
+        req->sess_ctx = calloc(1, sizeof(session_t));
+        req->free_ctx = free;
+    }
+    session_t *session = req->sess_ctx;
+    if (session != NULL) {
+        session->requests++;
+    }
+    return session;
+}
+
+// Handler for GET / when no asset image is flashed
 static esp_err_t root_get_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
     const char *response = "ESP32 HTTP Server Running!";
     httpd_resp_send(req, response, strlen(response));
     return ESP_OK;
 }
 
+static bool etag_matches(httpd_req_t *req, const char *etag) {
+    // Room for a weak "W/" prefix, which proxies add to gzipped responses
+    char value[STATIC_ASSET_ETAG_LEN + 2];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value,
+                                    sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    const char *tag = strncmp(value, "W/", 2) == 0 ? value + 2 : value;
+    return strcmp(tag, etag) == 0;
+}
+
+/* Handler for every other GET path. Assets are stored gzipped in mapped
+ * flash and sent as is, so the server never compresses or copies them.
+ * The ETag with no-cache makes browsers revalidate, which costs a 304 and
+ * no body. */
+static esp_err_t asset_get_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
+    const char *path = req->uri;
+    size_t path_len = strcspn(path, "?#");
+    if (path_len == 1) {
+        path = "/index.html";
+        path_len = strlen(path);
+    }
+
+    static_asset_t asset;
+    if (static_assets_find(path, path_len, &asset) != ESP_OK) {
+        return httpd_resp_send_404(req);
+    }
+
+    const static_asset_entry_t *entry = asset.entry;
+    httpd_resp_set_hdr(req, "ETag", entry->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (etag_matches(req, entry->etag)) {
+        metric_inc(&http_not_modified);
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, entry->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset.data, entry->size);
+}
+
+static uint32_t get_uptime(void) {
+    return esp_log_timestamp() / 1000;
+}
+
+static uint32_t get_task_count(void) {
+    return uxTaskGetNumberOfTasks();
+}
+
+// Telemetry reported by /health and /stream; add a metric with one entry
+static const json_field_t telemetry_fields[] = {
+    JSON_FIELD_U32("uptime", get_uptime),
+    JSON_FIELD_U32("free_heap", esp_get_free_heap_size),
+    JSON_FIELD_U32("min_free_heap", esp_get_minimum_free_heap_size),
+    JSON_FIELD_U32("tasks", get_task_count),
+};
+
+static int send_chunk(void *ctx, const char *buf, size_t len) {
+    return httpd_resp_send_chunk(ctx, buf, len) == ESP_OK ? 0 : -1;
+}
+
 // Handler for GET /health
 static esp_err_t health_get_handler(httpd_req_t *req) {
-    ESP_LOGE(TAG, "GET /health");
-    char response[128];
-    snprintf(response, sizeof(response),
-             "{ \"uptime\": %lu, \"free_heap\": %lu }",
-             esp_log_timestamp() / 1000, esp_get_free_heap_size());
+    ESP_LOGD(TAG, "GET /health");
+    metric_inc(&http_requests);
+    session_t *session = session_get(req);
+    if (session == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+    httpd_resp_set_type(req, "application/json");
 
+    json_writer_t *w = &session->writer;
+    json_writer_init(w, send_chunk, req);
+    json_begin_object(w);
+    json_write_fields(w, telemetry_fields,
+                      sizeof(telemetry_fields) / sizeof(telemetry_fields[0]));
+    json_end_object(w);
+    if (json_writer_finish(w) != 0) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Values this boot runs with; passwords only say whether one is set
+static esp_err_t send_config(httpd_req_t *req, json_writer_t *w) {
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, strlen(response));
+    json_writer_init(w, send_chunk, req);
+    json_begin_object(w);
+    json_key(w, "schema");
+    json_uint(w, SETTINGS_SCHEMA_VERSION);
+    json_key(w, "restart_needed");
+    json_bool(w, settings_restart_needed());
+    json_key(w, "settings");
+    json_begin_object(w);
+    for (int id = 0; id < SETTING_COUNT; id++) {
+        json_key(w, settings_name(id));
+        if (settings_type(id) == SETTING_TYPE_U32) {
+            json_uint(w, settings_get_u32(id));
+        } else if (settings_is_secret(id)) {
+            json_str(w, settings_get_str(id)[0] != '\0' ? "********" : "");
+        } else {
+            json_str(w, settings_get_str(id));
+        }
+    }
+    json_end_object(w);
+    json_end_object(w);
+    if (json_writer_finish(w) != 0) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Handler for GET /config
+static esp_err_t config_get_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
+    session_t *session = session_get(req);
+    if (session == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+    return send_config(req, &session->writer);
+}
+
+/* Handler for POST /config: a "token=<secret>" line, then "name=value"
+ * lines, stored in NVS and applied on the next boot. Answers with the
+ * GET /config document. Refused unless remote writes are enabled in
+ * menuconfig. */
+static esp_err_t config_post_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
+    char body[HTTP_CONFIG_MAX_BODY];
+    if (req->content_len > sizeof(body)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                   "Body too large");
+    }
+    size_t len = 0;
+    while (len < req->content_len) {
+        int n = httpd_req_recv(req, &body[len], req->content_len - len);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        len += n;
+    }
+
+    int bad_line;
+    esp_err_t err = settings_apply_remote(body, len, &bad_line);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN,
+                                   "Remote config disabled");
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Bad token");
+    }
+    if (err != ESP_OK) {
+        char message[64];
+        snprintf(message, sizeof(message), "Line %d: %s", bad_line,
+                 err == ESP_ERR_NOT_FOUND ? "unknown setting"
+                                          : esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, message);
+    }
+
+    session_t *session = session_get(req);
+    if (session == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+    return send_config(req, &session->writer);
+}
+
+static stream_ctx_t *stream_acquire(void) {
+    stream_ctx_t *ctx = NULL;
+    taskENTER_CRITICAL(&streams_lock);
+    for (int i = 0; i < HTTP_STREAM_MAX_CLIENTS; i++) {
+        if (!streams[i].in_use) {
+            streams[i].in_use = true;
+            ctx = &streams[i];
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&streams_lock);
+    return ctx;
+}
+
+static void stream_release(stream_ctx_t *ctx) {
+    taskENTER_CRITICAL(&streams_lock);
+    ctx->in_use = false;
+    taskEXIT_CRITICAL(&streams_lock);
+}
+
+// One SSE event per frame: "data: {...}\n\n", sent as a single chunk
+static esp_err_t send_telemetry_frame(stream_ctx_t *ctx) {
+    json_writer_t *w = &ctx->writer;
+    json_writer_init(w, send_chunk, ctx->req);
+    json_raw(w, "data: ", 6);
+    json_begin_object(w);
+    json_key(w, "seq");
+    json_uint(w, ctx->seq);
+    json_write_fields(w, telemetry_fields,
+                      sizeof(telemetry_fields) / sizeof(telemetry_fields[0]));
+    json_end_object(w);
+    json_raw(w, "\n\n", 2);
+    return json_writer_finish(w) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// Runs outside the httpd task so a long-lived stream does not block it
+static void stream_task(void *arg) {
+    stream_ctx_t *ctx = arg;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        if (send_telemetry_frame(ctx) != ESP_OK) {
+            ESP_LOGI(TAG, "/stream client gone after %lu frames",
+                     (unsigned long)ctx->seq);
+            break;
+        }
+        ctx->seq++;
+        metric_inc(&http_stream_frames);
+        vTaskDelayUntil(&last_wake, ctx->period);
+    }
+
+    httpd_req_async_handler_complete(ctx->req);
+    stream_release(ctx);
+    vTaskDelete(NULL);
+}
+
+static uint32_t stream_rate_hz(httpd_req_t *req) {
+    char query[32];
+    char value[8];
+    uint32_t hz = HTTP_STREAM_DEFAULT_HZ;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "hz", value, sizeof(value)) == ESP_OK) {
+        hz = strtoul(value, NULL, 10);
+    }
+    if (hz < 1) {
+        hz = 1;
+    } else if (hz > HTTP_STREAM_MAX_HZ) {
+        hz = HTTP_STREAM_MAX_HZ;
+    }
+    return hz;
+}
+
+// Handler for GET /stream: Server-Sent Events telemetry at ?hz=N
+static esp_err_t stream_get_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
+    stream_ctx_t *ctx = stream_acquire();
+    if (ctx == NULL) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Too many streams", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    uint32_t hz = stream_rate_hz(req);
+    ctx->period = MAX(pdMS_TO_TICKS(1000 / hz), 1);
+    ctx->seq = 0;
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if (httpd_req_async_handler_begin(req, &ctx->req) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach /stream request");
+        stream_release(ctx);
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(stream_task, "http_stream", 3072, ctx, 4, NULL) !=
+        pdPASS) {
+        ESP_LOGE(TAG, "Failed to create /stream task");
+        httpd_req_async_handler_complete(ctx->req);
+        stream_release(ctx);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "/stream started at %lu Hz", (unsigned long)hz);
     return ESP_OK;
 }
 
-static void register_routes(httpd_handle_t server) {
+// Handler for GET /metrics: Prometheus text exposition format
+static esp_err_t metrics_get_handler(httpd_req_t *req) {
+    metric_inc(&http_requests);
+    metric_set(&heap_free, esp_get_free_heap_size());
+    metric_set(&heap_min_free, esp_get_minimum_free_heap_size());
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    if (metrics_render_prometheus(send_chunk, req) != 0) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static void register_routes(httpd_handle_t server, bool have_assets) {
     httpd_uri_t root_uri = {.uri = "/",
                             .method = HTTP_GET,
                             .handler = root_get_handler,
                             .user_ctx = NULL};
 
+    httpd_uri_t ws_uri = {.uri = "/ws",
+                          .method = HTTP_GET,
+                          .handler = ws_control_handler,
+                          .user_ctx = NULL,
+                          .is_websocket = true};
+
+    // Registered last: the wildcard would otherwise shadow the API routes
+    httpd_uri_t asset_uri = {.uri = "/*",
+                             .method = HTTP_GET,
+                             .handler = asset_get_handler,
+                             .user_ctx = NULL};
+
     httpd_uri_t health_uri = {.uri = "/health",
                               .method = HTTP_GET,
                               .handler = health_get_handler,
                               .user_ctx = NULL};
 
-    httpd_register_uri_handler(server, &root_uri);
+    httpd_uri_t stream_uri = {.uri = "/stream",
+                              .method = HTTP_GET,
+                              .handler = stream_get_handler,
+                              .user_ctx = NULL};
+
+    httpd_uri_t metrics_uri = {.uri = "/metrics",
+                               .method = HTTP_GET,
+                               .handler = metrics_get_handler,
+                               .user_ctx = NULL};
+
+    httpd_uri_t config_get_uri = {.uri = "/config",
+                                  .method = HTTP_GET,
+                                  .handler = config_get_handler,
+                                  .user_ctx = NULL};
+
+    httpd_uri_t config_post_uri = {.uri = "/config",
+                                   .method = HTTP_POST,
+                                   .handler = config_post_handler,
+                                   .user_ctx = NULL};
+
     httpd_register_uri_handler(server, &health_uri);
+    httpd_register_uri_handler(server, &stream_uri);
+    httpd_register_uri_handler(server, &metrics_uri);
+    httpd_register_uri_handler(server, &config_get_uri);
+    httpd_register_uri_handler(server, &config_post_uri);
+    httpd_register_uri_handler(server, &ws_uri);
+    if (have_assets) {
+        httpd_register_uri_handler(server, &asset_uri);
+    } else {
+        httpd_register_uri_handler(server, &root_uri);
+    }
+}
+
+static esp_err_t on_sock_open(httpd_handle_t server, int sockfd) {
+    metric_inc(&http_connections);
+    metric_set(&http_open_sockets, ++open_sockets);
+    return ESP_OK;
 }
 
+// Also called for sockets evicted by the LRU purge; must close the socket
+static void on_sock_close(httpd_handle_t server, int sockfd) {
+    metric_set(&http_open_sockets, --open_sockets);
+    close(sockfd);
+}
+
+#if CONFIG_HTTP_SERVER_PROFILE_PERFORMANCE
+#if CONFIG_HTTP_SERVER_MAX_OPEN_SOCKETS > CONFIG_LWIP_MAX_SOCKETS - 3
+#error "HTTP_SERVER_MAX_OPEN_SOCKETS needs LWIP_MAX_SOCKETS raised to match"
+#endif
+
+static void apply_performance_profile(httpd_config_t *config) {
+    config->max_open_sockets = CONFIG_HTTP_SERVER_MAX_OPEN_SOCKETS;
+    config->max_uri_handlers = CONFIG_HTTP_SERVER_MAX_URI_HANDLERS;
+    config->backlog_conn = CONFIG_HTTP_SERVER_BACKLOG;
+    // A new client evicts the idlest socket instead of being refused
+    config->lru_purge_enable = true;
+    // Reclaim sockets whose peer vanished without a FIN
+    config->keep_alive_enable = true;
+    config->keep_alive_idle = CONFIG_HTTP_SERVER_KEEP_ALIVE_IDLE;
+    config->keep_alive_interval = 2;
+    config->keep_alive_count = 3;
+    config->task_priority = CONFIG_HTTP_SERVER_PRIORITY;
+#if CONFIG_FREERTOS_UNICORE || CONFIG_HTTP_SERVER_CORE < 0
+    config->core_id = tskNO_AFFINITY;
+#else
+    config->core_id = CONFIG_HTTP_SERVER_CORE;
+#endif
+}
+#endif
+
 httpd_handle_t start_http_server() {
+    metrics_register(&http_requests);
+    metrics_register(&http_stream_frames);
+    metrics_register(&http_connections);
+    metrics_register(&http_open_sockets);
+    metrics_register(&http_not_modified);
+    metrics_register(&heap_free);
+    metrics_register(&heap_min_free);
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+#if CONFIG_HTTP_SERVER_PROFILE_PERFORMANCE
+    apply_performance_profile(&config);
+#endif
+    config.open_fn = on_sock_open;
+    config.close_fn = on_sock_close;
+    config.uri_match_fn = httpd_uri_match_wildcard;
     httpd_handle_t server = NULL;
 
     if (httpd_start(&server, &config) == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP server started on port %d", config.server_port);
-        register_routes(server);
+        ESP_LOGI(TAG, "HTTP server started on port %d (%d sockets, lru %s)",
+                 config.server_port, config.max_open_sockets,
+                 config.lru_purge_enable ? "on" : "off");
+        register_routes(server, static_assets_init() == ESP_OK);
     } else {
         ESP_LOGE(TAG, "Failed to start HTTP server");
     }
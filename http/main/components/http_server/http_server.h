@@ -3,6 +3,15 @@
 
 #include "esp_http_server.h"
 
+/* /stream pushes Server-Sent Events telemetry over one kept-open
+ * connection; the rate is chosen per client with ?hz=N. */
+#define HTTP_STREAM_MAX_CLIENTS 2
+#define HTTP_STREAM_DEFAULT_HZ 10
+#define HTTP_STREAM_MAX_HZ 50
+
+// Largest POST /config body
+#define HTTP_CONFIG_MAX_BODY 512
+
 httpd_handle_t start_http_server();
 
 #endif  // SERVER_H
@@ -0,0 +1,220 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+static void flush(json_writer_t *w) {
+    if (w->len > 0 && w->error == 0) {
+        w->error = w->flush(w->ctx, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void put(json_writer_t *w, const char *data, size_t len) {
+    while (len > 0) {
+        if (w->len == sizeof(w->buf)) {
+            flush(w);
+        }
+        size_t n = sizeof(w->buf) - w->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&w->buf[w->len], data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void put_char(json_writer_t *w, char c) {
+    if (w->len == sizeof(w->buf)) {
+        flush(w);
+    }
+    w->buf[w->len++] = c;
+}
+
+// Emits the separator a new value needs at the current depth
+static void begin_value(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void put_uint(json_writer_t *w, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) {
+        put_char(w, digits[--n]);
+    }
+}
+
+static void put_escaped(json_writer_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+            put_char(w, c);
+        } else if (c < 0x20) {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            put(w, esc, sizeof(esc));
+        } else {
+            put_char(w, c);
+        }
+    }
+    put_char(w, '"');
+}
+
+void json_writer_init(json_writer_t *w, json_flush_fn_t flush_fn, void *ctx) {
+    w->len = 0;
+    w->depth = 0;
+    w->has_items = 0;
+    w->after_key = false;
+    w->error = 0;
+    w->flush = flush_fn;
+    w->ctx = ctx;
+}
+
+int json_writer_finish(json_writer_t *w) {
+    flush(w);
+    return w->error;
+}
+
+// Past the depth limit the comma state is lost, so nothing more is sent
+static void begin_container(json_writer_t *w, char open) {
+    begin_value(w);
+    put_char(w, open);
+    if (w->depth + 1 < JSON_WRITER_MAX_DEPTH) {
+        w->depth++;
+        w->has_items &= ~(1u << w->depth);
+    } else if (w->error == 0) {
+        w->error = JSON_WRITER_ERR_DEPTH;
+    }
+}
+
+static void end_container(json_writer_t *w, char close) {
+    if (w->depth > 0) {
+        w->depth--;
+    }
+    put_char(w, close);
+}
+
+void json_begin_object(json_writer_t *w) {
+    begin_container(w, '{');
+}
+
+void json_end_object(json_writer_t *w) {
+    end_container(w, '}');
+}
+
+void json_begin_array(json_writer_t *w) {
+    begin_container(w, '[');
+}
+
+void json_end_array(json_writer_t *w) {
+    end_container(w, ']');
+}
+
+void json_key(json_writer_t *w, const char *key) {
+    begin_value(w);
+    put_escaped(w, key);
+    put_char(w, ':');
+    w->after_key = true;
+}
+
+void json_uint(json_writer_t *w, uint64_t value) {
+    begin_value(w);
+    put_uint(w, value);
+}
+
+void json_int(json_writer_t *w, int64_t value) {
+    begin_value(w);
+    if (value < 0) {
+        put_char(w, '-');
+        put_uint(w, (uint64_t)0 - (uint64_t)value);
+    } else {
+        put_uint(w, (uint64_t)value);
+    }
+}
+
+void json_bool(json_writer_t *w, bool value) {
+    begin_value(w);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_null(json_writer_t *w) {
+    begin_value(w);
+    put(w, "null", 4);
+}
+
+void json_str(json_writer_t *w, const char *value) {
+    if (value == NULL) {
+        json_null(w);
+        return;
+    }
+    begin_value(w);
+    put_escaped(w, value);
+}
+
+void json_fixed(json_writer_t *w, int32_t value, uint8_t decimals) {
+    begin_value(w);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    if (value < 0) {
+        put_char(w, '-');
+    }
+    put_uint(w, magnitude / scale);
+    if (decimals > 0) {
+        put_char(w, '.');
+        uint32_t frac = magnitude % scale;
+        for (scale /= 10; scale > 0; scale /= 10) {
+            put_char(w, '0' + (frac / scale) % 10);
+        }
+    }
+}
+
+void json_raw(json_writer_t *w, const char *data, size_t len) {
+    put(w, data, len);
+}
+
+void json_write_fields(json_writer_t *w, const json_field_t *fields,
+                       size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const json_field_t *f = &fields[i];
+        json_key(w, f->key);
+        switch (f->type) {
+            case JSON_FIELD_TYPE_U32:
+                json_uint(w, f->get.u32());
+                break;
+            case JSON_FIELD_TYPE_I32:
+                json_int(w, f->get.i32());
+                break;
+            case JSON_FIELD_TYPE_U64:
+                json_uint(w, f->get.u64());
+                break;
+            case JSON_FIELD_TYPE_BOOL:
+                json_bool(w, f->get.boolean());
+                break;
+            case JSON_FIELD_TYPE_STR:
+                json_str(w, f->get.str());
+                break;
+        }
+    }
+}
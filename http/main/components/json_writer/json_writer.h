@@ -0,0 +1,90 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming JSON writer. Output is collected in a fixed-size chunk buffer
+ * and handed to the flush callback whenever it fills up, so documents of
+ * any size are written without heap allocation or truncation. Plain C so
+ * it also builds on the host. */
+#define JSON_WRITER_CHUNK_SIZE 256
+#define JSON_WRITER_MAX_DEPTH 16
+// From json_writer_finish when containers nest JSON_WRITER_MAX_DEPTH deep
+#define JSON_WRITER_ERR_DEPTH (-1)
+
+// Returns 0 on success; any other value stops the writer
+typedef int (*json_flush_fn_t)(void *ctx, const char *buf, size_t len);
+
+typedef struct {
+    char buf[JSON_WRITER_CHUNK_SIZE];
+    size_t len;
+    uint8_t depth;
+    uint32_t has_items;  // bit n: container at depth n needs a comma
+    bool after_key;
+    int error;
+    json_flush_fn_t flush;
+    void *ctx;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, json_flush_fn_t flush, void *ctx);
+
+// Flushes what is buffered; returns the first flush error, or 0
+int json_writer_finish(json_writer_t *w);
+
+void json_begin_object(json_writer_t *w);
+void json_end_object(json_writer_t *w);
+void json_begin_array(json_writer_t *w);
+void json_end_array(json_writer_t *w);
+void json_key(json_writer_t *w, const char *key);
+
+void json_uint(json_writer_t *w, uint64_t value);
+void json_int(json_writer_t *w, int64_t value);
+void json_bool(json_writer_t *w, bool value);
+void json_null(json_writer_t *w);
+void json_str(json_writer_t *w, const char *value);
+// value / 10^decimals, e.g. json_fixed(w, -1234, 2) writes -12.34
+void json_fixed(json_writer_t *w, int32_t value, uint8_t decimals);
+
+// Copies bytes verbatim, for framing around a document (e.g. SSE)
+void json_raw(json_writer_t *w, const char *data, size_t len);
+
+/* Compile-time field descriptors: a metric is one table entry that names
+ * its key and getter. */
+typedef enum {
+    JSON_FIELD_TYPE_U32,
+    JSON_FIELD_TYPE_I32,
+    JSON_FIELD_TYPE_U64,
+    JSON_FIELD_TYPE_BOOL,
+    JSON_FIELD_TYPE_STR,
+} json_field_type_t;
+
+typedef struct {
+    const char *key;
+    json_field_type_t type;
+    union {
+        uint32_t (*u32)(void);
+        int32_t (*i32)(void);
+        uint64_t (*u64)(void);
+        bool (*boolean)(void);
+        const char *(*str)(void);
+    } get;
+} json_field_t;
+
+#define JSON_FIELD_U32(k, fn) \
+    { .key = (k), .type = JSON_FIELD_TYPE_U32, .get.u32 = (fn) }
+#define JSON_FIELD_I32(k, fn) \
+    { .key = (k), .type = JSON_FIELD_TYPE_I32, .get.i32 = (fn) }
+#define JSON_FIELD_U64(k, fn) \
+    { .key = (k), .type = JSON_FIELD_TYPE_U64, .get.u64 = (fn) }
+#define JSON_FIELD_BOOL(k, fn) \
+    { .key = (k), .type = JSON_FIELD_TYPE_BOOL, .get.boolean = (fn) }
+#define JSON_FIELD_STR(k, fn) \
+    { .key = (k), .type = JSON_FIELD_TYPE_STR, .get.str = (fn) }
+
+// Writes one key/value pair per descriptor into the current object
+void json_write_fields(json_writer_t *w, const json_field_t *fields,
+                       size_t count);
+
+#endif  // JSON_WRITER_H
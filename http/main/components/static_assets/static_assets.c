@@ -0,0 +1,85 @@
+#include "static_assets.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "static assets";
+
+static const uint8_t *image = NULL;
+static const static_asset_entry_t *entries = NULL;
+static uint32_t entry_count = 0;
+
+static bool entry_valid(const static_asset_entry_t *e, uint32_t image_size) {
+    return memchr(e->path, '\0', sizeof(e->path)) != NULL &&
+           memchr(e->type, '\0', sizeof(e->type)) != NULL &&
+           memchr(e->etag, '\0', sizeof(e->etag)) != NULL &&
+           e->offset <= image_size && e->size <= image_size - e->offset;
+}
+
+esp_err_t static_assets_init(void) {
+    const esp_partition_t *partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+        STATIC_ASSETS_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "No \"%s\" partition", STATIC_ASSETS_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Mapped for the lifetime of the server, so the handle is never freed
+    const void *map = NULL;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size,
+                                       ESP_PARTITION_MMAP_DATA, &map, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map partition: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const static_assets_header_t *header = map;
+    if (header->magic != STATIC_ASSETS_MAGIC ||
+        header->image_size > partition->size ||
+        header->count > (header->image_size - sizeof(*header)) /
+                            sizeof(static_asset_entry_t)) {
+        ESP_LOGE(TAG, "Partition holds no asset image; flash it with "
+                      "idf.py flash");
+        esp_partition_munmap(handle);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const static_asset_entry_t *table = (const void *)(header + 1);
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (!entry_valid(&table[i], header->image_size)) {
+            ESP_LOGE(TAG, "Asset entry %lu is corrupt", (unsigned long)i);
+            esp_partition_munmap(handle);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    image = map;
+    entries = table;
+    entry_count = header->count;
+    ESP_LOGI(TAG, "%lu assets, %lu bytes", (unsigned long)entry_count,
+             (unsigned long)header->image_size);
+    return ESP_OK;
+}
+
+esp_err_t static_assets_find(const char *path, size_t path_len,
+                             static_asset_t *asset) {
+    if (path_len >= STATIC_ASSET_PATH_LEN) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // A handful of assets: a linear scan beats anything fancier
+    for (uint32_t i = 0; i < entry_count; i++) {
+        const static_asset_entry_t *e = &entries[i];
+        if (strncmp(e->path, path, path_len) == 0 &&
+            e->path[path_len] == '\0') {
+            asset->entry = e;
+            asset->data = image + e->offset;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,48 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/* Read-only asset image written by tools/www_pack.py to the "www" flash
+ * partition: a header, a table of entries, then the gzip-compressed file
+ * contents. Everything the HTTP response needs (type, ETag) is stored
+ * preformatted so serving an asset is a lookup and a send straight out of
+ * memory-mapped flash. All integers are little-endian. */
+#define STATIC_ASSETS_PARTITION "www"
+#define STATIC_ASSETS_MAGIC 0x31575757  // "WWW1"
+
+#define STATIC_ASSET_PATH_LEN 48
+#define STATIC_ASSET_TYPE_LEN 32
+#define STATIC_ASSET_ETAG_LEN 24
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t image_size;
+    uint32_t reserved;
+} static_assets_header_t;
+
+typedef struct {
+    char path[STATIC_ASSET_PATH_LEN];  // "/index.html", NUL terminated
+    char type[STATIC_ASSET_TYPE_LEN];  // Content-Type
+    char etag[STATIC_ASSET_ETAG_LEN];  // quoted, hash of the raw file
+    uint32_t offset;                   // from the start of the image
+    uint32_t size;                     // gzip-compressed length
+} static_asset_entry_t;
+
+typedef struct {
+    const static_asset_entry_t *entry;
+    const uint8_t *data;  // gzip bytes, in mapped flash
+} static_asset_t;
+
+// Maps the partition and validates the image; safe to call once at startup
+esp_err_t static_assets_init(void);
+
+// Returns ESP_ERR_NOT_FOUND if the path is not in the image
+esp_err_t static_assets_find(const char *path, size_t path_len,
+                             static_asset_t *asset);
+
+#endif  // STATIC_ASSETS_H
@@ -0,0 +1,195 @@
+#include "ws_control.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "robot_cmd_seq.h"
+
+static const char *TAG = "ws control";
+
+METRIC_COUNTER(ws_frames_metric, "ws_cmd_frames_total",
+               "Command frames received on /ws");
+METRIC_COUNTER(ws_rejected_metric, "ws_cmd_rejected_total",
+               "/ws frames that failed to decode");
+METRIC_COUNTER(ws_stale_metric, "ws_cmd_stale_total",
+               "/ws commands dropped as stale or duplicate");
+METRIC_COUNTER(ws_batches_metric, "ws_tx_batches_total",
+               "Echo messages sent on /ws");
+
+/* One open /ws connection. Buffers are preallocated so receiving and
+ * echoing frames never touches the heap. */
+typedef struct {
+    bool in_use;
+    bool flush_queued;
+    int fd;
+    uint64_t sender_id;
+    httpd_handle_t server;
+    size_t tx_len;
+    uint8_t rx[WS_CONTROL_BUF_SIZE];
+    uint8_t tx[WS_CONTROL_BUF_SIZE];
+} ws_conn_t;
+
+/* Frame handlers, queued work and session cleanup all run on the httpd
+ * task, so none of this state needs a lock */
+static ws_conn_t conns[WS_CONTROL_MAX_CLIENTS];
+static ws_control_config_t ws_config = WS_CONTROL_DEFAULT_CONFIG();
+static robot_cmd_seq_t cmd_seq;
+static uint32_t connection_count;
+
+void ws_control_init(const ws_control_config_t *config) {
+    ws_config = *config;
+    metrics_register(&ws_frames_metric);
+    metrics_register(&ws_rejected_metric);
+    metrics_register(&ws_stale_metric);
+    metrics_register(&ws_batches_metric);
+}
+
+static ws_conn_t *conn_acquire(void) {
+    for (int i = 0; i < WS_CONTROL_MAX_CLIENTS; i++) {
+        if (!conns[i].in_use) {
+            conns[i].in_use = true;
+            conns[i].flush_queued = false;
+            conns[i].tx_len = 0;
+            return &conns[i];
+        }
+    }
+    return NULL;
+}
+
+// Session free callback: httpd calls it when the socket closes
+static void conn_release(void *ctx) {
+    ws_conn_t *conn = ctx;
+    ESP_LOGI(TAG, "/ws client on fd %d closed", conn->fd);
+    conn->in_use = false;
+    conn->tx_len = 0;
+}
+
+static void conn_flush(ws_conn_t *conn) {
+    if (conn->tx_len == 0) {
+        return;
+    }
+    httpd_ws_frame_t frame = {.final = true,
+                              .type = HTTPD_WS_TYPE_BINARY,
+                              .payload = conn->tx,
+                              .len = conn->tx_len};
+    conn->tx_len = 0;
+    if (httpd_ws_send_frame_async(conn->server, conn->fd, &frame) == ESP_OK) {
+        metric_inc(&ws_batches_metric);
+    } else {
+        ESP_LOGW(TAG, "Echo to fd %d failed", conn->fd);
+    }
+}
+
+/* Queued behind the sockets httpd is already servicing, so the echoes for
+ * every frame that arrived in the meantime go out as one message */
+static void flush_work(void *arg) {
+    ws_conn_t *conn = arg;
+    conn->flush_queued = false;
+    if (conn->in_use) {
+        conn_flush(conn);
+    }
+}
+
+static void queue_echo(ws_conn_t *conn, const uint8_t *frame) {
+    if (conn->tx_len + ROBOT_CMD_FRAME_SIZE > sizeof(conn->tx)) {
+        conn_flush(conn);
+    }
+    memcpy(&conn->tx[conn->tx_len], frame, ROBOT_CMD_FRAME_SIZE);
+    conn->tx_len += ROBOT_CMD_FRAME_SIZE;
+
+    if (!conn->flush_queued) {
+        if (httpd_queue_work(conn->server, flush_work, conn) == ESP_OK) {
+            conn->flush_queued = true;
+        } else {
+            conn_flush(conn);
+        }
+    }
+}
+
+// Same path as a UDP command: decode, sequence check, then the table
+static void dispatch_frame(ws_conn_t *conn, const uint8_t *buf) {
+    metric_inc(&ws_frames_metric);
+    if (ws_config.commands != NULL) {
+        robot_cmd_t cmd;
+        robot_cmd_status_t status =
+            robot_cmd_decode(buf, ROBOT_CMD_FRAME_SIZE, &cmd);
+        if (status != ROBOT_CMD_OK) {
+            metric_inc(&ws_rejected_metric);
+            ESP_LOGD(TAG, "Rejected frame: %s", robot_cmd_status_str(status));
+        } else {
+            uint32_t one_way_us;
+            if (robot_cmd_seq_check(&cmd_seq, conn->sender_id, &cmd,
+                                    esp_timer_get_time(),
+                                    &one_way_us) == ROBOT_CMD_SEQ_ACCEPT) {
+                robot_cmd_handle(ws_config.commands, &cmd);
+            } else {
+                metric_inc(&ws_stale_metric);
+            }
+        }
+    }
+
+    if (ws_config.echo) {
+        queue_echo(conn, buf);
+    }
+}
+
+static esp_err_t open_connection(httpd_req_t *req) {
+    ws_conn_t *conn = conn_acquire();
+    if (conn == NULL) {
+        ESP_LOGW(TAG, "No free /ws slot, closing");
+        return ESP_FAIL;
+    }
+    conn->server = req->handle;
+    conn->fd = httpd_req_to_sockfd(req);
+    // New id per connection so a reused fd starts a fresh sequence
+    connection_count++;
+    conn->sender_id = ((uint64_t)connection_count << 32) | (uint32_t)conn->fd;
+
+    // httpd frees whatever session state earlier requests left on this
+    // socket once it sees the context change
+    req->sess_ctx = conn;
+    req->free_ctx = conn_release;
+    ESP_LOGI(TAG, "/ws client on fd %d", conn->fd);
+    return ESP_OK;
+}
+
+esp_err_t ws_control_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // httpd has already completed the upgrade handshake
+        return open_connection(req);
+    }
+
+    ws_conn_t *conn = req->sess_ctx;
+    if (conn == NULL) {
+        return ESP_FAIL;
+    }
+
+    // Read the header first so an oversized message is refused unread
+    httpd_ws_frame_t frame = {.payload = NULL};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len > sizeof(conn->rx)) {
+        ESP_LOGW(TAG, "%u byte message exceeds %u, closing",
+                 (unsigned)frame.len, (unsigned)sizeof(conn->rx));
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    frame.payload = conn->rx;
+    err = httpd_ws_recv_frame(req, &frame, sizeof(conn->rx));
+    if (err != ESP_OK || frame.type != HTTPD_WS_TYPE_BINARY) {
+        return err;
+    }
+
+    if (frame.len % ROBOT_CMD_FRAME_SIZE != 0) {
+        metric_inc(&ws_rejected_metric);
+    }
+    for (size_t off = 0; off + ROBOT_CMD_FRAME_SIZE <= frame.len;
+         off += ROBOT_CMD_FRAME_SIZE) {
+        dispatch_frame(conn, &conn->rx[off]);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,35 @@
+#ifndef WS_CONTROL_H
+#define WS_CONTROL_H
+
+#include <stdbool.h>
+
+#include "esp_http_server.h"
+#include "robot_cmd.h"
+
+/* /ws carries the same binary robot_cmd frames as the udp project. A
+ * WebSocket message holds one or more back-to-back frames; each one is
+ * sequence checked and dispatched like a UDP command. With echo on, every
+ * frame is sent back, with the replies to frames that arrive together
+ * coalesced into one message. */
+#define WS_CONTROL_MAX_CLIENTS 2
+#define WS_CONTROL_BATCH_FRAMES 16
+#define WS_CONTROL_BUF_SIZE (WS_CONTROL_BATCH_FRAMES * ROBOT_CMD_FRAME_SIZE)
+
+typedef struct {
+    const robot_cmd_table_t *commands;  // NULL: frames are only echoed
+    bool echo;
+} ws_control_config_t;
+
+#define WS_CONTROL_DEFAULT_CONFIG() \
+    {                               \
+        .commands = NULL,           \
+        .echo = true,               \
+    }
+
+// Call before start_http_server(); the config is copied
+void ws_control_init(const ws_control_config_t *config);
+
+// Registered by the HTTP server for /ws with is_websocket set
+esp_err_t ws_control_handler(httpd_req_t *req);
+
+#endif  // WS_CONTROL_H
@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "components/http_server/http_server.h"
+#include "components/ws_control/ws_control.h"
 #include "wifi_utils.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -10,6 +11,24 @@
 
 static const char* TAG = "http server";
 
+static void on_stop(const robot_cmd_t* cmd, void* ctx) {
+    ESP_LOGD(TAG, "STOP seq=%u", cmd->seq);
+}
+
+static void on_drive(const robot_cmd_t* cmd, void* ctx) {
+    int16_t left = (int16_t)(cmd->payload[0] | (cmd->payload[1] << 8));
+    int16_t right = (int16_t)(cmd->payload[2] | (cmd->payload[3] << 8));
+    ESP_LOGD(TAG, "DRIVE seq=%u left=%d right=%d", cmd->seq, left, right);
+}
+
+static const robot_cmd_table_t command_table = {
+    .handlers =
+        {
+            [ROBOT_CMD_STOP] = on_stop,
+            [ROBOT_CMD_DRIVE] = on_drive,
+        },
+};
+
 void app_main() {
     esp_err_t nvs_err = nvs_flash_init();
     if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES ||
@@ -19,14 +38,18 @@ void app_main() {
     }
     ESP_ERROR_CHECK(nvs_err);
 
+    // The server listens on every interface, so it can start before the
+    // station has an address; Wi-Fi keeps reconnecting in the background
     ESP_LOGI(TAG, "Connecting to wi-fi ESP_WIFI_MODE_STA...");
-    wifi_status_t status = wifi_init_sta();
-    if (status == WIFI_STATUS_FAIL) {
-        ESP_LOGE(TAG, "Wi-Fi connection failed. Stopping execution.");
+    if (wifi_start_async() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi failed to start. Stopping execution.");
         return;
     }
 
     ESP_LOGI(TAG, "Starting HTTP server...");
+    ws_control_config_t ws_config = WS_CONTROL_DEFAULT_CONFIG();
+    ws_config.commands = &command_table;
+    ws_control_init(&ws_config);
     start_http_server();
 
     while (true) {
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Load test for the http project's server.
+
+Runs concurrent clients against one path for the given duration and
+reports requests/sec, latency and the rate of refused or reset connections.
+--idle opens sockets that connect and then never send, the way stale
+monitoring clients hold server slots; run once per server profile to
+compare them.
+
+    python3 http_load.py 192.168.1.50 --clients 8 --idle 6 --duration 30
+    python3 http_load.py 192.168.1.50 --no-keepalive --path /metrics
+"""
+
+import argparse
+import http.client
+import socket
+import threading
+import time
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.ok = 0
+        self.http_errors = 0
+        self.connects = 0
+        self.refused = 0
+        self.latencies = []
+
+    def add(self, **counts):
+        with self.lock:
+            for key, value in counts.items():
+                setattr(self, key, getattr(self, key) + value)
+
+
+def client(args, stats, stop):
+    conn = None
+    latencies = []
+    while not stop.is_set():
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(args.host, args.port,
+                                                  timeout=args.timeout)
+                conn.connect()
+                stats.add(connects=1)
+            start = time.monotonic()
+            conn.request("GET", args.path)
+            resp = conn.getresponse()
+            resp.read()
+            latencies.append(time.monotonic() - start)
+            if resp.status == 200:
+                stats.add(ok=1)
+            else:
+                stats.add(http_errors=1)
+            if not args.keepalive or resp.will_close:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            # Refused, reset, purged under us or timed out: the request
+            # failed because the server had no socket for it
+            stats.add(connects=1 if conn is None else 0, refused=1)
+            if conn is not None:
+                conn.close()
+                conn = None
+            time.sleep(0.05)
+    if conn is not None:
+        conn.close()
+    with stats.lock:
+        stats.latencies.extend(latencies)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(len(sorted_values) * p / 100))
+    return sorted_values[index]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/health")
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--idle", type=int, default=0,
+                        help="sockets held open without sending")
+    parser.add_argument("--no-keepalive", dest="keepalive",
+                        action="store_false",
+                        help="open a new connection per request")
+    parser.add_argument("--duration", type=float, default=30.0,
+                        help="seconds")
+    parser.add_argument("--timeout", type=float, default=3.0)
+    args = parser.parse_args()
+
+    idle = []
+    for _ in range(args.idle):
+        try:
+            idle.append(socket.create_connection((args.host, args.port),
+                                                 timeout=args.timeout))
+        except OSError as e:
+            print(f"idle socket {len(idle)} failed: {e}")
+            break
+
+    stats = Stats()
+    stop = threading.Event()
+    threads = [threading.Thread(target=client, args=(args, stats, stop))
+               for _ in range(args.clients)]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+
+    idle_alive = 0
+    for s in idle:
+        # A purged socket reads as EOF or reset
+        s.setblocking(False)
+        try:
+            s.recv(1)
+        except BlockingIOError:
+            idle_alive += 1
+        except OSError:
+            pass
+        s.close()
+
+    attempts = stats.ok + stats.http_errors + stats.refused
+    lat = sorted(stats.latencies)
+    print(f"path       {args.path}  clients {args.clients}  "
+          f"idle {len(idle)}  keepalive {'on' if args.keepalive else 'off'}")
+    print(f"requests   {stats.ok} ok, {stats.http_errors} non-200 in "
+          f"{elapsed:.1f}s ({stats.ok / elapsed:.1f} req/s)")
+    print(f"refused    {stats.refused} "
+          f"({100.0 * stats.refused / max(attempts, 1):.2f}% of requests)")
+    print(f"conns      {stats.connects} "
+          f"({stats.ok / max(stats.connects, 1):.1f} req/conn)")
+    print(f"latency    p50 {percentile(lat, 50) * 1e3:.1f} ms  "
+          f"p99 {percentile(lat, 99) * 1e3:.1f} ms  "
+          f"max {(lat[-1] if lat else 0) * 1e3:.1f} ms")
+    if idle:
+        print(f"idle       {idle_alive}/{len(idle)} still open (purged "
+              f"{len(idle) - idle_alive})")
+
+
+if __name__ == "__main__":
+    main()
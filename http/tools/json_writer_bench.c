@@ -0,0 +1,207 @@
+/* Host benchmark: json_writer against a snprintf /health body.
+ *
+ *   cc -O2 -pthread -I../main/components/json_writer json_writer_bench.c \
+ *       ../main/components/json_writer/json_writer.c -o json_writer_bench
+ *   ./json_writer_bench [iterations]
+ *
+ * Both paths build the same four-field document, byte for byte (checked
+ * before timing, along with the writer's depth limit). Reports bytes/sec
+ * of generated JSON and the peak stack each path uses, measured by running
+ * it on a painted thread stack.
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_writer.h"
+
+#define STACK_SIZE (64 * 1024)
+#define STACK_PAINT 0xa5
+
+static long iterations;
+static volatile size_t sink;
+
+static uint32_t get_uptime(void) { return 123456; }
+static uint32_t get_free_heap(void) { return 201344; }
+static uint32_t get_min_free_heap(void) { return 187220; }
+static uint32_t get_tasks(void) { return 14; }
+
+static const json_field_t fields[] = {
+    JSON_FIELD_U32("uptime", get_uptime),
+    JSON_FIELD_U32("free_heap", get_free_heap),
+    JSON_FIELD_U32("min_free_heap", get_min_free_heap),
+    JSON_FIELD_U32("tasks", get_tasks),
+};
+
+static int count_flush(void *ctx, const char *buf, size_t len) {
+    *(size_t *)ctx += len;
+    sink += (unsigned char)buf[0];
+    return 0;
+}
+
+// The old health_get_handler approach, with the current fields
+static size_t format_snprintf(char *response, size_t size) {
+    return snprintf(response, size,
+                    "{\"uptime\":%" PRIu32 ",\"free_heap\":%" PRIu32
+                    ",\"min_free_heap\":%" PRIu32 ",\"tasks\":%" PRIu32 "}",
+                    get_uptime(), get_free_heap(), get_min_free_heap(),
+                    get_tasks());
+}
+
+static size_t health_snprintf(void) {
+    char response[128];
+    size_t len = format_snprintf(response, sizeof(response));
+    sink += (unsigned char)response[len - 1];
+    return len;
+}
+
+static int health_writer_to(json_flush_fn_t flush, void *ctx) {
+    json_writer_t w;
+    json_writer_init(&w, flush, ctx);
+    json_begin_object(&w);
+    json_write_fields(&w, fields, sizeof(fields) / sizeof(fields[0]));
+    json_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+static size_t health_writer(void) {
+    size_t bytes = 0;
+    health_writer_to(count_flush, &bytes);
+    return bytes;
+}
+
+typedef struct {
+    char buf[256];
+    size_t len;
+} capture_t;
+
+static int capture_flush(void *ctx, const char *buf, size_t len) {
+    capture_t *c = ctx;
+    if (c->len + len > sizeof(c->buf)) {
+        return -1;
+    }
+    memcpy(&c->buf[c->len], buf, len);
+    c->len += len;
+    return 0;
+}
+
+// Timing different documents would compare nothing
+static int check_same_output(void) {
+    char expected[128];
+    size_t len = format_snprintf(expected, sizeof(expected));
+    capture_t got = {.len = 0};
+    if (health_writer_to(capture_flush, &got) != 0 || got.len != len ||
+        memcmp(got.buf, expected, len) != 0) {
+        printf("FAIL: outputs differ\n  snprintf %s\n  writer   %.*s\n",
+               expected, (int)got.len, got.buf);
+        return 1;
+    }
+    printf("Both paths: %s\n", expected);
+    return 0;
+}
+
+// Nests n arrays; the writer must refuse rather than emit broken JSON
+static int nested_arrays(int n, capture_t *got) {
+    json_writer_t w;
+    json_writer_init(&w, capture_flush, got);
+    for (int i = 0; i < n; i++) {
+        json_begin_array(&w);
+        json_uint(&w, i);
+    }
+    for (int i = 0; i < n; i++) {
+        json_end_array(&w);
+        json_uint(&w, i);
+    }
+    return json_writer_finish(&w);
+}
+
+static int check_depth(void) {
+    capture_t deepest = {.len = 0};
+    capture_t too_deep = {.len = 0};
+    int err = nested_arrays(JSON_WRITER_MAX_DEPTH - 1, &deepest);
+    if (err != 0) {
+        printf("FAIL: %d arrays deep gave %d\n", JSON_WRITER_MAX_DEPTH - 1,
+               err);
+        return 1;
+    }
+    err = nested_arrays(JSON_WRITER_MAX_DEPTH, &too_deep);
+    if (err != JSON_WRITER_ERR_DEPTH || too_deep.len != 0) {
+        printf("FAIL: %d arrays deep gave %d, %zu bytes\n",
+               JSON_WRITER_MAX_DEPTH, err, too_deep.len);
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    size_t (*fn)(void);
+    double elapsed;
+    size_t bytes;
+} run_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *run_thread(void *arg) {
+    run_t *run = arg;
+    double start = now_sec();
+    for (long i = 0; i < iterations; i++) {
+        run->bytes += run->fn();
+    }
+    run->elapsed = now_sec() - start;
+    return NULL;
+}
+
+static size_t noop(void) { return 0; }
+
+// Stack used by the thread itself, subtracted from every measurement
+static size_t baseline_stack;
+
+static size_t bench(const char *name, size_t (*fn)(void)) {
+    uint8_t *stack = aligned_alloc(4096, STACK_SIZE);
+    memset(stack, STACK_PAINT, STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, STACK_SIZE);
+
+    run_t run = {.fn = fn};
+    pthread_t thread;
+    pthread_create(&thread, &attr, run_thread, &run);
+    pthread_join(thread, NULL);
+
+    // The stack grows down: the lowest overwritten byte marks the peak
+    size_t untouched = 0;
+    while (untouched < STACK_SIZE && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+
+    size_t used = STACK_SIZE - untouched;
+    if (name != NULL) {
+        printf("%-10s %5zu B/doc  %8.1f MB/s  %6.0f ns/doc  stack %zu B\n",
+               name, run.bytes / iterations, run.bytes / run.elapsed / 1e6,
+               run.elapsed * 1e9 / iterations, used - baseline_stack);
+    }
+
+    pthread_attr_destroy(&attr);
+    free(stack);
+    return used;
+}
+
+int main(int argc, char **argv) {
+    iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    if (check_same_output() != 0 || check_depth() != 0) {
+        return 1;
+    }
+    bench(NULL, noop);  // warm up lazy symbol binding, which is stack heavy
+    baseline_stack = bench(NULL, noop);
+    bench("snprintf", health_snprintf);
+    bench("writer", health_writer);
+    return 0;
+}
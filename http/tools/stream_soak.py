@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Soak test for the http project's /stream endpoint.
+
+Holds one /stream connection open for the given duration and reports the
+sustained frames/sec, missing frame ids and the free-heap drift seen in
+the telemetry itself.
+
+    python3 stream_soak.py 192.168.1.50 --hz 20 --duration 600
+"""
+
+import argparse
+import http.client
+import json
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--hz", type=int, default=10)
+    parser.add_argument("--duration", type=float, default=60.0, help="seconds")
+    parser.add_argument("--report", type=float, default=10.0,
+                        help="seconds between progress lines")
+    args = parser.parse_args()
+
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=5)
+    conn.request("GET", f"/stream?hz={args.hz}")
+    resp = conn.getresponse()
+    if resp.status != 200:
+        raise SystemExit(f"/stream returned {resp.status} {resp.reason}")
+
+    frames = 0
+    missing = 0
+    last_id = None
+    first_heap = None
+    heap = None
+    min_heap = None
+    start = time.monotonic()
+    next_report = start + args.report
+
+    while time.monotonic() - start < args.duration:
+        line = resp.readline()
+        if not line:
+            print("server closed the stream")
+            break
+        line = line.decode().strip()
+        if line.startswith("data:"):
+            data = json.loads(line[5:])
+            frame_id = data["seq"]
+            heap = data["free_heap"]
+            min_heap = data["min_free_heap"]
+            if first_heap is None:
+                first_heap = heap
+            if last_id is not None:
+                missing += max(0, frame_id - last_id - 1)
+            last_id = frame_id
+            frames += 1
+
+        now = time.monotonic()
+        if now >= next_report:
+            print(f"{now - start:7.1f}s  {frames / (now - start):6.1f} frames/s"
+                  f"  free_heap {heap}  drift {heap - first_heap:+d} B")
+            next_report += args.report
+
+    elapsed = time.monotonic() - start
+    conn.close()
+    if frames == 0:
+        raise SystemExit("no frames received")
+
+    print(f"frames     {frames} in {elapsed:.1f}s "
+          f"({frames / elapsed:.1f}/s, target {args.hz}/s)")
+    print(f"missing    {missing}")
+    print(f"free_heap  first {first_heap}  last {heap}  "
+          f"drift {heap - first_heap:+d} B "
+          f"({(heap - first_heap) * 3600 / elapsed:+.0f} B/h)")
+    print(f"min_heap   {min_heap}")
+
+
+if __name__ == "__main__":
+    main()
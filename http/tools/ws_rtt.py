@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Round-trip latency of robot commands over /ws versus the UDP echo path.
+
+Sends DRIVE frames (see robot_cmd.h) at a fixed rate over the http
+project's /ws endpoint, matches the echoes by sequence number and reports
+the RTT distribution. With --udp, the same run is repeated against a udp
+project board started with udp_config.echo = true, for comparison.
+
+    python3 ws_rtt.py 192.168.1.50 --rate 200 --duration 10
+    python3 ws_rtt.py 192.168.1.50 --udp 192.168.1.51
+"""
+
+import argparse
+import base64
+import binascii
+import os
+import select
+import socket
+import struct
+import time
+
+# opcode, payload length, sequence, timestamp (us), payload
+FRAME = struct.Struct("<BBHI16s")
+FRAME_SIZE = FRAME.size + 2
+OP_DRIVE = 2
+WS_BINARY = 0x2
+
+
+def encode_drive(seq, timestamp_us, left, right):
+    payload = struct.pack("<hh", left, right)
+    frame = FRAME.pack(OP_DRIVE, len(payload), seq & 0xFFFF,
+                       timestamp_us & 0xFFFFFFFF, payload)
+    # CRC-16/CCITT-FALSE, as robot_cmd_crc16()
+    return frame + struct.pack("<H", binascii.crc_hqx(frame, 0xFFFF))
+
+
+class WebSocket:
+    """Just enough of RFC 6455 for binary messages to and from the board."""
+
+    def __init__(self, host, port, path):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall((f"GET {path} HTTP/1.1\r\nHost: {host}\r\n"
+                           "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                           f"Sec-WebSocket-Key: {key}\r\n"
+                           "Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise SystemExit("connection closed during handshake")
+            response += chunk
+        head, _, self.buf = response.partition(b"\r\n\r\n")
+        if b" 101 " not in head.split(b"\r\n")[0]:
+            status = head.decode(errors="replace")
+            raise SystemExit(f"handshake failed: {status}")
+        self.sock.setblocking(False)
+
+    def fileno(self):
+        return self.sock.fileno()
+
+    def send(self, data):
+        mask = os.urandom(4)
+        header = bytes([0x80 | WS_BINARY])
+        if len(data) < 126:
+            header += bytes([0x80 | len(data)])
+        else:
+            header += bytes([0x80 | 126]) + struct.pack(">H", len(data))
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(data))
+        self.sock.setblocking(True)
+        self.sock.sendall(header + mask + masked)
+        self.sock.setblocking(False)
+
+    def recv_messages(self):
+        try:
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise SystemExit("server closed /ws")
+            self.buf += chunk
+        except BlockingIOError:
+            pass
+        messages = []
+        while len(self.buf) >= 2:
+            length = self.buf[1] & 0x7F
+            offset = 2
+            if length == 126:
+                if len(self.buf) < 4:
+                    break
+                length = struct.unpack(">H", self.buf[2:4])[0]
+                offset = 4
+            elif length == 127:
+                if len(self.buf) < 10:
+                    break
+                length = struct.unpack(">Q", self.buf[2:10])[0]
+                offset = 10
+            if len(self.buf) < offset + length:
+                break
+            opcode = self.buf[0] & 0x0F
+            if opcode == WS_BINARY:
+                messages.append(self.buf[offset:offset + length])
+            self.buf = self.buf[offset + length:]
+        return messages
+
+    def close(self):
+        self.sock.close()
+
+
+class Udp:
+    def __init__(self, host, port):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setblocking(False)
+        self.dest = (host, port)
+
+    def fileno(self):
+        return self.sock.fileno()
+
+    def send(self, data):
+        self.sock.sendto(data, self.dest)
+
+    def recv_messages(self):
+        messages = []
+        while True:
+            try:
+                data, _ = self.sock.recvfrom(2048)
+            except BlockingIOError:
+                return messages
+            messages.append(data)
+
+    def close(self):
+        self.sock.close()
+
+
+def run(transport, args):
+    interval = 1.0 / args.rate
+    sent = 0
+    messages = 0
+    rtts = []
+    pending = {}  # sequence -> send time (ns)
+    start = time.perf_counter()
+    next_send = start
+    end = start + args.duration
+
+    # Keep listening briefly after the last send to collect late echoes
+    while time.perf_counter() < end + 0.5:
+        now = time.perf_counter()
+        if now < end and now >= next_send:
+            sent_ns = time.perf_counter_ns()
+            pending[sent & 0xFFFF] = sent_ns
+            transport.send(encode_drive(sent, sent_ns // 1000, args.speed,
+                                        args.speed))
+            sent += 1
+            next_send += interval
+            continue
+
+        timeout = max(0.0, min(next_send, end + 0.5) - now)
+        readable, _, _ = select.select([transport], [], [], timeout)
+        if not readable:
+            continue
+        recv_ns = time.perf_counter_ns()
+        for message in transport.recv_messages():
+            messages += 1
+            # The board may coalesce several echoes into one message
+            for off in range(0, len(message) - FRAME_SIZE + 1, FRAME_SIZE):
+                seq = struct.unpack_from("<H", message, off + 2)[0]
+                sent_ns = pending.pop(seq, None)
+                if sent_ns is not None:
+                    rtts.append((recv_ns - sent_ns) / 1e6)
+    transport.close()
+    return sent, messages, sorted(rtts)
+
+
+def report(name, sent, messages, rtts):
+    def pct(p):
+        if not rtts:
+            return float("nan")
+        return rtts[min(len(rtts) - 1, int(len(rtts) * p / 100))]
+
+    lost = sent - len(rtts)
+    print(f"{name:4} sent {sent}  echoed {len(rtts)}  lost {lost} "
+          f"({100.0 * lost / max(sent, 1):.2f}%)  "
+          f"{len(rtts) / max(messages, 1):.2f} frames/msg")
+    print(f"     rtt ms  min {pct(0):.2f}  p50 {pct(50):.2f}  "
+          f"p90 {pct(90):.2f}  p99 {pct(99):.2f}  max {pct(100):.2f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host", help="board running the http project")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--udp", metavar="HOST",
+                        help="board running the udp project with echo on")
+    parser.add_argument("--udp-port", type=int, default=3333)
+    parser.add_argument("--rate", type=float, default=100.0,
+                        help="frames/sec")
+    parser.add_argument("--duration", type=float, default=10.0,
+                        help="seconds per transport")
+    parser.add_argument("--speed", type=int, default=512, help="drive duty")
+    args = parser.parse_args()
+
+    report("ws", *run(WebSocket(args.host, args.port, "/ws"), args))
+    if args.udp:
+        report("udp", *run(Udp(args.udp, args.udp_port), args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Pack a directory of web assets into the http project's asset image.
+
+Every file is gzip-compressed and given an ETag from the hash of its raw
+contents; the layout matches static_assets.h. Run by the http/main CMake
+build, or by hand to inspect sizes:
+
+    python3 www_pack.py ../www www.bin --max-size 0x40000
+"""
+
+import argparse
+import gzip
+import hashlib
+import mimetypes
+import os
+import struct
+import sys
+
+MAGIC = 0x31575757
+HEADER = struct.Struct("<IIII")
+ENTRY = struct.Struct("<48s32s24sII")
+ALIGN = 4
+
+TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+}
+
+
+def content_type(name):
+    ext = os.path.splitext(name)[1].lower()
+    return TYPES.get(ext) or mimetypes.guess_type(name)[0] or \
+        "application/octet-stream"
+
+
+def field(text, size, what, name):
+    data = text.encode()
+    if len(data) >= size:
+        sys.exit(f"{name}: {what} longer than {size - 1} bytes")
+    return data
+
+
+def collect(root):
+    files = []
+    for dirpath, _, names in os.walk(root):
+        for name in names:
+            full = os.path.join(dirpath, name)
+            url = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            files.append((url, full))
+    return sorted(files)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("src")
+    parser.add_argument("out")
+    parser.add_argument("--max-size", type=lambda v: int(v, 0),
+                        help="partition size; fail if the image is larger")
+    args = parser.parse_args()
+
+    files = collect(args.src)
+    offset = HEADER.size + ENTRY.size * len(files)
+    entries = []
+    blobs = []
+    raw_total = 0
+    for url, path in files:
+        with open(path, "rb") as f:
+            raw = f.read()
+        # mtime=0 keeps the image reproducible across builds
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '"' + hashlib.sha256(raw).hexdigest()[:16] + '"'
+        entries.append(ENTRY.pack(
+            field(url, 48, "path", url),
+            field(content_type(url), 32, "type", url),
+            field(etag, 24, "etag", url),
+            offset, len(packed)))
+        pad = -len(packed) % ALIGN
+        blobs.append(packed + b"\0" * pad)
+        offset += len(packed) + pad
+        raw_total += len(raw)
+
+    image = HEADER.pack(MAGIC, len(files), offset, 0) + b"".join(entries) + \
+        b"".join(blobs)
+    if args.max_size is not None and len(image) > args.max_size:
+        sys.exit(f"asset image is {len(image)} bytes, partition holds "
+                 f"{args.max_size}")
+
+    with open(args.out, "wb") as f:
+        f.write(image)
+    print(f"www: {len(files)} assets, {raw_total} -> {len(image)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,48 @@
+// Live telemetry from /stream, with /metrics refreshed every few seconds
+(function () {
+  const status = document.getElementById("status");
+  const fields = ["uptime", "free_heap", "min_free_heap", "tasks"];
+
+  function show(data) {
+    for (const key of fields) {
+      if (key in data) {
+        document.getElementById(key).textContent =
+          key === "uptime" ? data[key] + " s" : data[key].toLocaleString();
+      }
+    }
+  }
+
+  function setConnected(on) {
+    status.textContent = on ? "live" : "disconnected";
+    status.className = on ? "" : "off";
+  }
+
+  function connect() {
+    const source = new EventSource("/stream?hz=2");
+    source.onopen = () => setConnected(true);
+    source.onmessage = (event) => show(JSON.parse(event.data));
+    source.onerror = () => {
+      // The server allows few streams; fall back to polling /health
+      setConnected(false);
+      source.close();
+      fetch("/health").then((r) => r.json()).then(show).catch(() => {});
+      setTimeout(connect, 5000);
+    };
+  }
+
+  function refreshMetrics() {
+    fetch("/metrics")
+      .then((r) => r.text())
+      .then((text) => {
+        document.getElementById("metrics").textContent = text
+          .split("\n")
+          .filter((line) => line && !line.startsWith("#"))
+          .join("\n");
+      })
+      .catch(() => {});
+  }
+
+  connect();
+  refreshMetrics();
+  setInterval(refreshMetrics, 5000);
+})();
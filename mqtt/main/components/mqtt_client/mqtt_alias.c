@@ -0,0 +1,101 @@
+#include "mqtt_alias.h"
+
+#include <string.h>
+
+void mqtt_alias_init(mqtt_alias_t *table, uint16_t max_alias,
+                     uint16_t threshold) {
+    memset(table->entries, 0, sizeof(table->entries));
+    table->max_alias = max_alias;
+    table->threshold = threshold;
+    table->next_alias = 1;
+}
+
+void mqtt_alias_reset(mqtt_alias_t *table) {
+    // Counts survive so busy topics get an alias straight away next time
+    for (int i = 0; i < MQTT_ALIAS_TRACKED; i++) {
+        table->entries[i].alias = 0;
+        table->entries[i].established = false;
+    }
+    table->next_alias = 1;
+}
+
+static mqtt_alias_entry_t *find(mqtt_alias_t *table, const char *topic,
+                                size_t len) {
+    for (int i = 0; i < MQTT_ALIAS_TRACKED; i++) {
+        mqtt_alias_entry_t *entry = &table->entries[i];
+        if (entry->len == len && memcmp(entry->topic, topic, len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// An empty slot, else the least published topic without an alias
+static mqtt_alias_entry_t *victim(mqtt_alias_t *table) {
+    mqtt_alias_entry_t *best = NULL;
+    for (int i = 0; i < MQTT_ALIAS_TRACKED; i++) {
+        mqtt_alias_entry_t *entry = &table->entries[i];
+        if (entry->len == 0) {
+            return entry;
+        }
+        if (entry->alias == 0 &&
+            (best == NULL || entry->count < best->count)) {
+            best = entry;
+        }
+    }
+    return best;
+}
+
+uint16_t mqtt_alias_get(mqtt_alias_t *table, const char *topic,
+                        bool *with_topic) {
+    *with_topic = true;
+    size_t len = strlen(topic);
+    // The alias property itself costs 3 bytes per message
+    if (len <= 3 || len >= MQTT_ALIAS_TOPIC_LEN) {
+        return 0;
+    }
+
+    mqtt_alias_entry_t *entry = find(table, topic, len);
+    if (entry == NULL) {
+        entry = victim(table);
+        if (entry == NULL) {
+            return 0;
+        }
+        memcpy(entry->topic, topic, len);
+        entry->len = len;
+        entry->count = 0;
+        entry->alias = 0;
+        entry->established = false;
+    }
+    if (entry->count < UINT16_MAX) {
+        entry->count++;
+    }
+
+    if (entry->alias == 0 && entry->count >= table->threshold &&
+        table->next_alias <= table->max_alias) {
+        entry->alias = table->next_alias++;
+    }
+    *with_topic = !entry->established;
+    return entry->alias;
+}
+
+void mqtt_alias_sent(mqtt_alias_t *table, uint16_t alias) {
+    if (alias == 0) {
+        return;
+    }
+    for (int i = 0; i < MQTT_ALIAS_TRACKED; i++) {
+        if (table->entries[i].alias == alias) {
+            table->entries[i].established = true;
+        }
+    }
+}
+
+void mqtt_alias_rejected(mqtt_alias_t *table, uint16_t alias) {
+    table->max_alias = alias > 0 ? alias - 1 : 0;
+    for (int i = 0; i < MQTT_ALIAS_TRACKED; i++) {
+        if (table->entries[i].alias >= alias) {
+            table->entries[i].alias = 0;
+            table->entries[i].established = false;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef MQTT_ALIAS_H
+#define MQTT_ALIAS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* MQTT v5 topic alias assignment for outgoing publishes. Topics are
+ * counted as they are published; once one reaches the threshold it gets
+ * the next free alias. The first publish with that alias carries the full
+ * topic and later ones send an empty topic. Aliases only last for one
+ * connection, so reset on every connect and disconnect. Topics that have
+ * no alias yet compete for the tracking slots by publish count.
+ * Not thread safe. Plain C so it also builds on the host. */
+#define MQTT_ALIAS_TRACKED 16
+#define MQTT_ALIAS_TOPIC_LEN 128
+
+typedef struct {
+    char topic[MQTT_ALIAS_TOPIC_LEN];
+    uint16_t len;
+    uint16_t count;
+    uint16_t alias;  // 0 until assigned
+    bool established;  // the broker has seen topic and alias together
+} mqtt_alias_entry_t;
+
+typedef struct {
+    mqtt_alias_entry_t entries[MQTT_ALIAS_TRACKED];
+    uint16_t max_alias;  // ours, lowered to what the broker accepts
+    uint16_t next_alias;
+    uint16_t threshold;
+} mqtt_alias_t;
+
+void mqtt_alias_init(mqtt_alias_t *table, uint16_t max_alias,
+                     uint16_t threshold);
+
+// Forgets every assignment; the broker does the same on a new connection
+void mqtt_alias_reset(mqtt_alias_t *table);
+
+/* Counts a publish to the topic and returns the alias to send with it, or
+ * 0 for none. *with_topic says whether the topic must still be sent. */
+uint16_t mqtt_alias_get(mqtt_alias_t *table, const char *topic,
+                        bool *with_topic);
+
+// The publish carrying topic and alias went out; send it empty from now on
+void mqtt_alias_sent(mqtt_alias_t *table, uint16_t alias);
+
+/* The broker's limit is below this alias: stop handing out aliases at or
+ * above it. */
+void mqtt_alias_rejected(mqtt_alias_t *table, uint16_t alias);
+
+#endif  // MQTT_ALIAS_H
@@ -0,0 +1,51 @@
+#include "mqtt_outbox.h"
+
+#include <string.h>
+
+void mqtt_outbox_init(mqtt_outbox_t *outbox, mqtt_outbox_policy_t policy) {
+    outbox->head = 0;
+    outbox->count = 0;
+    outbox->policy = policy;
+    outbox->dropped = 0;
+}
+
+bool mqtt_outbox_push(mqtt_outbox_t *outbox, const char *topic,
+                      const char *data, size_t len, int qos) {
+    size_t topic_len = strlen(topic);
+    if (topic_len >= MQTT_OUTBOX_TOPIC_LEN || len > MQTT_OUTBOX_DATA_LEN) {
+        outbox->dropped++;
+        return false;
+    }
+
+    if (outbox->count == MQTT_OUTBOX_SLOTS) {
+        outbox->dropped++;
+        if (outbox->policy == MQTT_OUTBOX_DROP_NEWEST) {
+            return false;
+        }
+        outbox->head = (outbox->head + 1) % MQTT_OUTBOX_SLOTS;
+        outbox->count--;
+    }
+
+    mqtt_outbox_msg_t *msg =
+        &outbox->slots[(outbox->head + outbox->count) % MQTT_OUTBOX_SLOTS];
+    memcpy(msg->topic, topic, topic_len + 1);
+    memcpy(msg->data, data, len);
+    msg->len = len;
+    msg->qos = qos;
+    outbox->count++;
+    return true;
+}
+
+bool mqtt_outbox_pop(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg) {
+    if (outbox->count == 0) {
+        return false;
+    }
+    const mqtt_outbox_msg_t *slot = &outbox->slots[outbox->head];
+    memcpy(msg->topic, slot->topic, sizeof(msg->topic));
+    memcpy(msg->data, slot->data, slot->len);
+    msg->len = slot->len;
+    msg->qos = slot->qos;
+    outbox->head = (outbox->head + 1) % MQTT_OUTBOX_SLOTS;
+    outbox->count--;
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bounded queue of messages published while the broker is unreachable.
+ * Slots are fixed size so holding a backlog never allocates; when full,
+ * the policy decides whether the oldest queued or the new message is lost.
+ * Not thread safe: the caller serialises access. Plain C so it also
+ * builds on the host. */
+#define MQTT_OUTBOX_SLOTS 16
+#define MQTT_OUTBOX_TOPIC_LEN 64
+#define MQTT_OUTBOX_DATA_LEN 256
+
+typedef enum {
+    MQTT_OUTBOX_DROP_OLDEST = 0,  // keep the freshest data
+    MQTT_OUTBOX_DROP_NEWEST,      // keep what was queued first
+} mqtt_outbox_policy_t;
+
+typedef struct {
+    char topic[MQTT_OUTBOX_TOPIC_LEN];
+    uint8_t qos;
+    uint16_t len;
+    char data[MQTT_OUTBOX_DATA_LEN];
+} mqtt_outbox_msg_t;
+
+typedef struct {
+    mqtt_outbox_msg_t slots[MQTT_OUTBOX_SLOTS];
+    uint32_t head;  // next slot to pop
+    uint32_t count;
+    mqtt_outbox_policy_t policy;
+    uint32_t dropped;
+} mqtt_outbox_t;
+
+void mqtt_outbox_init(mqtt_outbox_t *outbox, mqtt_outbox_policy_t policy);
+
+/* Returns false if the message was not queued, because it does not fit a
+ * slot or the box is full under DROP_NEWEST. Every lost message, including
+ * one evicted under DROP_OLDEST, is counted in dropped. */
+bool mqtt_outbox_push(mqtt_outbox_t *outbox, const char *topic,
+                      const char *data, size_t len, int qos);
+
+// Copies the oldest message into msg; false when empty
+bool mqtt_outbox_pop(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg);
+
+static inline uint32_t mqtt_outbox_depth(const mqtt_outbox_t *outbox) {
+    return outbox->count;
+}
+
+#endif  // MQTT_OUTBOX_H
@@ -1,14 +1,281 @@
 #include "my_mqtt_client.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "backoff.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "metrics.h"
+#include "mqtt_alias.h"
+#include "mqtt_outbox.h"
+#include "settings.h"
 
 static const char *TAG = "MQTT_CLIENT";
+
+METRIC_COUNTER(published_metric, "mqtt_published_total",
+               "Messages handed to the MQTT client for publishing");
+METRIC_COUNTER(received_metric, "mqtt_received_total",
+               "Messages received on subscribed topics");
+METRIC_COUNTER(disconnects_metric, "mqtt_disconnects_total",
+               "Broker disconnections");
+METRIC_COUNTER(reconnects_metric, "mqtt_reconnect_attempts_total",
+               "Reconnect attempts started by the backoff timer");
+METRIC_COUNTER(dropped_metric, "mqtt_outbox_dropped_total",
+               "Messages lost because the offline queue was full");
+METRIC_GAUGE(outbox_depth_metric, "mqtt_outbox_depth",
+             "Messages waiting in the offline queue");
+METRIC_COUNTER(alias_saved_metric, "mqtt_alias_bytes_saved_total",
+               "Publish bytes saved by sending a topic alias instead");
+METRIC_COUNTER(unrouted_metric, "mqtt_unrouted_total",
+               "Received messages no subscription handler matched");
+METRIC_COUNTER(oversize_metric, "mqtt_rx_oversize_total",
+               "Fragmented messages dropped for exceeding the rx buffer");
+
+#if CONFIG_MQTT_OUTBOX_POLICY_DROP_NEWEST
+#define OUTBOX_POLICY MQTT_OUTBOX_DROP_NEWEST
+#else
+#define OUTBOX_POLICY MQTT_OUTBOX_DROP_OLDEST
+#endif
+
 static esp_mqtt_client_handle_t client;
 
-static const char *TOPIC = "controller/command";
-static const char *URI = "mqtt://192.168.1.66:1883";
+/* The client runs with auto-reconnect off: a one-shot timer re-arms each
+ * attempt so the MQTT event task never sleeps. Publishes made while
+ * disconnected wait in the outbox, which a periodic timer drains a few
+ * messages at a time once connected so the backlog does not go out as one
+ * burst. */
+static esp_timer_handle_t reconnect_timer;
+static esp_timer_handle_t drain_timer;
+static backoff_t backoff;
+static atomic_bool connected;
+static int64_t disconnected_at_us;
+
+static mqtt_outbox_t outbox;
+static SemaphoreHandle_t outbox_lock;
+
+/* Topic aliases: the client keeps v5 publish properties as per-client
+ * state, so setting them and publishing happen under one lock. The
+ * event task never takes it (it may hold the client's own lock while
+ * dispatching); it bumps the epoch instead and the next publish resets
+ * the table for the new connection. */
+static mqtt_alias_t aliases;
+static SemaphoreHandle_t publish_lock;
+static atomic_uint alias_epoch;
+static unsigned alias_table_epoch;
+
+#define MAX_SUBSCRIPTIONS 16
+#define ROUTER_NODES 64
+#define RX_TOPIC_SIZE 128
+
+typedef struct {
+    const char *filter;
+    int qos;
+} subscription_t;
+
+/* Inbound messages are matched against a topic trie on the MQTT task.
+ * The lock only orders mqtt_subscribe() against routing. */
+static mqtt_router_node_t router_nodes[ROUTER_NODES];
+static mqtt_router_t router;
+static subscription_t subscriptions[MAX_SUBSCRIPTIONS];
+static int subscription_count;
+static SemaphoreHandle_t router_lock;
+
+/* A message larger than the client's buffer arrives as several DATA
+ * events; only the first carries the topic. It is put back together here
+ * (only the MQTT task writes these) and routed once complete. */
+static char rx_topic[RX_TOPIC_SIZE];
+static size_t rx_topic_len;
+static char rx_buf[CONFIG_MQTT_RX_REASSEMBLY_SIZE];
+static bool rx_discard;
+
+static int send_publish(const char *topic, const char *data, size_t len,
+                        int qos, const mqtt_publish_opts_t *opts,
+                        bool enqueue) {
+    esp_mqtt5_publish_property_config_t property = {0};
+    if (opts != NULL) {
+        property.message_expiry_interval = opts->expiry_s;
+        if (opts->user_prop_count > 0 &&
+            esp_mqtt5_client_set_user_property(
+                &property.user_property,
+                (esp_mqtt5_user_property_item_t *)opts->user_props,
+                opts->user_prop_count) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to set user properties for %s", topic);
+            return -1;
+        }
+    }
+
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    unsigned epoch = atomic_load(&alias_epoch);
+    if (epoch != alias_table_epoch) {
+        mqtt_alias_reset(&aliases);
+        alias_table_epoch = epoch;
+    }
+
+    /* Only QoS 0 sent right away uses aliases. QoS 1/2 messages may be
+     * resent on a later connection, where the alias means nothing, and an
+     * enqueued message leaves later from the outbox, so an alias-only one
+     * could overtake the packet that set the alias up, or outlive the
+     * connection. */
+    bool with_topic = true;
+    property.topic_alias = qos == 0 && !enqueue
+                               ? mqtt_alias_get(&aliases, topic, &with_topic)
+                               : 0;
+    esp_err_t err = esp_mqtt5_client_set_publish_property(client, &property);
+    if (err != ESP_OK && property.topic_alias != 0) {
+        // Above the Topic Alias Maximum the broker sent in CONNACK
+        mqtt_alias_rejected(&aliases, property.topic_alias);
+        property.topic_alias = 0;
+        with_topic = true;
+        err = esp_mqtt5_client_set_publish_property(client, &property);
+    }
+
+    int msg_id = -1;
+    if (err == ESP_OK) {
+        const char *wire_topic = with_topic ? topic : NULL;
+        msg_id = enqueue ? esp_mqtt_client_enqueue(client, wire_topic, data,
+                                                   len, qos, 0, true)
+                         : esp_mqtt_client_publish(client, wire_topic, data,
+                                                   len, qos, 0);
+    }
+    if (msg_id >= 0 && property.topic_alias != 0) {
+        if (with_topic) {
+            mqtt_alias_sent(&aliases, property.topic_alias);
+        } else {
+            // The topic string went, the 3 byte alias property came
+            metric_add(&alias_saved_metric, strlen(topic) - 3);
+        }
+    }
+    xSemaphoreGive(publish_lock);
+
+    if (property.user_property != NULL) {
+        esp_mqtt5_client_delete_user_property(property.user_property);
+    }
+    if (msg_id >= 0) {
+        metric_inc(&published_metric);
+    }
+    return msg_id;
+}
+
+static void reconnect_cb(void *arg) {
+    metric_inc(&reconnects_metric);
+    esp_err_t err = esp_mqtt_client_reconnect(client);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Reconnect failed to start: %s", esp_err_to_name(err));
+    }
+}
+
+static void drain_cb(void *arg) {
+    // Only this callback pops, so one static message buffer is enough
+    static mqtt_outbox_msg_t msg;
+
+    for (int i = 0; i < CONFIG_MQTT_DRAIN_BATCH; i++) {
+        if (!atomic_load(&connected)) {
+            esp_timer_stop(drain_timer);
+            return;
+        }
+
+        xSemaphoreTake(outbox_lock, portMAX_DELAY);
+        bool have_msg = mqtt_outbox_pop(&outbox, &msg);
+        metric_set(&outbox_depth_metric, mqtt_outbox_depth(&outbox));
+        xSemaphoreGive(outbox_lock);
+
+        if (!have_msg) {
+            esp_timer_stop(drain_timer);
+            return;
+        }
+        send_publish(msg.topic, msg.data, msg.len, msg.qos, NULL, true);
+    }
+}
+
+static void start_drain(void) {
+    // Already running is fine: ESP_ERR_INVALID_STATE is ignored
+    esp_timer_start_periodic(drain_timer,
+                             CONFIG_MQTT_DRAIN_INTERVAL_MS * 1000ULL);
+}
+
+static void on_connected(void) {
+    if (disconnected_at_us != 0) {
+        ESP_LOGI(TAG, "Reconnected after %lld ms, %lu attempts",
+                 (long long)(esp_timer_get_time() - disconnected_at_us) / 1000,
+                 (unsigned long)backoff.attempt);
+        disconnected_at_us = 0;
+    }
+    backoff_reset(&backoff);
+    atomic_fetch_add(&alias_epoch, 1);
+    atomic_store(&connected, true);
+    start_drain();
+}
+
+static void on_disconnected(void) {
+    atomic_store(&connected, false);
+    atomic_fetch_add(&alias_epoch, 1);
+    if (disconnected_at_us == 0) {
+        disconnected_at_us = esp_timer_get_time();
+    }
+    uint32_t delay_ms = backoff_next(&backoff, esp_random());
+    ESP_LOGI(TAG, "Reconnecting in %lu ms", (unsigned long)delay_ms);
+    esp_timer_stop(reconnect_timer);
+    esp_timer_start_once(reconnect_timer, delay_ms * 1000ULL);
+}
+
+static void resubscribe(esp_mqtt_client_handle_t client_local) {
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    for (int i = 0; i < subscription_count; i++) {
+        esp_mqtt_client_subscribe(client_local, subscriptions[i].filter,
+                                  subscriptions[i].qos);
+    }
+    xSemaphoreGive(router_lock);
+}
+
+static void route(const char *topic, size_t topic_len, const char *data,
+                  size_t data_len) {
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    size_t delivered =
+        mqtt_router_route(&router, topic, topic_len, data, data_len);
+    xSemaphoreGive(router_lock);
+    if (delivered == 0) {
+        metric_inc(&unrouted_metric);
+        ESP_LOGD(TAG, "No handler for %.*s", (int)topic_len, topic);
+    }
+}
+
+static void on_data(esp_mqtt_event_handle_t event) {
+    // Common case: the whole message is in this event, route it in place
+    if (event->total_data_len == event->data_len) {
+        metric_inc(&received_metric);
+        route(event->topic, event->topic_len, event->data, event->data_len);
+        return;
+    }
+
+    if (event->current_data_offset == 0) {
+        rx_discard = event->topic_len > (int)sizeof(rx_topic) ||
+                     event->total_data_len > (int)sizeof(rx_buf);
+        if (rx_discard) {
+            metric_inc(&oversize_metric);
+            ESP_LOGW(TAG, "Dropping %d byte message on %.*s",
+                     event->total_data_len, event->topic_len, event->topic);
+            return;
+        }
+        memcpy(rx_topic, event->topic, event->topic_len);
+        rx_topic_len = event->topic_len;
+    }
+    if (rx_discard) {
+        return;
+    }
+
+    memcpy(&rx_buf[event->current_data_offset], event->data,
+           event->data_len);
+    if (event->current_data_offset + event->data_len ==
+        event->total_data_len) {
+        metric_inc(&received_metric);
+        route(rx_topic, rx_topic_len, rx_buf, event->total_data_len);
+    }
+}
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data) {
@@ -18,13 +285,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT Connected");
-            esp_mqtt_client_subscribe(client_local, TOPIC, 0);
+            on_connected();
+            resubscribe(client_local);
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT Disconnected");
-            ESP_LOGI(TAG, "Attempting to reconnect in 5 seconds...");
-            vTaskDelay(pdMS_TO_TICKS(5000));
-            esp_mqtt_client_start(client);
+            metric_inc(&disconnects_metric);
+            on_disconnected();
             break;
         case MQTT_EVENT_SUBSCRIBED:
             if (event->topic != NULL) {
@@ -36,15 +303,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             }
             break;
         case MQTT_EVENT_DATA:
-            if (event->topic != NULL && event->data != NULL) {
-                ESP_LOGI(TAG, "Received message on topic: %.*s",
-                         event->topic_len, event->topic);
-                ESP_LOGI(TAG, "Message data: %.*s", event->data_len,
-                         event->data);
-                // TODO handle message
-            } else {
-                ESP_LOGE(TAG, "Received message, but topic or data was null");
-            }
+            on_data(event);
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
@@ -59,11 +318,55 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
 }
 
 esp_err_t mqtt_app_start(void) {
+    metrics_register(&published_metric);
+    metrics_register(&received_metric);
+    metrics_register(&disconnects_metric);
+    metrics_register(&reconnects_metric);
+    metrics_register(&dropped_metric);
+    metrics_register(&outbox_depth_metric);
+    metrics_register(&alias_saved_metric);
+    metrics_register(&unrouted_metric);
+    metrics_register(&oversize_metric);
+
+    backoff_init(&backoff, CONFIG_MQTT_RECONNECT_BASE_MS,
+                 CONFIG_MQTT_RECONNECT_MAX_MS);
+    mqtt_outbox_init(&outbox, OUTBOX_POLICY);
+    mqtt_router_init(&router, router_nodes, ROUTER_NODES);
+    mqtt_alias_init(&aliases, CONFIG_MQTT_TOPIC_ALIAS_MAX,
+                    CONFIG_MQTT_TOPIC_ALIAS_THRESHOLD);
+    outbox_lock = xSemaphoreCreateMutex();
+    router_lock = xSemaphoreCreateMutex();
+    publish_lock = xSemaphoreCreateMutex();
+    if (outbox_lock == NULL || router_lock == NULL || publish_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create MQTT locks");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t reconnect_args = {
+        .callback = reconnect_cb,
+        .name = "mqtt_reconnect",
+    };
+    const esp_timer_create_args_t drain_args = {
+        .callback = drain_cb,
+        .name = "mqtt_drain",
+    };
+    if (esp_timer_create(&reconnect_args, &reconnect_timer) != ESP_OK ||
+        esp_timer_create(&drain_args, &drain_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create MQTT timers");
+        return ESP_FAIL;
+    }
+
+    // Broker and credentials come from the settings store; the strings
+    // stay valid for the life of the client
+    settings_init();
     esp_mqtt_client_config_t mqtt5_cfg = {
-        .broker.address.uri = URI,
+        .broker.address.uri = settings_get_str(SETTING_MQTT_URI),
         .session.protocol_ver = MQTT_PROTOCOL_V_5,
-        .credentials.username = "",
-        .credentials.authentication.password = "",
+        .session.keepalive = settings_get_u32(SETTING_MQTT_KEEPALIVE),
+        .credentials.username = settings_get_str(SETTING_MQTT_USER),
+        .credentials.authentication.password =
+            settings_get_str(SETTING_MQTT_PASS),
+        .network.disable_auto_reconnect = true,
     };
 
     client = esp_mqtt_client_init(&mqtt5_cfg);
@@ -89,11 +392,103 @@ esp_err_t mqtt_app_start(void) {
     return ESP_OK;
 }
 
+void mqtt_reconnect_now(void) {
+    // Only cuts a pending backoff short; an attempt in flight is left alone
+    if (reconnect_timer == NULL || atomic_load(&connected) ||
+        !esp_timer_is_active(reconnect_timer)) {
+        return;
+    }
+    esp_timer_stop(reconnect_timer);
+    esp_timer_start_once(reconnect_timer, 0);
+}
+
 void mqtt_publish(const char *topic, const char *message) {
     if (client == NULL) {
         ESP_LOGE(TAG, "Cannot publish: MQTT client not initialized");
         return;
     }
-    int msg_id = esp_mqtt_client_publish(client, topic, message, 0, 0, 0);
-    ESP_LOGI(TAG, "Published message to %s, msg_id=%d", topic, msg_id);
+    size_t len = strlen(message);
+
+    xSemaphoreTake(outbox_lock, portMAX_DELAY);
+    // Once anything is queued, later messages queue behind it to keep order
+    bool direct = atomic_load(&connected) && mqtt_outbox_depth(&outbox) == 0;
+    xSemaphoreGive(outbox_lock);
+
+    if (direct) {
+        int msg_id = send_publish(topic, message, len, 0, NULL, false);
+        if (msg_id >= 0) {
+            ESP_LOGD(TAG, "Published message to %s, msg_id=%d", topic,
+                     msg_id);
+            return;
+        }
+        // The connection dropped under us: hold it until the next one
+    }
+
+    xSemaphoreTake(outbox_lock, portMAX_DELAY);
+    uint32_t dropped = outbox.dropped;
+    bool queued = mqtt_outbox_push(&outbox, topic, message, len, 0);
+    metric_add(&dropped_metric, outbox.dropped - dropped);
+    metric_set(&outbox_depth_metric, mqtt_outbox_depth(&outbox));
+    xSemaphoreGive(outbox_lock);
+
+    if (queued && atomic_load(&connected)) {
+        start_drain();
+    }
+}
+
+esp_err_t mqtt_subscribe(const char *filter, int qos,
+                         mqtt_route_handler_t handler, void *ctx) {
+    if (router_lock == NULL) {
+        ESP_LOGE(TAG, "Cannot subscribe: MQTT client not started");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    mqtt_router_status_t status = MQTT_ROUTER_ERR_FULL;
+    if (subscription_count < MAX_SUBSCRIPTIONS) {
+        status = mqtt_router_add(&router, filter, handler, ctx);
+    }
+    if (status == MQTT_ROUTER_OK) {
+        subscriptions[subscription_count++] =
+            (subscription_t){.filter = filter, .qos = qos};
+    }
+    xSemaphoreGive(router_lock);
+
+    switch (status) {
+        case MQTT_ROUTER_OK:
+            break;
+        case MQTT_ROUTER_ERR_FILTER:
+            ESP_LOGE(TAG, "Invalid topic filter %s", filter);
+            return ESP_ERR_INVALID_ARG;
+        case MQTT_ROUTER_ERR_EXISTS:
+            ESP_LOGE(TAG, "%s already has a handler", filter);
+            return ESP_ERR_INVALID_STATE;
+        default:
+            ESP_LOGE(TAG, "No room to subscribe to %s", filter);
+            return ESP_ERR_NO_MEM;
+    }
+
+    // Otherwise the next MQTT_EVENT_CONNECTED subscribes
+    if (atomic_load(&connected)) {
+        esp_mqtt_client_subscribe(client, filter, qos);
+    }
+    return ESP_OK;
+}
+
+int mqtt_enqueue(const char *topic, const void *data, size_t len, int qos) {
+    mqtt_publish_opts_t opts = MQTT_PUBLISH_DEFAULT_OPTS();
+    opts.qos = qos;
+    return mqtt_enqueue_opts(topic, data, len, &opts);
+}
+
+int mqtt_enqueue_opts(const char *topic, const void *data, size_t len,
+                      const mqtt_publish_opts_t *opts) {
+    if (client == NULL || !atomic_load(&connected)) {
+        return -1;
+    }
+    return send_publish(topic, data, len, opts->qos, opts, true);
+}
+
+int mqtt_pending_bytes(void) {
+    return client != NULL ? esp_mqtt_client_get_outbox_size(client) : 0;
 }
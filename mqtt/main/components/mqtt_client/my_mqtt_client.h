@@ -1,9 +1,51 @@
 #ifndef MY_MQTT_CLIENT_H
 #define MY_MQTT_CLIENT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "components/mqtt_router/mqtt_router.h"
 #include "mqtt_client.h"
 
 esp_err_t mqtt_app_start(void);
 void mqtt_publish(const char *topic, const char *message);
 
+/* Skips the rest of the reconnect backoff, e.g. once Wi-Fi is back and
+ * the broker is likely reachable again. Safe from any task. */
+void mqtt_reconnect_now(void);
+
+/* Routes messages matching the filter ('+' and '#' allowed) to the
+ * handler, and subscribes now and after every reconnect. Call after
+ * mqtt_app_start(); the filter must stay valid (a string literal).
+ * Handlers run on the MQTT task, get the payload in place and must not
+ * subscribe or publish. A message split over several events is
+ * reassembled first. */
+esp_err_t mqtt_subscribe(const char *filter, int qos,
+                         mqtt_route_handler_t handler, void *ctx);
+
+/* MQTT v5 options for one message. An expiry lets the broker drop a
+ * command nobody received in time instead of delivering it late. */
+typedef struct {
+    int qos;
+    uint32_t expiry_s;  // 0: never expires
+    const esp_mqtt5_user_property_item_t *user_props;
+    uint8_t user_prop_count;
+} mqtt_publish_opts_t;
+
+#define MQTT_PUBLISH_DEFAULT_OPTS() \
+    {.qos = 0, .expiry_s = 0, .user_props = NULL, .user_prop_count = 0}
+
+/* Hands a binary message to the client's outbox without waiting for the
+ * network; the MQTT task sends it. Returns the message id, or -1 while
+ * disconnected or when the outbox is full. Nothing is queued offline.
+ * Always carries the full topic, never a topic alias. */
+int mqtt_enqueue(const char *topic, const void *data, size_t len, int qos);
+
+// mqtt_enqueue() with v5 options; same return values
+int mqtt_enqueue_opts(const char *topic, const void *data, size_t len,
+                      const mqtt_publish_opts_t *opts);
+
+// Bytes waiting in the client's outbox
+int mqtt_pending_bytes(void);
+
 #endif  // MY_MQTT_CLIENT_H
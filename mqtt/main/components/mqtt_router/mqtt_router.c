@@ -0,0 +1,192 @@
+#include "mqtt_router.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// FNV-1a, seeded with the parent so siblings spread across buckets
+static uint32_t level_hash(uint16_t parent, const char *level, size_t len) {
+    uint32_t hash = (2166136261u ^ parent) * 16777619u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)level[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint16_t new_node(mqtt_router_t *router, uint16_t parent,
+                         const char *level, size_t len) {
+    if (router->count == router->capacity) {
+        return MQTT_ROUTER_NONE;
+    }
+    uint16_t index = router->count++;
+    mqtt_router_node_t *node = &router->nodes[index];
+    memset(node, 0, sizeof(*node));
+    node->level = level;
+    node->level_len = len;
+    node->parent = parent;
+    node->hash = level_hash(parent, level, len);
+    return index;
+}
+
+void mqtt_router_init(mqtt_router_t *router, mqtt_router_node_t *nodes,
+                      uint16_t capacity) {
+    router->nodes = nodes;
+    router->capacity = capacity;
+    router->count = 0;
+    memset(router->buckets, 0, sizeof(router->buckets));
+    new_node(router, MQTT_ROUTER_NONE, "", 0);
+}
+
+static uint16_t find_child(const mqtt_router_t *router, uint16_t parent,
+                           const char *level, size_t len, uint32_t hash) {
+    uint16_t child = router->buckets[hash & (MQTT_ROUTER_BUCKETS - 1)];
+    while (child != MQTT_ROUTER_NONE) {
+        const mqtt_router_node_t *node = &router->nodes[child];
+        if (node->hash == hash && node->parent == parent &&
+            node->level_len == len && memcmp(node->level, level, len) == 0) {
+            return child;
+        }
+        child = node->next_in_bucket;
+    }
+    return MQTT_ROUTER_NONE;
+}
+
+// Returns the child for the level, creating it if needed
+static uint16_t add_child(mqtt_router_t *router, uint16_t parent,
+                          const char *level, size_t len) {
+    if (len == 1 && (level[0] == '+' || level[0] == '#')) {
+        mqtt_router_node_t *p = &router->nodes[parent];
+        uint16_t *slot = level[0] == '+' ? &p->plus_child : &p->hash_child;
+        if (*slot == MQTT_ROUTER_NONE) {
+            *slot = new_node(router, parent, level, len);
+        }
+        return *slot;
+    }
+
+    uint32_t hash = level_hash(parent, level, len);
+    uint16_t child = find_child(router, parent, level, len, hash);
+    if (child == MQTT_ROUTER_NONE) {
+        child = new_node(router, parent, level, len);
+        if (child != MQTT_ROUTER_NONE) {
+            uint16_t *bucket =
+                &router->buckets[hash & (MQTT_ROUTER_BUCKETS - 1)];
+            router->nodes[child].next_in_bucket = *bucket;
+            *bucket = child;
+        }
+    }
+    return child;
+}
+
+static bool filter_valid(const char *filter) {
+    if (filter[0] == '\0') {
+        return false;
+    }
+    for (const char *c = filter; *c != '\0'; c++) {
+        bool level_start = c == filter || c[-1] == '/';
+        bool level_end = c[1] == '\0' || c[1] == '/';
+        if (*c == '+' && !(level_start && level_end)) {
+            return false;
+        }
+        if (*c == '#' && !(level_start && c[1] == '\0')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+mqtt_router_status_t mqtt_router_add(mqtt_router_t *router, const char *filter,
+                                     mqtt_route_handler_t handler, void *ctx) {
+    if (!filter_valid(filter)) {
+        return MQTT_ROUTER_ERR_FILTER;
+    }
+
+    uint16_t node = 0;
+    const char *level = filter;
+    while (true) {
+        const char *slash = strchr(level, '/');
+        size_t len = slash != NULL ? (size_t)(slash - level) : strlen(level);
+        node = add_child(router, node, level, len);
+        if (node == MQTT_ROUTER_NONE) {
+            return MQTT_ROUTER_ERR_FULL;
+        }
+        if (slash == NULL) {
+            break;
+        }
+        level = slash + 1;
+    }
+
+    mqtt_router_node_t *n = &router->nodes[node];
+    if (n->handler != NULL) {
+        return MQTT_ROUTER_ERR_EXISTS;
+    }
+    n->handler = handler;
+    n->ctx = ctx;
+    return MQTT_ROUTER_OK;
+}
+
+typedef struct {
+    const mqtt_router_t *router;
+    const char *topic;
+    size_t topic_len;
+    const char *data;
+    size_t data_len;
+    size_t delivered;
+} route_t;
+
+static void deliver(route_t *r, uint16_t index) {
+    const mqtt_router_node_t *node = &r->router->nodes[index];
+    if (node->handler != NULL) {
+        node->handler(r->topic, r->topic_len, r->data, r->data_len,
+                      node->ctx);
+        r->delivered++;
+    }
+}
+
+// Matches the topic from the level starting at pos; at_end once all are used
+static void match(route_t *r, uint16_t index, size_t pos, bool at_end) {
+    const mqtt_router_node_t *node = &r->router->nodes[index];
+    if (at_end) {
+        deliver(r, index);
+        if (node->hash_child != MQTT_ROUTER_NONE) {
+            deliver(r, node->hash_child);  // "a/#" matches "a"
+        }
+        return;
+    }
+
+    const char *level = r->topic + pos;
+    const char *slash = memchr(level, '/', r->topic_len - pos);
+    size_t len = slash != NULL ? (size_t)(slash - level) : r->topic_len - pos;
+    size_t next = pos + len + 1;
+    bool last = slash == NULL;
+
+    uint16_t child = find_child(r->router, index, level, len,
+                                level_hash(index, level, len));
+    if (child != MQTT_ROUTER_NONE) {
+        match(r, child, next, last);
+    }
+
+    // Wildcards never match a leading "$" level ($SYS and the like)
+    if (pos == 0 && len > 0 && level[0] == '$') {
+        return;
+    }
+    if (node->plus_child != MQTT_ROUTER_NONE) {
+        match(r, node->plus_child, next, last);
+    }
+    if (node->hash_child != MQTT_ROUTER_NONE) {
+        deliver(r, node->hash_child);
+    }
+}
+
+size_t mqtt_router_route(const mqtt_router_t *router, const char *topic,
+                         size_t topic_len, const char *data,
+                         size_t data_len) {
+    route_t r = {.router = router,
+                 .topic = topic,
+                 .topic_len = topic_len,
+                 .data = data,
+                 .data_len = data_len,
+                 .delivered = 0};
+    if (topic_len > 0) {
+        match(&r, 0, 0, false);
+    }
+    return r.delivered;
+}
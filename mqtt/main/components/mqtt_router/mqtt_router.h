@@ -0,0 +1,62 @@
+#ifndef MQTT_ROUTER_H
+#define MQTT_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Topic filter trie for routing inbound MQTT messages. Each filter level
+ * is a node; named children are found through a hash table keyed on
+ * (parent, level) and '+' and '#' children are kept apart, so a lookup
+ * costs one pass over the topic plus the wildcard branches, however many
+ * filters are registered. Matching follows the MQTT spec: "a/#" also
+ * matches "a", and wildcards at the first level skip "$" topics.
+ *
+ * Nodes come from caller-provided storage and levels point into the
+ * filter strings, which must outlive the router (string literals). Routing
+ * never allocates. Not thread safe. Plain C so it also builds on the
+ * host. */
+#define MQTT_ROUTER_NONE 0
+#define MQTT_ROUTER_BUCKETS 128  // power of two
+
+// Called with the topic and payload exactly as received; no copies
+typedef void (*mqtt_route_handler_t)(const char *topic, size_t topic_len,
+                                     const char *data, size_t data_len,
+                                     void *ctx);
+
+typedef struct {
+    uint32_t hash;  // of parent and level, checked before comparing bytes
+    const char *level;
+    uint16_t level_len;
+    uint16_t parent;
+    uint16_t next_in_bucket;
+    uint16_t plus_child;
+    uint16_t hash_child;
+    mqtt_route_handler_t handler;
+    void *ctx;
+} mqtt_router_node_t;
+
+typedef struct {
+    mqtt_router_node_t *nodes;  // nodes[0] is the root
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t buckets[MQTT_ROUTER_BUCKETS];
+} mqtt_router_t;
+
+typedef enum {
+    MQTT_ROUTER_OK = 0,
+    MQTT_ROUTER_ERR_FILTER,  // empty, or a wildcard misplaced
+    MQTT_ROUTER_ERR_EXISTS,  // filter already has a handler
+    MQTT_ROUTER_ERR_FULL,    // out of nodes
+} mqtt_router_status_t;
+
+void mqtt_router_init(mqtt_router_t *router, mqtt_router_node_t *nodes,
+                      uint16_t capacity);
+
+mqtt_router_status_t mqtt_router_add(mqtt_router_t *router, const char *filter,
+                                     mqtt_route_handler_t handler, void *ctx);
+
+// Calls every matching handler; returns how many were called
+size_t mqtt_router_route(const mqtt_router_t *router, const char *topic,
+                         size_t topic_len, const char *data, size_t data_len);
+
+#endif  // MQTT_ROUTER_H
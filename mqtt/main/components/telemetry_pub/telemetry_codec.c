@@ -0,0 +1,125 @@
+#include "telemetry_codec.h"
+
+#include <stdbool.h>
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} out_t;
+
+static void put_byte(out_t *out, uint8_t byte) {
+    if (out->len < out->cap) {
+        out->buf[out->len++] = byte;
+    } else {
+        out->overflow = true;
+    }
+}
+
+static void put_le(out_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        put_byte(out, value >> (8 * i));
+    }
+}
+
+static void put_varint(out_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        put_byte(out, (value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    put_byte(out, value);
+}
+
+static uint64_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// CBOR head: major type plus the shortest argument encoding
+static void put_cbor_head(out_t *out, uint8_t major, uint64_t arg) {
+    major <<= 5;
+    if (arg < 24) {
+        put_byte(out, major | arg);
+    } else if (arg <= 0xff) {
+        put_byte(out, major | 24);
+        put_byte(out, arg);
+    } else if (arg <= 0xffff) {
+        put_byte(out, major | 25);
+        put_byte(out, arg >> 8);
+        put_byte(out, arg);
+    } else if (arg <= 0xffffffff) {
+        put_byte(out, major | 26);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            put_byte(out, arg >> shift);
+        }
+    } else {
+        put_byte(out, major | 27);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            put_byte(out, arg >> shift);
+        }
+    }
+}
+
+static void put_cbor_int(out_t *out, int64_t value) {
+    if (value >= 0) {
+        put_cbor_head(out, 0, value);
+    } else {
+        put_cbor_head(out, 1, -1 - value);
+    }
+}
+
+static void encode_packed(out_t *out, const telemetry_sample_t *samples,
+                          size_t count, int64_t base) {
+    put_byte(out, TELEMETRY_CODEC_VERSION);
+    put_byte(out, TELEMETRY_FORMAT_PACKED);
+    put_le(out, count, 2);
+    put_le(out, base, 8);
+
+    int64_t prev = base;
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_sample_t *s = &samples[i];
+        put_varint(out, s->timestamp_us - prev);
+        put_byte(out, s->source);
+        put_byte(out, s->count);
+        for (uint8_t v = 0; v < s->count; v++) {
+            put_varint(out, zigzag(s->values[v]));
+        }
+        prev = s->timestamp_us;
+    }
+}
+
+static void encode_cbor(out_t *out, const telemetry_sample_t *samples,
+                        size_t count, int64_t base) {
+    put_cbor_head(out, 4, 3);
+    put_cbor_int(out, TELEMETRY_CODEC_VERSION);
+    put_cbor_int(out, base);
+    put_cbor_head(out, 4, count);
+
+    int64_t prev = base;
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_sample_t *s = &samples[i];
+        put_cbor_head(out, 4, 2 + s->count);
+        put_cbor_int(out, s->timestamp_us - prev);
+        put_cbor_int(out, s->source);
+        for (uint8_t v = 0; v < s->count; v++) {
+            put_cbor_int(out, s->values[v]);
+        }
+        prev = s->timestamp_us;
+    }
+}
+
+size_t telemetry_encode(telemetry_format_t format,
+                        const telemetry_sample_t *samples, size_t count,
+                        uint8_t *buf, size_t cap) {
+    out_t out = {.buf = buf, .cap = cap, .len = 0, .overflow = false};
+    if (count > 0xffff) {
+        return 0;
+    }
+    int64_t base = count > 0 ? samples[0].timestamp_us : 0;
+    if (format == TELEMETRY_FORMAT_CBOR) {
+        encode_cbor(&out, samples, count, base);
+    } else {
+        encode_packed(&out, samples, count, base);
+    }
+    return out.overflow ? 0 : out.len;
+}
@@ -0,0 +1,44 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Batch encodings for telemetry samples. Plain C so it also builds on the
+ * host; mqtt/tools/telemetry_decode.py reads both formats.
+ *
+ * Packed (little-endian):
+ *   u8 version (1), u8 format (0), u16 sample count, u64 base time (us)
+ *   per sample: varint dt_us since the previous sample (the first is
+ *   relative to base), u8 source, u8 value count, zigzag varint values
+ *
+ * CBOR (RFC 8949):
+ *   [1, base_us, [[dt_us, source, v0, v1, ...], ...]]
+ */
+#define TELEMETRY_MAX_VALUES 6
+#define TELEMETRY_CODEC_VERSION 1
+
+typedef enum {
+    TELEMETRY_FORMAT_PACKED = 0,
+    TELEMETRY_FORMAT_CBOR,
+} telemetry_format_t;
+
+typedef struct {
+    int64_t timestamp_us;
+    uint8_t source;
+    uint8_t count;  // used entries of values
+    int32_t values[TELEMETRY_MAX_VALUES];
+} telemetry_sample_t;
+
+/* Upper bound of one encoded sample, so callers can size batches that are
+ * guaranteed to fit */
+#define TELEMETRY_HEADER_MAX 14
+#define TELEMETRY_SAMPLE_MAX (9 + 2 + 2 + TELEMETRY_MAX_VALUES * 5)
+
+/* Encodes the samples, which must be in time order, into buf. Returns the
+ * encoded length, or 0 if it does not fit in cap. */
+size_t telemetry_encode(telemetry_format_t format,
+                        const telemetry_sample_t *samples, size_t count,
+                        uint8_t *buf, size_t cap);
+
+#endif  // TELEMETRY_CODEC_H
@@ -0,0 +1,236 @@
+#include "telemetry_pub.h"
+
+#include <string.h>
+
+#include "components/mqtt_client/my_mqtt_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+static const char *TAG = "TELEMETRY";
+
+METRIC_COUNTER(samples_metric, "telemetry_samples_total",
+               "Telemetry samples pushed");
+METRIC_COUNTER(dropped_metric, "telemetry_dropped_total",
+               "Telemetry samples dropped because the ring was full");
+METRIC_COUNTER(batches_metric, "telemetry_batches_total",
+               "Telemetry payloads enqueued");
+METRIC_COUNTER(encode_failed_metric, "telemetry_encode_failed_total",
+               "Telemetry batches that did not fit the payload buffer");
+METRIC_COUNTER(enqueue_failed_metric, "telemetry_enqueue_failed_total",
+               "Telemetry payloads the MQTT client did not accept");
+METRIC_GAUGE(ring_depth_metric, "telemetry_ring_depth",
+             "Samples waiting in the telemetry ring");
+METRIC_GAUGE(pending_bytes_metric, "mqtt_pending_bytes",
+             "Bytes waiting in the MQTT client outbox");
+METRIC_HISTOGRAM(flush_latency_metric, "telemetry_flush_latency_us",
+                 "Age of the oldest sample when its payload was enqueued",
+                 10000, 50000, 100000, 250000, 500000, 1000000, 2500000);
+
+static telemetry_pub_config_t pub_config;
+static TaskHandle_t flush_task_handle;
+
+// Multi-producer ring; the critical sections only cover one sample copy
+static telemetry_sample_t ring[TELEMETRY_RING_SLOTS];
+static uint32_t ring_head;  // next slot to pop
+static uint32_t ring_count;
+static telemetry_pub_stats_t stats;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Only the flush task touches these
+static telemetry_sample_t batch[TELEMETRY_MAX_BATCH];
+static uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+
+bool telemetry_pub_push(uint8_t source, const int32_t *values, uint8_t count) {
+    if (count > TELEMETRY_MAX_VALUES) {
+        count = TELEMETRY_MAX_VALUES;
+    }
+    taskENTER_CRITICAL(&ring_lock);
+    // Stamped under the lock, so ring order is timestamp order and the
+    // encoder's deltas never go negative
+    int64_t now = esp_timer_get_time();
+    bool queued = ring_count < TELEMETRY_RING_SLOTS;
+    uint32_t depth = ring_count;
+    if (queued) {
+        telemetry_sample_t *s =
+            &ring[(ring_head + ring_count) % TELEMETRY_RING_SLOTS];
+        s->timestamp_us = now;
+        s->source = source;
+        s->count = count;
+        memcpy(s->values, values, count * sizeof(values[0]));
+        depth = ++ring_count;
+        stats.samples++;
+    } else {
+        stats.dropped++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (!queued) {
+        metric_inc(&dropped_metric);
+        return false;
+    }
+    metric_inc(&samples_metric);
+    if (depth == pub_config.flush_samples && flush_task_handle != NULL) {
+        xTaskNotifyGive(flush_task_handle);
+    }
+    return true;
+}
+
+static size_t pop_batch(void) {
+    size_t n = 0;
+    while (n < TELEMETRY_MAX_BATCH) {
+        taskENTER_CRITICAL(&ring_lock);
+        bool have = ring_count > 0;
+        if (have) {
+            batch[n] = ring[ring_head];
+            ring_head = (ring_head + 1) % TELEMETRY_RING_SLOTS;
+            ring_count--;
+        }
+        taskEXIT_CRITICAL(&ring_lock);
+        if (!have) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+static uint32_t ring_depth(void) {
+    taskENTER_CRITICAL(&ring_lock);
+    uint32_t depth = ring_count;
+    taskEXIT_CRITICAL(&ring_lock);
+    return depth;
+}
+
+static void flush_batch(void) {
+    size_t n = pop_batch();
+    if (n == 0) {
+        return;
+    }
+
+    // Sized for a full batch, so encoding should not run out of room
+    size_t len = telemetry_encode(pub_config.format, batch, n, payload,
+                                  sizeof(payload));
+    if (len == 0) {
+        // esp-mqtt would take a zero length as strlen() of the payload
+        taskENTER_CRITICAL(&ring_lock);
+        stats.encode_failed++;
+        taskEXIT_CRITICAL(&ring_lock);
+        metric_inc(&encode_failed_metric);
+        ESP_LOGE(TAG, "%u samples did not fit the payload", (unsigned)n);
+        return;
+    }
+    int msg_id = mqtt_enqueue(pub_config.topic, payload, len, pub_config.qos);
+    int64_t latency_us = esp_timer_get_time() - batch[0].timestamp_us;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (msg_id < 0) {
+        stats.enqueue_failed++;
+    } else {
+        stats.batches++;
+        stats.bytes += len;
+        if (latency_us > stats.flush_latency_max_us) {
+            stats.flush_latency_max_us = latency_us;
+        }
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (msg_id < 0) {
+        metric_inc(&enqueue_failed_metric);
+    } else {
+        metric_inc(&batches_metric);
+        metric_observe(&flush_latency_metric, latency_us);
+    }
+    metric_set(&ring_depth_metric, ring_depth());
+    metric_set(&pending_bytes_metric, mqtt_pending_bytes());
+}
+
+static void report_stats(const telemetry_pub_stats_t *prev, int64_t span_us) {
+    telemetry_pub_stats_t cur;
+    telemetry_pub_get_stats(&cur);
+    uint32_t batches = cur.batches - prev->batches;
+    float secs = span_us / 1e6f;
+    ESP_LOGI(TAG,
+             "%.0f samples/s in %lu payloads (%lu B avg), dropped %lu, "
+             "encode failed %lu, enqueue failed %lu, ring %lu, pending %d B, "
+             "latency max %lu us",
+             (cur.samples - prev->samples) / secs, (unsigned long)batches,
+             (unsigned long)(batches ? (cur.bytes - prev->bytes) / batches
+                                     : 0),
+             (unsigned long)(cur.dropped - prev->dropped),
+             (unsigned long)(cur.encode_failed - prev->encode_failed),
+             (unsigned long)(cur.enqueue_failed - prev->enqueue_failed),
+             (unsigned long)ring_depth(), mqtt_pending_bytes(),
+             (unsigned long)cur.flush_latency_max_us);
+}
+
+static void telemetry_flush_task(void *pvParameters) {
+    int64_t last_flush = 0;
+    int64_t last_report = esp_timer_get_time();
+    telemetry_pub_stats_t report_base;
+    telemetry_pub_get_stats(&report_base);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(pub_config.flush_interval_ms));
+
+        // Rate limit: a size-triggered flush still waits out the interval
+        int64_t wait_us =
+            last_flush + pub_config.min_interval_ms * 1000LL -
+            esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+        }
+        flush_batch();
+        last_flush = esp_timer_get_time();
+
+        // Backlog left: go round again without waiting for a notify
+        if (ring_depth() >= pub_config.flush_samples) {
+            xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+        }
+
+        if (last_flush - last_report >= TELEMETRY_STATS_INTERVAL_MS * 1000LL) {
+            report_stats(&report_base, last_flush - last_report);
+            telemetry_pub_get_stats(&report_base);
+            last_report = last_flush;
+            taskENTER_CRITICAL(&ring_lock);
+            stats.flush_latency_max_us = 0;
+            taskEXIT_CRITICAL(&ring_lock);
+        }
+    }
+}
+
+esp_err_t telemetry_pub_start(const telemetry_pub_config_t *config) {
+    if (config->topic == NULL || config->flush_samples == 0 ||
+        config->flush_samples > TELEMETRY_MAX_BATCH) {
+        ESP_LOGE(TAG, "Invalid telemetry config");
+        return ESP_ERR_INVALID_ARG;
+    }
+    pub_config = *config;
+
+    metrics_register(&samples_metric);
+    metrics_register(&dropped_metric);
+    metrics_register(&batches_metric);
+    metrics_register(&encode_failed_metric);
+    metrics_register(&enqueue_failed_metric);
+    metrics_register(&ring_depth_metric);
+    metrics_register(&pending_bytes_metric);
+    metrics_register(&flush_latency_metric);
+
+    if (xTaskCreatePinnedToCore(telemetry_flush_task, "telemetry_flush", 4096,
+                                NULL, config->priority, &flush_task_handle,
+                                config->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create telemetry flush task");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Publishing %s telemetry to %s",
+             config->format == TELEMETRY_FORMAT_CBOR ? "CBOR" : "packed",
+             config->topic);
+    return ESP_OK;
+}
+
+void telemetry_pub_get_stats(telemetry_pub_stats_t *out) {
+    taskENTER_CRITICAL(&ring_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&ring_lock);
+}
@@ -0,0 +1,64 @@
+#ifndef TELEMETRY_PUB_H
+#define TELEMETRY_PUB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry_codec.h"
+
+/* Batched telemetry publisher. Producers push samples into a RAM ring;
+ * one task flushes them as a single packed or CBOR payload through
+ * esp_mqtt_client_enqueue() every flush_interval_ms, or sooner once
+ * flush_samples are waiting, but never more often than min_interval_ms. */
+#define TELEMETRY_RING_SLOTS 256
+#define TELEMETRY_MAX_BATCH 64
+#define TELEMETRY_PAYLOAD_SIZE \
+    (TELEMETRY_HEADER_MAX + TELEMETRY_MAX_BATCH * TELEMETRY_SAMPLE_MAX)
+#define TELEMETRY_STATS_INTERVAL_MS 10000
+
+typedef struct {
+    const char *topic;
+    telemetry_format_t format;
+    uint32_t flush_interval_ms;  // time threshold
+    uint32_t min_interval_ms;    // rate limit between payloads
+    uint16_t flush_samples;      // size threshold, at most TELEMETRY_MAX_BATCH
+    int qos;
+    UBaseType_t priority;
+    BaseType_t core;
+} telemetry_pub_config_t;
+
+#define TELEMETRY_PUB_DEFAULT_CONFIG()          \
+    {                                           \
+        .topic = "telemetry",                   \
+        .format = TELEMETRY_FORMAT_PACKED,      \
+        .flush_interval_ms = 500,               \
+        .min_interval_ms = 100,                 \
+        .flush_samples = 50,                    \
+        .qos = 0,                               \
+        .priority = 4,                          \
+        .core = tskNO_AFFINITY,                 \
+    }
+
+typedef struct {
+    uint32_t samples;
+    uint32_t dropped;         // ring full
+    uint32_t batches;
+    uint32_t encode_failed;   // batch did not fit the payload buffer
+    uint32_t enqueue_failed;  // disconnected or client outbox full
+    uint32_t bytes;
+    uint32_t flush_latency_max_us;  // oldest sample age when enqueued
+} telemetry_pub_stats_t;
+
+esp_err_t telemetry_pub_start(const telemetry_pub_config_t *config);
+
+/* Never blocks; safe from any task, not from ISRs. Returns false if the
+ * ring is full and the sample was dropped. Values beyond
+ * TELEMETRY_MAX_VALUES are ignored. */
+bool telemetry_pub_push(uint8_t source, const int32_t *values, uint8_t count);
+
+void telemetry_pub_get_stats(telemetry_pub_stats_t *stats);
+
+#endif  // TELEMETRY_PUB_H
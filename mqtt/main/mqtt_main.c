@@ -1,15 +1,51 @@
 #include <stdio.h>
 
 #include "components/mqtt_client/my_mqtt_client.h"
+#include "components/telemetry_pub/telemetry_pub.h"
 #include "wifi_utils.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "nvs_flash.h"
+#include "settings.h"
 
 static const char* TAG = "MQTT_MAIN";
 
+#define SAMPLE_HZ 100
+#define TELEMETRY_SOURCE_SYSTEM 0
+
+static void on_command(const char* topic, size_t topic_len, const char* data,
+                       size_t data_len, void* ctx) {
+    ESP_LOGI(TAG, "Command on %.*s: %.*s", (int)topic_len, topic,
+             (int)data_len, data);
+}
+
+/* A "token=<secret>" line, then "name=value" lines; stored now, applied
+ * on the next boot. Refused unless remote writes are enabled. */
+static void on_config(const char* topic, size_t topic_len, const char* data,
+                      size_t data_len, void* ctx) {
+    int bad_line;
+    esp_err_t err = settings_apply_remote(data, data_len, &bad_line);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Config rejected: remote writes are disabled");
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Config rejected: bad token");
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Config line %d rejected: %s", bad_line,
+                 esp_err_to_name(err));
+    } else if (settings_restart_needed()) {
+        ESP_LOGI(TAG, "Config stored, restart to apply");
+    }
+}
+
+static void on_wifi_state(wifi_state_t state, void* ctx) {
+    if (state == WIFI_STATE_CONNECTED) {
+        mqtt_reconnect_now();
+    }
+}
+
 void app_main() {
     esp_err_t nvs_err = nvs_flash_init();
     if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES ||
@@ -20,9 +56,8 @@ void app_main() {
     ESP_ERROR_CHECK(nvs_err);
 
     ESP_LOGI(TAG, "Connecting to wi-fi ESP_WIFI_MODE_STA...");
-    wifi_status_t status = wifi_init_sta();
-    if (status == WIFI_STATUS_FAIL) {
-        ESP_LOGE(TAG, "Wi-Fi connection failed. Stopping execution.");
+    if (wifi_start_async() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi failed to start. Stopping execution.");
         return;
     }
 
@@ -31,9 +66,36 @@ void app_main() {
         ESP_LOGE(TAG, "MQTT initialization failed. Stopping execution.");
         return;
     }
+    // The client backs off while Wi-Fi is down; retry as soon as it is up
+    wifi_subscribe(on_wifi_state, NULL);
+    mqtt_subscribe(settings_get_str(SETTING_MQTT_TOPIC), 0, on_command, NULL);
+    mqtt_subscribe("config/set", 1, on_config, NULL);
+
+    telemetry_pub_config_t telemetry_config = TELEMETRY_PUB_DEFAULT_CONFIG();
+    telemetry_config.topic = "telemetry/esp32";
+    if (telemetry_pub_start(&telemetry_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Telemetry publisher failed to start.");
+        return;
+    }
 
+    /* Sensor tasks push their samples the same way; here the loop samples
+     * heap usage so the publisher runs at a realistic rate. */
+    uint32_t count = 0;
+    char message[48];
+    TickType_t last_wake = xTaskGetTickCount();
     while (true) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        mqtt_publish("test/message", "Hello World! -from ESP32");
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(1000 / SAMPLE_HZ));
+        int32_t values[] = {(int32_t)esp_get_free_heap_size(),
+                            (int32_t)esp_get_minimum_free_heap_size()};
+        telemetry_pub_push(TELEMETRY_SOURCE_SYSTEM, values, 2);
+
+        if (count % SAMPLE_HZ == 0) {
+            // The count lets a test broker spot messages lost across
+            // reconnects
+            snprintf(message, sizeof(message), "Hello World! -from ESP32 #%lu",
+                     (unsigned long)(count / SAMPLE_HZ));
+            mqtt_publish("test/message", message);
+        }
+        count++;
     }
 }
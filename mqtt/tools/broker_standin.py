@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Mosquitto stand-in that takes the broker down on a schedule.
+
+Speaks just enough MQTT 3.1.1 / 5 for the mqtt project (CONNECT, SUBSCRIBE,
+PUBLISH at QoS 0/1, PINGREQ). Every --period seconds it drops all clients
+and refuses connections for --outage seconds, then reports how long the
+board took to come back, how many numbered messages ("... #N") were lost
+and the largest number it received in any 100 ms window, which shows
+whether the offline backlog arrives as a burst. It also counts PUBLISH
+bytes on the wire; compare a run with --alias-max 0 against the default
+to see what MQTT v5 topic aliases save.
+
+    python3 broker_standin.py --period 30 --outage 10 --duration 300
+    python3 broker_standin.py --outage 0 --duration 60 --alias-max 0
+
+Point the board's broker URI at this host.
+"""
+
+import argparse
+import asyncio
+import re
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 12, 13, 14
+TOPIC_ALIAS_MAXIMUM = 0x22
+SEQ_RE = re.compile(rb"#(\d+)$")
+
+
+class Stats:
+    def __init__(self):
+        self.connects = []      # monotonic times of CONNECT packets
+        self.reconnect_s = []   # outage end -> first CONNECT
+        self.seqs = []
+        self.bursts = {}        # 100 ms bucket -> messages
+        self.outage_end = None
+        self.publishes = 0
+        self.publish_bytes = 0  # whole packets, fixed header included
+        self.aliased = 0        # sent with an empty topic
+
+
+def encode_len(n):
+    out = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def decode_len(data, pos):
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def packet(ptype, body, flags=0):
+    return bytes([ptype << 4 | flags]) + encode_len(len(body)) + body
+
+
+async def read_packet(reader):
+    header = await reader.readexactly(1)
+    length, shift = 0, 0
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return header[0], await reader.readexactly(length)
+
+
+def wire_size(body):
+    return 1 + len(encode_len(len(body))) + len(body)
+
+
+class Broker:
+    def __init__(self, args, stats):
+        self.args = args
+        self.stats = stats
+        self.writers = set()
+        self.server = None
+
+    async def handle(self, reader, writer):
+        self.writers.add(writer)
+        v5 = False
+        try:
+            while True:
+                header, body = await read_packet(reader)
+                ptype = header >> 4
+                if ptype == CONNECT:
+                    v5 = body[6] == 5  # protocol level after "\0\4MQTT"
+                    self.on_connect()
+                    writer.write(packet(CONNACK, self.connack(v5)))
+                elif ptype == SUBSCRIBE:
+                    pos = 2
+                    if v5:
+                        props, pos = decode_len(body, pos)
+                        pos += props
+                    codes = bytearray()
+                    while pos < len(body):
+                        topic_len = int.from_bytes(body[pos:pos + 2], "big")
+                        pos += 2 + topic_len + 1
+                        codes.append(0)
+                    prefix = body[:2] + (b"\x00" if v5 else b"")
+                    writer.write(packet(SUBACK, prefix + bytes(codes)))
+                elif ptype == PUBLISH:
+                    qos = (header >> 1) & 3
+                    topic_len = int.from_bytes(body[:2], "big")
+                    self.stats.publishes += 1
+                    self.stats.publish_bytes += wire_size(body)
+                    self.stats.aliased += topic_len == 0
+                    pos = 2 + topic_len
+                    if qos:
+                        writer.write(packet(PUBACK, body[pos:pos + 2]))
+                        pos += 2
+                    if v5:
+                        props, pos = decode_len(body, pos)
+                        pos += props
+                    self.on_publish(body[pos:])
+                elif ptype == PINGREQ:
+                    writer.write(packet(PINGRESP, b""))
+                elif ptype == DISCONNECT:
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            self.writers.discard(writer)
+            writer.close()
+
+    def connack(self, v5):
+        if not v5:
+            return b"\x00\x00"
+        props = b""
+        if self.args.alias_max:
+            props = bytes([TOPIC_ALIAS_MAXIMUM]) + \
+                self.args.alias_max.to_bytes(2, "big")
+        return b"\x00\x00" + encode_len(len(props)) + props
+
+    def on_connect(self):
+        now = time.monotonic()
+        self.stats.connects.append(now)
+        if self.stats.outage_end is not None:
+            took = now - self.stats.outage_end
+            self.stats.reconnect_s.append(took)
+            self.stats.outage_end = None
+            print(f"reconnected {took:.2f}s after the broker came back")
+        else:
+            print("client connected")
+
+    def on_publish(self, payload):
+        bucket = int(time.monotonic() * 10)
+        self.stats.bursts[bucket] = self.stats.bursts.get(bucket, 0) + 1
+        match = SEQ_RE.search(payload)
+        if match:
+            self.stats.seqs.append(int(match.group(1)))
+
+    async def start(self):
+        self.server = await asyncio.start_server(self.handle, self.args.bind,
+                                                 self.args.port)
+
+    async def outage(self):
+        print(f"broker down for {self.args.outage:.0f}s")
+        self.server.close()
+        await self.server.wait_closed()
+        for writer in list(self.writers):
+            writer.transport.abort()
+        await asyncio.sleep(self.args.outage)
+        await self.start()
+        self.stats.outage_end = time.monotonic()
+        print("broker up")
+
+
+def report(stats):
+    seqs = stats.seqs
+    unique = sorted(set(seqs))
+    lost = (unique[-1] - unique[0] + 1 - len(unique)) if unique else 0
+    print(f"connects   {len(stats.connects)}")
+    if stats.reconnect_s:
+        rs = sorted(stats.reconnect_s)
+        print(f"reconnect  min {rs[0]:.2f}s  median {rs[len(rs) // 2]:.2f}s"
+              f"  max {rs[-1]:.2f}s over {len(rs)} outages")
+    print(f"messages   {len(seqs)} received, {len(unique)} unique, "
+          f"{len(seqs) - len(unique)} duplicates")
+    if unique:
+        print(f"loss       {lost} of {unique[-1] - unique[0] + 1} "
+              f"(#{unique[0]}..#{unique[-1]})")
+    if stats.publishes:
+        print(f"wire       {stats.publish_bytes} PUBLISH bytes, "
+              f"{stats.publish_bytes / stats.publishes:.1f} per message, "
+              f"{stats.aliased} sent with a topic alias")
+    if stats.bursts:
+        print(f"burst      max {max(stats.bursts.values())} messages "
+              f"in 100 ms")
+
+
+async def run(args):
+    stats = Stats()
+    broker = Broker(args, stats)
+    await broker.start()
+    print(f"listening on {args.bind}:{args.port}")
+    start = time.monotonic()
+    next_outage = start + args.period
+    while time.monotonic() - start < args.duration:
+        await asyncio.sleep(0.1)
+        if args.outage > 0 and time.monotonic() >= next_outage:
+            await broker.outage()
+            next_outage = time.monotonic() + args.period
+    report(stats)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--period", type=float, default=30.0,
+                        help="seconds of uptime between outages")
+    parser.add_argument("--outage", type=float, default=10.0,
+                        help="seconds the broker stays down; 0 disables")
+    parser.add_argument("--duration", type=float, default=300.0,
+                        help="seconds")
+    parser.add_argument("--alias-max", type=int, default=10,
+                        help="Topic Alias Maximum sent to v5 clients; "
+                             "0 disables aliases")
+    args = parser.parse_args()
+    asyncio.run(run(args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,198 @@
+/* Host benchmark: trie routing against matching every filter in turn.
+ *
+ *   cc -O2 -I../main/components/mqtt_router mqtt_router_bench.c \
+ *       ../main/components/mqtt_router/mqtt_router.c -o mqtt_router_bench
+ *   ./mqtt_router_bench [robots] [iterations]
+ *
+ * Registers five filters per robot (so 100 robots is 500 subscriptions,
+ * a mix of exact, '+' and '#'), then routes a set of topics and reports
+ * ns/message for both approaches. A small spec check runs first.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mqtt_router.h"
+
+#define MAX_FILTERS 8192
+#define FILTER_LEN 48
+
+static char filters[MAX_FILTERS][FILTER_LEN];
+static int filter_count;
+static volatile size_t sink;
+
+static void count_handler(const char *topic, size_t topic_len,
+                          const char *data, size_t data_len, void *ctx) {
+    (void)topic;
+    (void)data;
+    sink += topic_len + data_len + (size_t)ctx;
+}
+
+// Straightforward per-filter matcher, the alternative to the trie
+static bool filter_matches(const char *filter, const char *topic,
+                           size_t topic_len) {
+    const char *t = topic;
+    const char *end = topic + topic_len;
+    if (topic_len > 0 && topic[0] == '$' &&
+        (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+    while (*filter != '\0') {
+        if (filter[0] == '#') {
+            return true;
+        }
+        const char *level_end = memchr(t, '/', end - t);
+        if (level_end == NULL) {
+            level_end = end;
+        }
+        if (filter[0] == '+') {
+            filter++;
+        } else {
+            size_t len = level_end - t;
+            if (strncmp(filter, t, len) != 0 ||
+                (filter[len] != '/' && filter[len] != '\0')) {
+                return false;
+            }
+            filter += len;
+        }
+        if (level_end == end) {
+            // Topic done: filter must be done too, or be "/#"
+            return *filter == '\0' || strcmp(filter, "/#") == 0;
+        }
+        if (*filter != '/') {
+            return false;
+        }
+        filter++;
+        t = level_end + 1;
+    }
+    return false;
+}
+
+static size_t route_linear(const char *topic, size_t topic_len) {
+    size_t delivered = 0;
+    for (int i = 0; i < filter_count; i++) {
+        if (filter_matches(filters[i], topic, topic_len)) {
+            count_handler(topic, topic_len, NULL, 0, NULL);
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int spec_check(void) {
+    static mqtt_router_node_t nodes[32];
+    mqtt_router_t router;
+    mqtt_router_init(&router, nodes, 32);
+    const char *subs[] = {"a/b", "a/+", "a/#", "#", "+/b", "$SYS/x"};
+    for (size_t i = 0; i < sizeof(subs) / sizeof(subs[0]); i++) {
+        mqtt_router_add(&router, subs[i], count_handler, NULL);
+    }
+    struct {
+        const char *topic;
+        size_t expect;
+    } cases[] = {{"a/b", 5}, {"a", 2}, {"a/c", 3}, {"x/b", 2},
+                 {"a/b/c", 2}, {"$SYS/x", 1}, {"$SYS/y", 0}};
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t got = mqtt_router_route(&router, cases[i].topic,
+                                       strlen(cases[i].topic), NULL, 0);
+        if (got != cases[i].expect) {
+            printf("spec: %s matched %zu, expected %zu\n", cases[i].topic, got,
+                   cases[i].expect);
+            failures++;
+        }
+    }
+    if (mqtt_router_add(&router, "a/#/b", count_handler, NULL) !=
+            MQTT_ROUTER_ERR_FILTER ||
+        mqtt_router_add(&router, "a+", count_handler, NULL) !=
+            MQTT_ROUTER_ERR_FILTER ||
+        mqtt_router_add(&router, "a/b", count_handler, NULL) !=
+            MQTT_ROUTER_ERR_EXISTS) {
+        printf("spec: invalid filter accepted\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int robots = argc > 1 ? atoi(argv[1]) : 100;
+    long iterations = argc > 2 ? atol(argv[2]) : 1000000;
+    if (robots * 5 > MAX_FILTERS) {
+        robots = MAX_FILTERS / 5;
+    }
+
+    if (spec_check() != 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < robots; i++) {
+        snprintf(filters[filter_count++], FILTER_LEN, "fleet/robot%d/cmd", i);
+        snprintf(filters[filter_count++], FILTER_LEN, "fleet/robot%d/cfg/+",
+                 i);
+        snprintf(filters[filter_count++], FILTER_LEN, "fleet/robot%d/ota/#",
+                 i);
+        snprintf(filters[filter_count++], FILTER_LEN, "+/robot%d/status", i);
+        snprintf(filters[filter_count++], FILTER_LEN, "site%d/+/alarm", i);
+    }
+
+    int capacity = filter_count * 4 + 1;
+    mqtt_router_node_t *nodes = calloc(capacity, sizeof(*nodes));
+    mqtt_router_t router;
+    mqtt_router_init(&router, nodes, capacity > 0xffff ? 0xffff : capacity);
+    for (int i = 0; i < filter_count; i++) {
+        if (mqtt_router_add(&router, filters[i], count_handler, NULL) !=
+            MQTT_ROUTER_OK) {
+            printf("add failed for %s\n", filters[i]);
+            return 1;
+        }
+    }
+
+    char topics[5][FILTER_LEN];
+    int r = robots / 2;
+    snprintf(topics[0], FILTER_LEN, "fleet/robot%d/cmd", r);
+    snprintf(topics[1], FILTER_LEN, "fleet/robot%d/cfg/speed", r);
+    snprintf(topics[2], FILTER_LEN, "fleet/robot%d/ota/chunk/17", r);
+    snprintf(topics[3], FILTER_LEN, "yard/robot%d/status", r);
+    snprintf(topics[4], FILTER_LEN, "unrelated/topic/here");
+    size_t lens[5];
+    for (int t = 0; t < 5; t++) {
+        lens[t] = strlen(topics[t]);
+        size_t a = mqtt_router_route(&router, topics[t], lens[t], NULL, 0);
+        size_t b = route_linear(topics[t], lens[t]);
+        if (a != b) {
+            printf("mismatch on %s: trie %zu, linear %zu\n", topics[t], a, b);
+            return 1;
+        }
+    }
+
+    printf("%d subscriptions, %u trie nodes (%zu B)\n", filter_count,
+           router.count, router.count * sizeof(mqtt_router_node_t));
+
+    double start = now_sec();
+    for (long i = 0; i < iterations; i++) {
+        int t = i % 5;
+        sink += mqtt_router_route(&router, topics[t], lens[t], NULL, 0);
+    }
+    double trie = now_sec() - start;
+
+    long linear_iterations = iterations / 100 > 0 ? iterations / 100 : 1;
+    start = now_sec();
+    for (long i = 0; i < linear_iterations; i++) {
+        int t = i % 5;
+        sink += route_linear(topics[t], lens[t]);
+    }
+    double linear = now_sec() - start;
+
+    printf("trie       %8.1f ns/message\n", trie * 1e9 / iterations);
+    printf("linear     %8.1f ns/message\n", linear * 1e9 / linear_iterations);
+    free(nodes);
+    return 0;
+}
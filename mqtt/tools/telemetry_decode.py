@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Decode telemetry payloads from the mqtt project into CSV.
+
+Reads one payload per file (or stdin) in either format written by
+telemetry_codec.c and prints one row per sample with its absolute
+timestamp. The format is detected from the first byte.
+
+    mosquitto_sub -h BROKER -t telemetry/esp32 -C 1 -N > batch.bin
+    python3 telemetry_decode.py batch.bin
+"""
+
+import argparse
+import struct
+import sys
+
+VERSION = 1
+
+
+def read_varint(data, pos):
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_packed(data):
+    version, _, count, base = struct.unpack_from("<BBHQ", data)
+    if version != VERSION:
+        raise ValueError(f"unknown version {version}")
+    pos = struct.calcsize("<BBHQ")
+    t = base
+    for _ in range(count):
+        dt, pos = read_varint(data, pos)
+        source, n = data[pos], data[pos + 1]
+        pos += 2
+        values = []
+        for _ in range(n):
+            v, pos = read_varint(data, pos)
+            values.append(unzigzag(v))
+        t += dt
+        yield t, source, values
+
+
+def read_cbor(data, pos):
+    """Minimal CBOR reader: unsigned/negative integers and arrays only."""
+    head = data[pos]
+    major, info = head >> 5, head & 0x1F
+    pos += 1
+    if info < 24:
+        arg = info
+    else:
+        size = {24: 1, 25: 2, 26: 4, 27: 8}[info]
+        arg = int.from_bytes(data[pos:pos + size], "big")
+        pos += size
+    if major == 0:
+        return arg, pos
+    if major == 1:
+        return -1 - arg, pos
+    if major == 4:
+        items = []
+        for _ in range(arg):
+            item, pos = read_cbor(data, pos)
+            items.append(item)
+        return items, pos
+    raise ValueError(f"unsupported CBOR major type {major}")
+
+
+def decode_cbor(data):
+    (version, base, samples), _ = read_cbor(data, 0)
+    if version != VERSION:
+        raise ValueError(f"unknown version {version}")
+    t = base
+    for dt, source, *values in samples:
+        t += dt
+        yield t, source, values
+
+
+def decode(data):
+    # A CBOR payload starts with a 3-element array head (0x83)
+    return decode_cbor(data) if data[0] == 0x83 else decode_packed(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("files", nargs="*",
+                        help="payload files (default stdin)")
+    args = parser.parse_args()
+
+    print("timestamp_us,source,values")
+    payloads = [open(f, "rb").read() for f in args.files] or \
+        [sys.stdin.buffer.read()]
+    for data in payloads:
+        for t, source, values in decode(data):
+            print(f"{t},{source}," + ",".join(str(v) for v in values))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+#include "i2c_bus.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "i2c bus";
+
+#define MAX_DEVICES 8
+
+struct i2c_bus {
+    i2c_bus_backend_t backend;
+    i2c_bus_config_t config;
+    TaskHandle_t task;
+
+    // Guards the queue and the stats; submissions come from any task
+    portMUX_TYPE lock;
+    i2c_bus_queue_t queue;
+    i2c_bus_stats_t stats;
+
+    i2c_bus_device_t devices[MAX_DEVICES];
+    size_t device_count;
+};
+
+static void bus_task(void *arg) {
+    i2c_bus_t *bus = arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true) {
+            portENTER_CRITICAL(&bus->lock);
+            i2c_bus_txn_t *txn = i2c_bus_queue_pop(&bus->queue);
+            portEXIT_CRITICAL(&bus->lock);
+            if (txn == NULL) {
+                break;
+            }
+
+            int64_t start = esp_timer_get_time();
+            txn->err = bus->backend.transfer(
+                bus->backend.ctx, txn->dev->handle, txn->tx, txn->tx_len,
+                txn->rx, txn->rx_len, bus->config.timeout_ms);
+            int64_t end = esp_timer_get_time();
+
+            uint32_t latency = (uint32_t)(end - txn->queued_us);
+            portENTER_CRITICAL(&bus->lock);
+            bus->stats.transactions++;
+            bus->stats.errors += txn->err != ESP_OK;
+            bus->stats.busy_us += end - start;
+            bus->stats.total_latency_us += latency;
+            if (latency > bus->stats.max_latency_us) {
+                bus->stats.max_latency_us = latency;
+            }
+            portEXIT_CRITICAL(&bus->lock);
+
+            if (txn->done != NULL) {
+                txn->done(txn);
+            }
+        }
+    }
+}
+
+esp_err_t i2c_bus_start(const i2c_bus_backend_t *backend,
+                        const i2c_bus_config_t *config, i2c_bus_t **out) {
+    i2c_bus_t *bus = calloc(1, sizeof(*bus));
+    if (bus == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bus->backend = *backend;
+    bus->config = *config;
+    bus->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    i2c_bus_queue_init(&bus->queue);
+
+    if (xTaskCreatePinnedToCore(bus_task, "i2c bus", 3072, bus,
+                                config->task_priority, &bus->task,
+                                config->task_core) != pdPASS) {
+        free(bus);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(i2c_bus_t *bus, uint16_t address,
+                             uint32_t scl_hz, i2c_bus_device_t **dev) {
+    if (bus->device_count == MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_bus_device_t *d = &bus->devices[bus->device_count];
+    esp_err_t err =
+        bus->backend.add_device(bus->backend.ctx, address, scl_hz, &d->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add device 0x%02x: %s", address,
+                 esp_err_to_name(err));
+        return err;
+    }
+    d->bus = bus;
+    d->address = address;
+    bus->device_count++;
+    *dev = d;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_submit(i2c_bus_txn_t *txn, i2c_bus_prio_t prio) {
+    i2c_bus_t *bus = txn->dev->bus;
+    txn->queued_us = esp_timer_get_time();
+    portENTER_CRITICAL(&bus->lock);
+    bool queued = i2c_bus_queue_push(&bus->queue, txn, prio);
+    if (queued) {
+        bus->stats.max_depth = bus->queue.max_depth;
+    } else {
+        bus->stats.rejected++;
+    }
+    portEXIT_CRITICAL(&bus->lock);
+    if (!queued) {
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(bus->task);
+    return ESP_OK;
+}
+
+static void wake_waiter(i2c_bus_txn_t *txn) { xSemaphoreGive(txn->arg); }
+
+esp_err_t i2c_bus_write_read(i2c_bus_device_t *dev, const uint8_t *tx,
+                             size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (xTaskGetCurrentTaskHandle() == dev->bus->task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    StaticSemaphore_t done_buf;
+    i2c_bus_txn_t txn = {
+        .dev = dev,
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .done = wake_waiter,
+        .arg = xSemaphoreCreateBinaryStatic(&done_buf),
+    };
+    esp_err_t err = i2c_bus_submit(&txn, I2C_BUS_PRIO_NORMAL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // The transfer itself times out, so this always returns
+    xSemaphoreTake(txn.arg, portMAX_DELAY);
+    return txn.err;
+}
+
+esp_err_t i2c_bus_write(i2c_bus_device_t *dev, const uint8_t *tx,
+                        size_t tx_len) {
+    return i2c_bus_write_read(dev, tx, tx_len, NULL, 0);
+}
+
+void i2c_bus_get_stats(i2c_bus_t *bus, i2c_bus_stats_t *stats) {
+    portENTER_CRITICAL(&bus->lock);
+    *stats = bus->stats;
+    portEXIT_CRITICAL(&bus->lock);
+}
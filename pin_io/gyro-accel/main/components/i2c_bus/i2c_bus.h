@@ -0,0 +1,74 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "driver/gpio.h"
+#include "driver/i2c_types.h"
+#include "freertos/FreeRTOS.h"
+#include "i2c_bus_core.h"
+
+/* A shared I2C bus owned by one scheduler task. Drivers get a device
+ * handle each and submit transactions, which the task runs one at a time
+ * (high priority first) and completes with a callback, so no driver task
+ * sits blocked while its bytes are on the wire and several sensors share
+ * the pins safely. The blocking helpers below are for setup code. */
+typedef struct {
+    UBaseType_t task_priority;
+    BaseType_t task_core;
+    int timeout_ms;  // per transaction
+} i2c_bus_config_t;
+
+#define I2C_BUS_DEFAULT_CONFIG()     \
+    {                                \
+        .task_priority = 12,         \
+        .task_core = tskNO_AFFINITY, \
+        .timeout_ms = 20,            \
+    }
+
+typedef struct {
+    i2c_port_num_t port;
+    gpio_num_t sda_io;
+    gpio_num_t scl_io;
+    bool internal_pullup;  // weak; fine at 100 kHz, marginal at 400 kHz
+} i2c_bus_master_config_t;
+
+// Backend on the i2c_master driver (IDF 5.2+), in its synchronous mode
+esp_err_t i2c_bus_master_backend(const i2c_bus_master_config_t *config,
+                                 i2c_bus_backend_t *backend);
+
+esp_err_t i2c_bus_start(const i2c_bus_backend_t *backend,
+                        const i2c_bus_config_t *config, i2c_bus_t **bus);
+
+esp_err_t i2c_bus_add_device(i2c_bus_t *bus, uint16_t address,
+                             uint32_t scl_hz, i2c_bus_device_t **dev);
+
+/* Queues a transaction and returns at once. ESP_ERR_NO_MEM when that
+ * priority's queue is full. Callable from done callbacks. */
+esp_err_t i2c_bus_submit(i2c_bus_txn_t *txn, i2c_bus_prio_t prio);
+
+/* Blocking, normal priority. Not from a done callback: the bus task would
+ * wait for itself. */
+esp_err_t i2c_bus_write_read(i2c_bus_device_t *dev, const uint8_t *tx,
+                             size_t tx_len, uint8_t *rx, size_t rx_len);
+esp_err_t i2c_bus_write(i2c_bus_device_t *dev, const uint8_t *tx,
+                        size_t tx_len);
+
+// Counters since i2c_bus_start()
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t rejected;        // queue full
+    uint32_t max_depth;       // most transactions waiting at once
+    uint32_t max_latency_us;  // submission to completion
+    uint64_t total_latency_us;
+    uint64_t busy_us;  // time spent in transfers
+} i2c_bus_stats_t;
+
+void i2c_bus_get_stats(i2c_bus_t *bus, i2c_bus_stats_t *stats);
+
+/* Transaction latency on the idle bus: reads len bytes from reg on the
+ * device at address, first blocking one at a time, then queued
+ * back-to-back, and logs the percentiles and per-transaction cost */
+void i2c_bus_bench(i2c_bus_t *bus, uint16_t address, uint32_t scl_hz,
+                   uint8_t reg, size_t len, int iterations);
+
+#endif  // I2C_BUS_H
@@ -0,0 +1,102 @@
+#include "i2c_bus.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "i2c bench";
+
+#define PIPELINE 8  // transactions in flight during the queued run
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void give_done(i2c_bus_txn_t *txn) { xSemaphoreGive(txn->arg); }
+
+/* Clock time of the transaction itself: address and register byte, then
+ * address and data, 9 bits each with the ACK, plus start, repeated start
+ * and stop */
+static float wire_us(uint32_t scl_hz, size_t len) {
+    return ((2 + 1 + len) * 9 + 3) * 1e6f / scl_hz;
+}
+
+static void bench_blocking(i2c_bus_device_t *dev, uint32_t scl_hz,
+                           uint8_t reg, size_t len, int iterations,
+                           uint32_t *latency, uint8_t *rx) {
+    int errors = 0;
+    for (int i = 0; i < iterations; i++) {
+        int64_t start = esp_timer_get_time();
+        errors += i2c_bus_write_read(dev, &reg, 1, rx, len) != ESP_OK;
+        latency[i] = (uint32_t)(esp_timer_get_time() - start);
+    }
+    qsort(latency, iterations, sizeof(*latency), compare_u32);
+    ESP_LOGI(TAG,
+             "%u-byte reads, blocking: p50 %lu us, p99 %lu us, max %lu us "
+             "(%.0f us on the wire), %d errors",
+             (unsigned)len, (unsigned long)latency[iterations / 2],
+             (unsigned long)latency[iterations * 99 / 100],
+             (unsigned long)latency[iterations - 1], wire_us(scl_hz, len),
+             errors);
+}
+
+// The bus task goes straight from one transfer to the next
+static void bench_queued(i2c_bus_device_t *dev, uint8_t reg, size_t len,
+                         int iterations, uint8_t *rx,
+                         SemaphoreHandle_t done) {
+    i2c_bus_txn_t txns[PIPELINE];
+    int errors = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i += PIPELINE) {
+        int batch = iterations - i < PIPELINE ? iterations - i : PIPELINE;
+        for (int b = 0; b < batch; b++) {
+            txns[b] = (i2c_bus_txn_t){
+                .dev = dev,
+                .tx = &reg,
+                .tx_len = 1,
+                .rx = &rx[b * len],
+                .rx_len = len,
+                .done = give_done,
+                .arg = done,
+            };
+            if (i2c_bus_submit(&txns[b], I2C_BUS_PRIO_NORMAL) != ESP_OK) {
+                txns[b].err = ESP_ERR_NO_MEM;
+                xSemaphoreGive(done);
+            }
+        }
+        for (int b = 0; b < batch; b++) {
+            xSemaphoreTake(done, portMAX_DELAY);
+        }
+        for (int b = 0; b < batch; b++) {
+            errors += txns[b].err != ESP_OK;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "%u-byte reads, %d queued: %.1f us each, %d errors",
+             (unsigned)len, PIPELINE, (float)elapsed / iterations, errors);
+}
+
+void i2c_bus_bench(i2c_bus_t *bus, uint16_t address, uint32_t scl_hz,
+                   uint8_t reg, size_t len, int iterations) {
+    i2c_bus_device_t *dev;
+    if (i2c_bus_add_device(bus, address, scl_hz, &dev) != ESP_OK) {
+        return;
+    }
+    uint32_t *latency = malloc(iterations * sizeof(*latency));
+    uint8_t *rx = malloc(len * PIPELINE);
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(PIPELINE, 0);
+    if (latency != NULL && rx != NULL && done != NULL) {
+        bench_blocking(dev, scl_hz, reg, len, iterations, latency, rx);
+        bench_queued(dev, reg, len, iterations, rx, done);
+    } else {
+        ESP_LOGE(TAG, "Out of memory");
+    }
+    free(latency);
+    free(rx);
+    if (done != NULL) {
+        vSemaphoreDelete(done);
+    }
+}
@@ -0,0 +1,40 @@
+#include "i2c_bus_core.h"
+
+#include <string.h>
+
+void i2c_bus_queue_init(i2c_bus_queue_t *q) { memset(q, 0, sizeof(*q)); }
+
+bool i2c_bus_queue_push(i2c_bus_queue_t *q, i2c_bus_txn_t *txn,
+                        i2c_bus_prio_t prio) {
+    if (q->count[prio] == I2C_BUS_QUEUE_LEN) {
+        return false;
+    }
+    q->ring[prio][(q->head[prio] + q->count[prio]) % I2C_BUS_QUEUE_LEN] =
+        txn;
+    q->count[prio]++;
+    size_t depth = i2c_bus_queue_depth(q);
+    if (depth > q->max_depth) {
+        q->max_depth = (uint8_t)depth;
+    }
+    return true;
+}
+
+i2c_bus_txn_t *i2c_bus_queue_pop(i2c_bus_queue_t *q) {
+    for (int prio = 0; prio < I2C_BUS_PRIO_COUNT; prio++) {
+        if (q->count[prio] > 0) {
+            i2c_bus_txn_t *txn = q->ring[prio][q->head[prio]];
+            q->head[prio] = (q->head[prio] + 1) % I2C_BUS_QUEUE_LEN;
+            q->count[prio]--;
+            return txn;
+        }
+    }
+    return NULL;
+}
+
+size_t i2c_bus_queue_depth(const i2c_bus_queue_t *q) {
+    size_t depth = 0;
+    for (int prio = 0; prio < I2C_BUS_PRIO_COUNT; prio++) {
+        depth += q->count[prio];
+    }
+    return depth;
+}
@@ -0,0 +1,88 @@
+#ifndef I2C_BUS_CORE_H
+#define I2C_BUS_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#else  // host builds (tools/i2c_bus_bench.c)
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+#endif
+
+/* The plain C half of the shared bus, with no FreeRTOS or driver
+ * dependencies so the host tools build it too: transactions, the backend
+ * that puts them on the wire, and the queue the scheduler task drains.
+ * The queue does no locking; i2c_bus.c wraps it in a spinlock. */
+#define I2C_BUS_QUEUE_LEN 16  // per priority
+
+typedef enum {
+    I2C_BUS_PRIO_HIGH = 0,  // streams that lose data when late
+    I2C_BUS_PRIO_NORMAL,
+    I2C_BUS_PRIO_COUNT,
+} i2c_bus_prio_t;
+
+typedef struct i2c_bus i2c_bus_t;
+typedef struct i2c_bus_txn i2c_bus_txn_t;
+
+typedef struct {
+    i2c_bus_t *bus;
+    void *handle;  // the backend's
+    uint16_t address;
+} i2c_bus_device_t;
+
+/* Runs on the bus task once the transfer is over. Must not block; may
+ * submit further transactions, including this one again. */
+typedef void (*i2c_bus_done_t)(i2c_bus_txn_t *txn);
+
+/* Writes tx, then reads rx with a repeated start; either may be empty.
+ * Caller-owned and untouched by the caller until done has run. */
+struct i2c_bus_txn {
+    i2c_bus_device_t *dev;
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+    i2c_bus_done_t done;  // optional
+    void *arg;
+
+    esp_err_t err;      // result, set before done runs
+    int64_t queued_us;  // set on submission, for the latency stats
+};
+
+// How transactions reach the wire: i2c_master on the chip, a mock on the host
+typedef struct {
+    esp_err_t (*add_device)(void *ctx, uint16_t address, uint32_t scl_hz,
+                            void **handle);
+    esp_err_t (*transfer)(void *ctx, void *handle, const uint8_t *tx,
+                          size_t tx_len, uint8_t *rx, size_t rx_len,
+                          int timeout_ms);
+    void *ctx;
+} i2c_bus_backend_t;
+
+typedef struct {
+    i2c_bus_txn_t *ring[I2C_BUS_PRIO_COUNT][I2C_BUS_QUEUE_LEN];
+    uint8_t head[I2C_BUS_PRIO_COUNT];
+    uint8_t count[I2C_BUS_PRIO_COUNT];
+    uint8_t max_depth;  // most transactions ever waiting at once
+} i2c_bus_queue_t;
+
+void i2c_bus_queue_init(i2c_bus_queue_t *q);
+
+// False when that priority's ring is full
+bool i2c_bus_queue_push(i2c_bus_queue_t *q, i2c_bus_txn_t *txn,
+                        i2c_bus_prio_t prio);
+
+// Highest priority first, in submission order within one; NULL when empty
+i2c_bus_txn_t *i2c_bus_queue_pop(i2c_bus_queue_t *q);
+
+size_t i2c_bus_queue_depth(const i2c_bus_queue_t *q);
+
+#endif  // I2C_BUS_CORE_H
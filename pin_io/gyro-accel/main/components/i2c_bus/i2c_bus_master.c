@@ -0,0 +1,56 @@
+#include "i2c_bus.h"
+
+#include "driver/i2c_master.h"
+
+/* The driver's own asynchronous mode (trans_queue_depth) cannot do a
+ * write-then-read, so it runs synchronously and the bus task provides
+ * the queueing */
+
+static esp_err_t master_add_device(void *ctx, uint16_t address,
+                                   uint32_t scl_hz, void **handle) {
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = scl_hz,
+    };
+    return i2c_master_bus_add_device((i2c_master_bus_handle_t)ctx,
+                                     &dev_config,
+                                     (i2c_master_dev_handle_t *)handle);
+}
+
+static esp_err_t master_transfer(void *ctx, void *handle, const uint8_t *tx,
+                                 size_t tx_len, uint8_t *rx, size_t rx_len,
+                                 int timeout_ms) {
+    i2c_master_dev_handle_t dev = handle;
+    if (rx_len == 0) {
+        return i2c_master_transmit(dev, tx, tx_len, timeout_ms);
+    }
+    if (tx_len == 0) {
+        return i2c_master_receive(dev, rx, rx_len, timeout_ms);
+    }
+    return i2c_master_transmit_receive(dev, tx, tx_len, rx, rx_len,
+                                       timeout_ms);
+}
+
+esp_err_t i2c_bus_master_backend(const i2c_bus_master_config_t *config,
+                                 i2c_bus_backend_t *backend) {
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = config->port,
+        .sda_io_num = config->sda_io,
+        .scl_io_num = config->scl_io,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = config->internal_pullup,
+    };
+    i2c_master_bus_handle_t handle;
+    esp_err_t err = i2c_new_master_bus(&bus_config, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *backend = (i2c_bus_backend_t){
+        .add_device = master_add_device,
+        .transfer = master_transfer,
+        .ctx = handle,
+    };
+    return ESP_OK;
+}
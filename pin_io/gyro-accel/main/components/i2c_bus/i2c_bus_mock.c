@@ -0,0 +1,82 @@
+#include "i2c_bus_mock.h"
+
+#include <string.h>
+
+void i2c_bus_mock_init(i2c_bus_mock_t *mock) { memset(mock, 0, sizeof(*mock)); }
+
+static i2c_bus_mock_dev_t *find(i2c_bus_mock_t *mock, uint16_t address) {
+    for (size_t i = 0; i < mock->device_count; i++) {
+        if (mock->devices[i].address == address) {
+            return &mock->devices[i];
+        }
+    }
+    if (mock->device_count == I2C_BUS_MOCK_MAX_DEVICES) {
+        return NULL;
+    }
+    i2c_bus_mock_dev_t *dev = &mock->devices[mock->device_count++];
+    dev->address = address;
+    return dev;
+}
+
+i2c_bus_mock_dev_t *i2c_bus_mock_add(i2c_bus_mock_t *mock, uint16_t address) {
+    i2c_bus_mock_dev_t *dev = find(mock, address);
+    if (dev != NULL) {
+        dev->present = true;
+    }
+    return dev;
+}
+
+uint32_t i2c_bus_mock_wire_ns(uint32_t scl_hz, size_t tx_len, size_t rx_len) {
+    size_t address_bytes = (tx_len > 0) + (rx_len > 0);
+    size_t bytes = tx_len + rx_len + (address_bytes > 0 ? address_bytes : 1);
+    size_t bits = bytes * 9 + 1 + (tx_len > 0 && rx_len > 0) + 1;
+    return (uint32_t)((uint64_t)bits * 1000000000u / scl_hz);
+}
+
+static esp_err_t mock_add_device(void *ctx, uint16_t address,
+                                 uint32_t scl_hz, void **handle) {
+    i2c_bus_mock_dev_t *dev = find(ctx, address);
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->scl_hz = scl_hz;
+    *handle = dev;
+    return ESP_OK;
+}
+
+static esp_err_t mock_transfer(void *ctx, void *handle, const uint8_t *tx,
+                               size_t tx_len, uint8_t *rx, size_t rx_len,
+                               int timeout_ms) {
+    (void)timeout_ms;
+    i2c_bus_mock_t *mock = ctx;
+    i2c_bus_mock_dev_t *dev = handle;
+    mock->transfers++;
+    if (!dev->present ||
+        (mock->fail_every != 0 && mock->transfers % mock->fail_every == 0)) {
+        // Only the address byte goes out
+        mock->wire_ns += i2c_bus_mock_wire_ns(dev->scl_hz, 0, 0);
+        return ESP_FAIL;
+    }
+    mock->wire_ns += i2c_bus_mock_wire_ns(dev->scl_hz, tx_len, rx_len);
+
+    if (tx_len > 0) {
+        dev->pointer = tx[0];
+        for (size_t i = 1; i < tx_len; i++) {
+            dev->regs[dev->pointer++] = tx[i];
+        }
+    }
+    for (size_t i = 0; i < rx_len; i++) {
+        uint8_t reg = dev->pointer++;
+        rx[i] = dev->read_hook != NULL ? dev->read_hook(dev, reg)
+                                       : dev->regs[reg];
+    }
+    return ESP_OK;
+}
+
+void i2c_bus_mock_backend(i2c_bus_mock_t *mock, i2c_bus_backend_t *backend) {
+    *backend = (i2c_bus_backend_t){
+        .add_device = mock_add_device,
+        .transfer = mock_transfer,
+        .ctx = mock,
+    };
+}
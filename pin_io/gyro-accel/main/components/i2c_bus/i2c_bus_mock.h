@@ -0,0 +1,49 @@
+#ifndef I2C_BUS_MOCK_H
+#define I2C_BUS_MOCK_H
+
+#include "i2c_bus_core.h"
+
+/* A backend with no wire, for host tools and tests. Each mock device is a
+ * 256-byte register file with the usual pointer protocol: the first byte
+ * written selects a register, further bytes and reads auto-increment.
+ * Registers with side effects (FIFO data ports) get a read hook. A
+ * transfer to an address with no mock device fails like a NACK, as does
+ * every fail_every-th transfer. Nothing sleeps; the time the transfers
+ * would have taken on the wire accumulates in wire_ns instead. */
+#define I2C_BUS_MOCK_MAX_DEVICES 8
+
+typedef struct i2c_bus_mock_dev i2c_bus_mock_dev_t;
+
+// Returns the byte read from reg, which the pointer has just passed
+typedef uint8_t (*i2c_bus_mock_read_t)(i2c_bus_mock_dev_t *dev, uint8_t reg);
+
+struct i2c_bus_mock_dev {
+    uint16_t address;
+    bool present;  // false: added to the bus, but nothing answers
+    uint32_t scl_hz;
+    uint8_t regs[256];
+    uint8_t pointer;
+    i2c_bus_mock_read_t read_hook;  // optional, for every read byte
+    void *arg;
+};
+
+typedef struct {
+    i2c_bus_mock_dev_t devices[I2C_BUS_MOCK_MAX_DEVICES];
+    size_t device_count;
+    uint32_t fail_every;  // 0 never
+    uint32_t transfers;
+    uint64_t wire_ns;
+} i2c_bus_mock_t;
+
+void i2c_bus_mock_init(i2c_bus_mock_t *mock);
+
+// A device that answers at address; NULL when the mock is full
+i2c_bus_mock_dev_t *i2c_bus_mock_add(i2c_bus_mock_t *mock, uint16_t address);
+
+void i2c_bus_mock_backend(i2c_bus_mock_t *mock, i2c_bus_backend_t *backend);
+
+/* Bus time of one transaction at scl_hz: 9 bits per byte including the
+ * address bytes, plus start, repeated start and stop */
+uint32_t i2c_bus_mock_wire_ns(uint32_t scl_hz, size_t tx_len, size_t rx_len);
+
+#endif  // I2C_BUS_MOCK_H
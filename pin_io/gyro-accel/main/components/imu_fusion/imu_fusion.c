@@ -0,0 +1,126 @@
+#include "imu_fusion.h"
+
+#include <math.h>
+
+void imu_fusion_init(imu_fusion_t *f, imu_fusion_algo_t algo, float dt,
+                     float gyro_scale, float accel_scale, float gain_param) {
+    f->algo = algo;
+    f->dt = dt;
+    f->gyro_scale = gyro_scale;
+    f->accel_scale = accel_scale;
+    f->gain = algo == IMU_FUSION_COMPLEMENTARY
+                  ? gain_param / (gain_param + dt)
+                  : gain_param;
+    f->roll = f->pitch = f->yaw = 0.0f;
+    f->q[0] = 1.0f;
+    f->q[1] = f->q[2] = f->q[3] = 0.0f;
+}
+
+static void complementary_update(imu_fusion_t *f, const float g[3],
+                                 const float a[3]) {
+    // Body rates stand in for Euler rates: fine for small tilts
+    f->roll += g[0] * f->dt;
+    f->pitch += g[1] * f->dt;
+    f->yaw += g[2] * f->dt;
+
+    if (a[0] == 0.0f && a[1] == 0.0f && a[2] == 0.0f) {
+        return;  // free fall or no data: gyro only
+    }
+    float accel_roll = atan2f(a[1], a[2]);
+    float accel_pitch = atan2f(-a[0], sqrtf(a[1] * a[1] + a[2] * a[2]));
+    f->roll = f->gain * f->roll + (1.0f - f->gain) * accel_roll;
+    f->pitch = f->gain * f->pitch + (1.0f - f->gain) * accel_pitch;
+}
+
+/* Madgwick's IMU (gyro + accel) update, "An efficient orientation filter
+ * for inertial and inertial/magnetic sensor arrays", 2010 */
+static void madgwick_update(imu_fusion_t *f, const float g[3],
+                            const float a[3]) {
+    float q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+
+    // Rate of change of the quaternion from the gyro
+    float dq0 = 0.5f * (-q1 * g[0] - q2 * g[1] - q3 * g[2]);
+    float dq1 = 0.5f * (q0 * g[0] + q2 * g[2] - q3 * g[1]);
+    float dq2 = 0.5f * (q0 * g[1] - q1 * g[2] + q3 * g[0]);
+    float dq3 = 0.5f * (q0 * g[2] + q1 * g[1] - q2 * g[0]);
+
+    float norm_sq = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+    if (norm_sq > 0.0f) {
+        float inv = 1.0f / sqrtf(norm_sq);
+        float ax = a[0] * inv, ay = a[1] * inv, az = a[2] * inv;
+
+        float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2;
+        float _2q3 = 2.0f * q3, _4q0 = 4.0f * q0, _4q1 = 4.0f * q1;
+        float _4q2 = 4.0f * q2, _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+        float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2;
+        float q3q3 = q3 * q3;
+
+        // Gradient of the error between measured and expected gravity
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay -
+                   _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay -
+                   _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 -
+                   _2q2 * ay;
+        float s_norm_sq = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (s_norm_sq > 0.0f) {
+            float step = f->gain / sqrtf(s_norm_sq);
+            dq0 -= step * s0;
+            dq1 -= step * s1;
+            dq2 -= step * s2;
+            dq3 -= step * s3;
+        }
+    }
+
+    q0 += dq0 * f->dt;
+    q1 += dq1 * f->dt;
+    q2 += dq2 * f->dt;
+    q3 += dq3 * f->dt;
+    float inv = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    f->q[0] = q0 * inv;
+    f->q[1] = q1 * inv;
+    f->q[2] = q2 * inv;
+    f->q[3] = q3 * inv;
+}
+
+void imu_fusion_update(imu_fusion_t *f, const float gyro[3],
+                       const float accel[3]) {
+    if (f->algo == IMU_FUSION_COMPLEMENTARY) {
+        complementary_update(f, gyro, accel);
+    } else {
+        madgwick_update(f, gyro, accel);
+    }
+}
+
+void imu_fusion_update_raw(imu_fusion_t *f, const int16_t gyro[3],
+                           const int16_t accel[3]) {
+    float g[3], a[3];
+    for (int axis = 0; axis < 3; axis++) {
+        g[axis] = gyro[axis] * f->gyro_scale;
+        a[axis] = accel[axis] * f->accel_scale;
+    }
+    imu_fusion_update(f, g, a);
+}
+
+void imu_fusion_get_euler(const imu_fusion_t *f, float *roll, float *pitch,
+                          float *yaw) {
+    if (f->algo == IMU_FUSION_COMPLEMENTARY) {
+        *roll = f->roll;
+        *pitch = f->pitch;
+        *yaw = f->yaw;
+        return;
+    }
+    float q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+    *roll = atan2f(2.0f * (q0 * q1 + q2 * q3),
+                   1.0f - 2.0f * (q1 * q1 + q2 * q2));
+    float sin_pitch = 2.0f * (q0 * q2 - q3 * q1);
+    if (sin_pitch > 1.0f) {
+        sin_pitch = 1.0f;
+    } else if (sin_pitch < -1.0f) {
+        sin_pitch = -1.0f;
+    }
+    *pitch = asinf(sin_pitch);
+    *yaw = atan2f(2.0f * (q0 * q3 + q1 * q2),
+                  1.0f - 2.0f * (q2 * q2 + q3 * q3));
+}
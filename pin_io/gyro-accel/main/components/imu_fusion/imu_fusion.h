@@ -0,0 +1,51 @@
+#ifndef IMU_FUSION_H
+#define IMU_FUSION_H
+
+#include <stdint.h>
+
+/* Orientation from gyro and accelerometer samples, one update per sample.
+ *
+ * COMPLEMENTARY integrates the gyro into roll and pitch and pulls them
+ * towards the accelerometer's tilt with a time constant; the cheapest
+ * option, fine for a balancing robot that stays well away from ±90°
+ * pitch. MADGWICK keeps a quaternion and corrects it with one gradient
+ * descent step per sample; a few times the cost, but valid at any
+ * attitude. Neither can observe yaw, which only integrates the gyro.
+ *
+ * Single precision throughout (the ESP32 FPU has no double support).
+ * Plain C with no ESP-IDF dependencies so it also builds on the host. */
+typedef enum {
+    IMU_FUSION_COMPLEMENTARY = 0,
+    IMU_FUSION_MADGWICK,
+} imu_fusion_algo_t;
+
+typedef struct {
+    imu_fusion_algo_t algo;
+    float dt;           // seconds between samples
+    float gyro_scale;   // rad/s per raw LSB
+    float accel_scale;  // any unit per raw LSB; only the direction is used
+    float gain;         // complementary: alpha; Madgwick: beta
+
+    float roll, pitch, yaw;  // complementary state, radians
+    float q[4];              // Madgwick state, w x y z
+} imu_fusion_t;
+
+/* time_constant_s (complementary) is how long the accelerometer takes to
+ * pull out a gyro error; beta (Madgwick) is the gyro error it corrects
+ * for, in rad/s. Raw updates use the scale factors. */
+void imu_fusion_init(imu_fusion_t *f, imu_fusion_algo_t algo, float dt,
+                     float gyro_scale, float accel_scale, float gain_param);
+
+// gyro in rad/s; accel in any unit
+void imu_fusion_update(imu_fusion_t *f, const float gyro[3],
+                       const float accel[3]);
+
+// Raw sensor counts, scaled by the factors given to imu_fusion_init()
+void imu_fusion_update_raw(imu_fusion_t *f, const int16_t gyro[3],
+                           const int16_t accel[3]);
+
+// Radians; roll about x, pitch about y, yaw about z
+void imu_fusion_get_euler(const imu_fusion_t *f, float *roll, float *pitch,
+                          float *yaw);
+
+#endif  // IMU_FUSION_H
@@ -0,0 +1,402 @@
+#include "mpu6050.h"
+
+#include <stdatomic.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+static const char *TAG = "MPU6050";
+
+#define MPU6050_SMPLRT_DIV 0x19
+#define MPU6050_CONFIG 0x1A
+#define MPU6050_GYRO_CONFIG 0x1B
+#define MPU6050_ACCEL_CONFIG 0x1C
+#define MPU6050_FIFO_EN 0x23
+#define MPU6050_INT_PIN_CFG 0x37
+#define MPU6050_INT_ENABLE 0x38
+#define MPU6050_USER_CTRL 0x6A
+#define MPU6050_PWR_MGMT_1 0x6B
+#define MPU6050_FIFO_COUNT_H 0x72
+#define MPU6050_FIFO_R_W 0x74
+#define MPU6050_WHO_AM_I 0x75
+
+#define FIFO_EN_TEMP_GYRO_ACCEL 0xF8
+#define USER_CTRL_FIFO_EN 0x40
+#define USER_CTRL_FIFO_RESET 0x04
+#define INT_ENABLE_DATA_RDY 0x01
+#define PWR_MGMT_1_RESET 0x80
+#define PWR_MGMT_1_CLK_PLL_XGYRO 0x01
+
+#define SAMPLE_BYTES 14
+// Without a single interrupt for this long the sensor or its INT wire is gone
+#define STALL_TIMEOUT_MS 500
+
+static mpu6050_config_t s_config;
+static i2c_bus_device_t *s_dev;
+static TaskHandle_t s_reader;
+
+/* The double buffer: blocks travel free -> reader -> full -> consumer ->
+ * free, so each is owned by exactly one side at a time */
+static mpu6050_block_t s_blocks[2];
+static QueueHandle_t s_free_blocks;
+static QueueHandle_t s_full_blocks;
+static uint8_t s_burst[MPU6050_BLOCK_MAX * SAMPLE_BYTES];
+
+/* A drain is a chain of transactions completed on the bus task: the FIFO
+ * count, one burst per block, and a FIFO reset if anything went wrong.
+ * The reader starts one chain at a time; the last link clears s_draining
+ * so the transactions below are never queued twice. */
+static atomic_bool s_draining;
+static i2c_bus_txn_t s_count_txn;
+static i2c_bus_txn_t s_burst_txn;
+static i2c_bus_txn_t s_reset_txn[2];
+static atomic_uint s_reset_links;  // of s_reset_txn, not yet completed
+static uint8_t s_count_buf[2];
+static uint16_t s_pending;  // samples left to read in this drain
+static uint16_t s_filled;   // samples in s_burst, not yet delivered
+static int64_t s_drain_us;  // when the count was read
+
+static atomic_uint s_irq_count;  // data-ready pulses, one per sample
+static uint32_t s_read_count;    // samples taken out of the FIFO
+static atomic_uint s_samples;
+static atomic_uint s_dropped;
+static atomic_uint s_overflows;
+static atomic_uint s_i2c_errors;
+
+// Written by the calibration, read by the reader once per block
+static mpu6050_offsets_t s_offsets;
+static portMUX_TYPE s_offsets_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Blocking, for setup only
+static esp_err_t write_byte(uint8_t reg, uint8_t data) {
+    return i2c_bus_write(s_dev, (uint8_t[]){reg, data}, 2);
+}
+
+static esp_err_t read_bytes(uint8_t reg, uint8_t *buf, size_t len) {
+    return i2c_bus_write_read(s_dev, &reg, 1, buf, len);
+}
+
+static int16_t read_word(const uint8_t *data, int idx) {
+    return (int16_t)((data[idx] << 8) | data[idx + 1]);
+}
+
+static void IRAM_ATTR int_isr(void *arg) {
+    uint32_t count =
+        atomic_fetch_add_explicit(&s_irq_count, 1, memory_order_relaxed) + 1;
+    if (count % s_config.block_samples == 0) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_reader, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+static void drain_done(void) { atomic_store(&s_draining, false); }
+
+// Whichever reset transaction completes last ends the chain
+static void reset_done(i2c_bus_txn_t *txn) {
+    if (atomic_fetch_sub(&s_reset_links, 1) == 1) {
+        drain_done();
+    }
+}
+
+/* Ends the chain. Everything still in the FIFO is lost; counts the
+ * samples the sensor produced that were never read, so the loss shows in
+ * the stats. */
+static void fifo_reset(void) {
+    uint32_t produced = atomic_load(&s_irq_count);
+    if ((int32_t)(produced - s_read_count) > 0) {
+        atomic_fetch_add(&s_dropped, produced - s_read_count);
+    }
+    s_read_count = produced;
+    atomic_fetch_add(&s_dropped, s_filled);  // read, never delivered
+    s_filled = 0;
+    atomic_fetch_add(&s_overflows, 1);
+    atomic_store(&s_reset_links, 2);
+    if (i2c_bus_submit(&s_reset_txn[0], I2C_BUS_PRIO_HIGH) != ESP_OK) {
+        drain_done();  // the next drain sees the overflow and tries again
+    } else if (i2c_bus_submit(&s_reset_txn[1], I2C_BUS_PRIO_HIGH) != ESP_OK) {
+        reset_done(NULL);  // the first is still queued, and ends the chain
+    }
+}
+
+// The FIFO position is unknown after a failed transfer
+static void drain_failed(void) {
+    atomic_fetch_add(&s_i2c_errors, 1);
+    fifo_reset();
+}
+
+static int16_t corrected(int32_t value, int16_t offset) {
+    value -= offset;
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+static void decode(const uint8_t *raw, const mpu6050_offsets_t *offsets,
+                   mpu6050_raw_t *sample) {
+    for (int axis = 0; axis < 3; axis++) {
+        sample->accel[axis] =
+            corrected(read_word(raw, axis * 2), offsets->accel[axis]);
+        sample->gyro[axis] =
+            corrected(read_word(raw, 8 + axis * 2), offsets->gyro[axis]);
+    }
+    sample->temp = read_word(raw, 6);
+}
+
+// Hands n samples from the burst to the next free block, or drops them
+static void deliver(uint16_t n, int64_t last_us) {
+    mpu6050_block_t *block;
+    if (xQueueReceive(s_free_blocks, &block, 0) != pdTRUE) {
+        atomic_fetch_add(&s_dropped, n);  // consumer holds both blocks
+        return;
+    }
+    mpu6050_offsets_t offsets;
+    mpu6050_get_offsets(&offsets);
+    for (int i = 0; i < n; i++) {
+        decode(&s_burst[i * SAMPLE_BYTES], &offsets, &block->samples[i]);
+    }
+    block->count = n;
+    block->last_us = last_us;
+    xQueueSend(s_full_blocks, &block, 0);
+    atomic_fetch_add(&s_samples, n);
+}
+
+// Appends up to MPU6050_BURST_MAX samples to the block being filled
+static void next_burst(i2c_bus_prio_t prio) {
+    if (s_pending == 0) {
+        drain_done();
+        return;
+    }
+    uint16_t n = MPU6050_BLOCK_MAX - s_filled;
+    if (n > MPU6050_BURST_MAX) {
+        n = MPU6050_BURST_MAX;
+    }
+    if (n > s_pending) {
+        n = s_pending;
+    }
+    s_burst_txn.rx = &s_burst[s_filled * SAMPLE_BYTES];
+    s_burst_txn.rx_len = n * SAMPLE_BYTES;
+    if (i2c_bus_submit(&s_burst_txn, prio) != ESP_OK) {
+        drain_failed();
+    }
+}
+
+static void burst_done(i2c_bus_txn_t *txn) {
+    if (txn->err != ESP_OK) {
+        drain_failed();
+        return;
+    }
+    uint16_t n = txn->rx_len / SAMPLE_BYTES;
+    s_pending -= n;
+    s_read_count += n;
+    s_filled += n;
+    if (s_filled == MPU6050_BLOCK_MAX || s_pending == 0) {
+        uint32_t period_us = 1000000 / s_config.sample_rate_hz;
+        deliver(s_filled, s_drain_us - (int64_t)s_pending * period_us);
+        s_filled = 0;
+    }
+    next_burst(I2C_BUS_PRIO_NORMAL);
+}
+
+static void count_done(i2c_bus_txn_t *txn) {
+    if (txn->err != ESP_OK) {
+        atomic_fetch_add(&s_i2c_errors, 1);
+        drain_done();  // nothing read yet, the FIFO is intact
+        return;
+    }
+    s_drain_us = esp_timer_get_time();
+    uint16_t bytes = (uint16_t)((s_count_buf[0] << 8) | s_count_buf[1]);
+
+    // A full FIFO has overwritten samples, and may be misaligned
+    if (bytes > MPU6050_FIFO_SIZE - SAMPLE_BYTES || bytes % SAMPLE_BYTES) {
+        ESP_LOGW(TAG, "FIFO overflow (%u bytes), resetting", bytes);
+        fifo_reset();
+        return;
+    }
+    s_pending = bytes / SAMPLE_BYTES;
+    next_burst(I2C_BUS_PRIO_HIGH);
+}
+
+static void reader_task(void *arg) {
+    while (true) {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STALL_TIMEOUT_MS)) == 0) {
+            ESP_LOGW(TAG, "No data-ready interrupts, check the INT wire");
+        }
+        // A drain still running picks these samples up next time
+        bool idle = false;
+        if (atomic_compare_exchange_strong(&s_draining, &idle, true) &&
+            i2c_bus_submit(&s_count_txn, I2C_BUS_PRIO_HIGH) != ESP_OK) {
+            drain_done();
+        }
+    }
+}
+
+static void txns_init(void) {
+    static const uint8_t count_reg = MPU6050_FIFO_COUNT_H;
+    static const uint8_t fifo_reg = MPU6050_FIFO_R_W;
+    static const uint8_t reset_cmds[2][2] = {
+        {MPU6050_USER_CTRL, USER_CTRL_FIFO_RESET},
+        {MPU6050_USER_CTRL, USER_CTRL_FIFO_EN},
+    };
+    s_count_txn = (i2c_bus_txn_t){
+        .dev = s_dev,
+        .tx = &count_reg,
+        .tx_len = 1,
+        .rx = s_count_buf,
+        .rx_len = sizeof(s_count_buf),
+        .done = count_done,
+    };
+    s_burst_txn = (i2c_bus_txn_t){
+        .dev = s_dev,
+        .tx = &fifo_reg,
+        .tx_len = 1,
+        .rx = s_burst,
+        .done = burst_done,
+    };
+    for (int i = 0; i < 2; i++) {
+        s_reset_txn[i] = (i2c_bus_txn_t){
+            .dev = s_dev,
+            .tx = reset_cmds[i],
+            .tx_len = 2,
+            .done = reset_done,
+        };
+    }
+}
+
+static esp_err_t sensor_init(void) {
+    uint8_t who_am_i = 0;
+    esp_err_t err = write_byte(MPU6050_PWR_MGMT_1, PWR_MGMT_1_RESET);
+    if (err != ESP_OK) {
+        return err;
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    err = read_bytes(MPU6050_WHO_AM_I, &who_am_i, 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if ((who_am_i & 0x7E) != MPU6050_I2C_ADDR) {
+        ESP_LOGE(TAG, "Unexpected WHO_AM_I 0x%02x", who_am_i);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // The gyro output rate is 1 kHz with the DLPF on
+    const uint8_t init[][2] = {
+        {MPU6050_PWR_MGMT_1, PWR_MGMT_1_CLK_PLL_XGYRO},
+        {MPU6050_SMPLRT_DIV, 1000 / s_config.sample_rate_hz - 1},
+        {MPU6050_CONFIG, s_config.dlpf},
+        {MPU6050_GYRO_CONFIG, MPU6050_GYRO_FS_REG},
+        {MPU6050_ACCEL_CONFIG, MPU6050_ACCEL_FS_REG},
+        {MPU6050_INT_PIN_CFG, 0x00},  // active high, 50 us pulse
+        {MPU6050_FIFO_EN, FIFO_EN_TEMP_GYRO_ACCEL},
+        {MPU6050_USER_CTRL, USER_CTRL_FIFO_RESET},
+        {MPU6050_USER_CTRL, USER_CTRL_FIFO_EN},
+        {MPU6050_INT_ENABLE, INT_ENABLE_DATA_RDY},
+    };
+    for (size_t i = 0; i < sizeof(init) / sizeof(init[0]) && err == ESP_OK;
+         i++) {
+        err = write_byte(init[i][0], init[i][1]);
+    }
+    return err;
+}
+
+static esp_err_t int_init(void) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << s_config.int_io,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    return gpio_isr_handler_add(s_config.int_io, int_isr, NULL);
+}
+
+esp_err_t mpu6050_start(const mpu6050_config_t *config) {
+    if (config->bus == NULL || config->sample_rate_hz < 4 ||
+        config->sample_rate_hz > 1000 ||
+        config->block_samples == 0 ||
+        config->block_samples > MPU6050_BLOCK_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+
+    s_free_blocks = xQueueCreate(2, sizeof(mpu6050_block_t *));
+    s_full_blocks = xQueueCreate(2, sizeof(mpu6050_block_t *));
+    if (s_free_blocks == NULL || s_full_blocks == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < 2; i++) {
+        mpu6050_block_t *block = &s_blocks[i];
+        xQueueSend(s_free_blocks, &block, 0);
+    }
+
+    esp_err_t err = i2c_bus_add_device(s_config.bus, MPU6050_I2C_ADDR,
+                                       s_config.i2c_hz, &s_dev);
+    if (err != ESP_OK) {
+        return err;
+    }
+    txns_init();
+    err = sensor_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sensor init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (xTaskCreatePinnedToCore(reader_task, "mpu6050", 3072, NULL,
+                                s_config.task_priority, &s_reader,
+                                s_config.task_core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = int_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "INT pin setup failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Sampling at %u Hz, %u samples per block, %u per burst",
+             s_config.sample_rate_hz, s_config.block_samples,
+             MPU6050_BURST_MAX);
+    return ESP_OK;
+}
+
+mpu6050_block_t *mpu6050_get_block(TickType_t timeout) {
+    mpu6050_block_t *block;
+    return xQueueReceive(s_full_blocks, &block, timeout) == pdTRUE ? block
+                                                                   : NULL;
+}
+
+void mpu6050_release_block(mpu6050_block_t *block) {
+    xQueueSend(s_free_blocks, &block, 0);
+}
+
+void mpu6050_get_stats(mpu6050_stats_t *stats) {
+    stats->samples = atomic_load(&s_samples);
+    stats->dropped = atomic_load(&s_dropped);
+    stats->overflows = atomic_load(&s_overflows);
+    stats->i2c_errors = atomic_load(&s_i2c_errors);
+}
+
+void mpu6050_set_offsets(const mpu6050_offsets_t *offsets) {
+    portENTER_CRITICAL(&s_offsets_lock);
+    s_offsets = *offsets;
+    portEXIT_CRITICAL(&s_offsets_lock);
+}
+
+void mpu6050_get_offsets(mpu6050_offsets_t *offsets) {
+    portENTER_CRITICAL(&s_offsets_lock);
+    *offsets = s_offsets;
+    portEXIT_CRITICAL(&s_offsets_lock);
+}
@@ -0,0 +1,140 @@
+#ifndef MPU6050_H
+#define MPU6050_H
+
+#include <stdint.h>
+
+#include "components/i2c_bus/i2c_bus.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* FIFO mode: the sensor queues accel, temperature and gyro samples in its
+ * 1 KB FIFO and pulses INT on every sample. The ISR only counts; every
+ * block_samples pulses it wakes the reader task, which queues a FIFO
+ * drain on the shared bus: the count, then bursts of up to
+ * MPU6050_BURST_MAX samples, chained through completion callbacks so the
+ * reader never waits on the wire. The count and the first burst go at
+ * high priority; later bursts queue at normal priority, so the other
+ * devices get the bus between them instead of waiting out the drain. Two
+ * blocks alternate between the reader and the consumer, so processing
+ * never stalls sampling: if the consumer still holds both, the block is
+ * counted as dropped instead. */
+#define MPU6050_BLOCK_MAX 32  // samples per block
+#define MPU6050_BURST_MAX 2   // samples per transfer, 0.7 ms at 400 kHz
+#define MPU6050_FIFO_SIZE 1024
+#define MPU6050_I2C_ADDR 0x68
+
+/* Full-scale ranges are fixed at build time (menuconfig, MPU6050), so the
+ * scale factors below are constants the compiler folds into each use */
+#if CONFIG_MPU6050_ACCEL_RANGE_2G
+#define MPU6050_ACCEL_FS_REG 0x00
+#define MPU6050_ACCEL_LSB_PER_G 16384
+#elif CONFIG_MPU6050_ACCEL_RANGE_4G
+#define MPU6050_ACCEL_FS_REG 0x08
+#define MPU6050_ACCEL_LSB_PER_G 8192
+#elif CONFIG_MPU6050_ACCEL_RANGE_16G
+#define MPU6050_ACCEL_FS_REG 0x18
+#define MPU6050_ACCEL_LSB_PER_G 2048
+#else  // ±8 g
+#define MPU6050_ACCEL_FS_REG 0x10
+#define MPU6050_ACCEL_LSB_PER_G 4096
+#endif
+
+#if CONFIG_MPU6050_GYRO_RANGE_250DPS
+#define MPU6050_GYRO_FS_REG 0x00
+#define MPU6050_GYRO_LSB_PER_DPS 131.0f
+#elif CONFIG_MPU6050_GYRO_RANGE_1000DPS
+#define MPU6050_GYRO_FS_REG 0x10
+#define MPU6050_GYRO_LSB_PER_DPS 32.8f
+#elif CONFIG_MPU6050_GYRO_RANGE_2000DPS
+#define MPU6050_GYRO_FS_REG 0x18
+#define MPU6050_GYRO_LSB_PER_DPS 16.4f
+#else  // ±500 °/s
+#define MPU6050_GYRO_FS_REG 0x08
+#define MPU6050_GYRO_LSB_PER_DPS 65.5f
+#endif
+
+#define MPU6050_ACCEL_SCALE (9.81f / MPU6050_ACCEL_LSB_PER_G)  // m/s² per LSB
+#define MPU6050_GYRO_SCALE \
+    ((3.1415926f / 180.0f) / MPU6050_GYRO_LSB_PER_DPS)  // rad/s per LSB
+#define MPU6050_TEMP_C(raw) ((raw) / 340.0f + 36.53f)
+
+// Raw register values, in the order the FIFO holds them
+typedef struct {
+    int16_t accel[3];
+    int16_t temp;      // degrees C = temp / 340 + 36.53
+    int16_t gyro[3];
+} mpu6050_raw_t;
+
+typedef struct {
+    int64_t last_us;  // approximate time of the newest sample
+    uint16_t count;
+    mpu6050_raw_t samples[MPU6050_BLOCK_MAX];
+} mpu6050_block_t;
+
+// Register values for CONFIG
+typedef enum {
+    MPU6050_DLPF_184HZ = 1,
+    MPU6050_DLPF_94HZ = 2,
+    MPU6050_DLPF_44HZ = 3,
+    MPU6050_DLPF_21HZ = 4,
+    MPU6050_DLPF_10HZ = 5,
+    MPU6050_DLPF_5HZ = 6,
+} mpu6050_dlpf_t;
+
+typedef struct {
+    i2c_bus_t *bus;  // shared; the sensor adds itself as a device
+    uint32_t i2c_hz;
+    gpio_num_t int_io;
+
+    uint16_t sample_rate_hz;  // 4..1000; the gyro runs at 1 kHz with DLPF on
+    uint8_t block_samples;    // samples per drain, <= MPU6050_BLOCK_MAX
+    mpu6050_dlpf_t dlpf;
+
+    UBaseType_t task_priority;
+    BaseType_t task_core;
+} mpu6050_config_t;
+
+#define MPU6050_DEFAULT_CONFIG()              \
+    {                                         \
+        .bus = NULL,                          \
+        .i2c_hz = 400000,                     \
+        .int_io = GPIO_NUM_27,                \
+        .sample_rate_hz = 1000,               \
+        .block_samples = 10,                  \
+        .dlpf = MPU6050_DLPF_21HZ,            \
+        .task_priority = 10,                  \
+        .task_core = tskNO_AFFINITY,          \
+    }
+
+/* Raw biases subtracted from every sample before it reaches a block; see
+ * mpu6050_cal.h for measuring them */
+typedef struct {
+    int16_t accel[3];
+    int16_t gyro[3];
+} mpu6050_offsets_t;
+
+// Counters since mpu6050_start()
+typedef struct {
+    uint32_t samples;    // delivered in blocks
+    uint32_t dropped;    // never delivered: FIFO overflow or blocks busy
+    uint32_t overflows;  // FIFO resets
+    uint32_t i2c_errors;
+} mpu6050_stats_t;
+
+/* Sets up the sensor and the INT pin on config->bus, and starts sampling.
+ * The configuration is copied. */
+esp_err_t mpu6050_start(const mpu6050_config_t *config);
+
+/* Waits for the next full block. The block belongs to the caller until
+ * mpu6050_release_block(); holding it too long drops samples. */
+mpu6050_block_t *mpu6050_get_block(TickType_t timeout);
+void mpu6050_release_block(mpu6050_block_t *block);
+
+void mpu6050_get_stats(mpu6050_stats_t *stats);
+
+// Applies from the next burst on; all zero until set
+void mpu6050_set_offsets(const mpu6050_offsets_t *offsets);
+void mpu6050_get_offsets(mpu6050_offsets_t *offsets);
+
+#endif  // MPU6050_H
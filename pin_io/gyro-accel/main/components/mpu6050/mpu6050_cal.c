@@ -0,0 +1,225 @@
+#include "mpu6050_cal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "MPU6050 cal";
+
+#define NAMESPACE "mpu6050"
+#define KEY "cal"
+#define BLOCK_TIMEOUT_MS 1000
+
+// Channels in mpu6050_raw_t order
+#define CHANNELS 7
+#define TEMP_CHANNEL 3
+#define GYRO_CHANNEL 4
+
+/* The ranges tie the raw offsets to the scale they were measured at; a
+ * different build's offsets are not reused */
+typedef struct {
+    uint8_t accel_fs;
+    uint8_t gyro_fs;
+    int16_t temp;  // raw mean over the window
+    mpu6050_offsets_t offsets;
+} stored_cal_t;
+
+typedef struct {
+    int64_t n;
+    int64_t sum[CHANNELS];
+    int64_t sum_sq[CHANNELS];
+} window_t;
+
+static int16_t channel(const mpu6050_raw_t *sample, int c) {
+    if (c < TEMP_CHANNEL) {
+        return sample->accel[c];
+    }
+    return c == TEMP_CHANNEL ? sample->temp : sample->gyro[c - GYRO_CHANNEL];
+}
+
+// Rounded to the nearest count
+static int16_t mean(const window_t *w, int c) {
+    int64_t half = w->sum[c] >= 0 ? w->n / 2 : -w->n / 2;
+    return (int16_t)((w->sum[c] + half) / w->n);
+}
+
+/* Whether the standard deviation exceeds limit (raw counts). Compares
+ * n² times the variance, so it stays exact in integers. */
+static bool spread_above(const window_t *w, int c, int32_t limit) {
+    int64_t n2_var = w->n * w->sum_sq[c] - w->sum[c] * w->sum[c];
+    return n2_var > (int64_t)limit * limit * w->n * w->n;
+}
+
+static bool load_stored(stored_cal_t *stored) {
+    nvs_handle_t nvs;
+    if (nvs_open(NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*stored);
+    esp_err_t err = nvs_get_blob(nvs, KEY, stored, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*stored) &&
+           stored->accel_fs == MPU6050_ACCEL_FS_REG &&
+           stored->gyro_fs == MPU6050_GYRO_FS_REG;
+}
+
+static void save_stored(const stored_cal_t *cal) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, KEY, cal, sizeof(*cal));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store the offsets: %s",
+                 esp_err_to_name(err));
+    }
+}
+
+static esp_err_t measure(uint16_t samples, window_t *w) {
+    memset(w, 0, sizeof(*w));
+    while (w->n < samples) {
+        mpu6050_block_t *block =
+            mpu6050_get_block(pdMS_TO_TICKS(BLOCK_TIMEOUT_MS));
+        if (block == NULL) {
+            return ESP_ERR_TIMEOUT;
+        }
+        for (uint16_t i = 0; i < block->count; i++) {
+            for (int c = 0; c < CHANNELS; c++) {
+                int32_t value = channel(&block->samples[i], c);
+                w->sum[c] += value;
+                w->sum_sq[c] += value * value;
+            }
+        }
+        w->n += block->count;
+        mpu6050_release_block(block);
+    }
+    return ESP_OK;
+}
+
+static bool moved(const mpu6050_cal_config_t *config, const window_t *w) {
+    int32_t gyro_limit = lroundf(config->gyro_noise_mdps *
+                                 MPU6050_GYRO_LSB_PER_DPS / 1000.0f);
+    int32_t accel_limit =
+        config->accel_noise_mg * MPU6050_ACCEL_LSB_PER_G / 1000;
+    for (int axis = 0; axis < 3; axis++) {
+        if (spread_above(w, GYRO_CHANNEL + axis, gyro_limit) ||
+            spread_above(w, axis, accel_limit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Gravity stays on the axis closest to vertical, with its sign
+static void accel_offsets(const window_t *w, int16_t offsets[3]) {
+    int vertical = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        offsets[axis] = mean(w, axis);
+        if (abs(offsets[axis]) > abs(offsets[vertical])) {
+            vertical = axis;
+        }
+    }
+    offsets[vertical] -= offsets[vertical] >= 0 ? MPU6050_ACCEL_LSB_PER_G
+                                                : -MPU6050_ACCEL_LSB_PER_G;
+}
+
+static void log_offsets(const char *what, const stored_cal_t *cal) {
+    const mpu6050_offsets_t *o = &cal->offsets;
+    ESP_LOGI(TAG, "%s gyro offsets %d %d %d, accel %d %d %d, at %.1f °C",
+             what, o->gyro[0], o->gyro[1], o->gyro[2], o->accel[0],
+             o->accel[1], o->accel[2], MPU6050_TEMP_C(cal->temp));
+}
+
+esp_err_t mpu6050_calibrate(const mpu6050_cal_config_t *config,
+                            mpu6050_cal_result_t *result) {
+    stored_cal_t stored;
+    bool have_stored = load_stored(&stored);
+    window_t w;
+
+    // One block is enough to tell the temperature
+    if (have_stored && !config->force) {
+        esp_err_t err = measure(1, &w);
+        if (err != ESP_OK) {
+            return err;
+        }
+        float drift = (mean(&w, TEMP_CHANNEL) - stored.temp) / 340.0f;
+        if (fabsf(drift) <= config->max_temp_drift_c) {
+            mpu6050_set_offsets(&stored.offsets);
+            log_offsets("Stored", &stored);
+            *result = MPU6050_CAL_LOADED;
+            return ESP_OK;
+        }
+        ESP_LOGI(TAG, "%.1f °C from the stored calibration, recalibrating",
+                 drift);
+    }
+
+    // Blocks already queued may carry earlier offsets
+    const mpu6050_offsets_t none = {0};
+    mpu6050_set_offsets(&none);
+    mpu6050_block_t *queued;
+    while ((queued = mpu6050_get_block(0)) != NULL) {
+        mpu6050_release_block(queued);
+    }
+
+    ESP_LOGI(TAG, "Calibrating over %u samples, keep still",
+             config->samples);
+    for (int attempt = 1; attempt <= config->attempts; attempt++) {
+        esp_err_t err = measure(config->samples, &w);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (moved(config, &w)) {
+            ESP_LOGW(TAG, "Moved during calibration (attempt %d of %u)",
+                     attempt, config->attempts);
+            continue;
+        }
+
+        stored_cal_t fresh = {
+            .accel_fs = MPU6050_ACCEL_FS_REG,
+            .gyro_fs = MPU6050_GYRO_FS_REG,
+            .temp = mean(&w, TEMP_CHANNEL),
+        };
+        for (int axis = 0; axis < 3; axis++) {
+            fresh.offsets.gyro[axis] = mean(&w, GYRO_CHANNEL + axis);
+        }
+        if (config->accel) {
+            accel_offsets(&w, fresh.offsets.accel);
+        }
+        mpu6050_set_offsets(&fresh.offsets);
+        save_stored(&fresh);
+        log_offsets("Measured", &fresh);
+        *result = MPU6050_CAL_MEASURED;
+        return ESP_OK;
+    }
+
+    if (have_stored) {
+        mpu6050_set_offsets(&stored.offsets);
+        log_offsets("Kept moving, using the stored", &stored);
+        *result = MPU6050_CAL_STALE;
+    } else {
+        ESP_LOGW(TAG, "Kept moving, running uncalibrated");
+        *result = MPU6050_CAL_NONE;
+    }
+    return ESP_OK;
+}
+
+const char *mpu6050_cal_result_name(mpu6050_cal_result_t result) {
+    switch (result) {
+        case MPU6050_CAL_LOADED:
+            return "loaded";
+        case MPU6050_CAL_MEASURED:
+            return "measured";
+        case MPU6050_CAL_STALE:
+            return "stale";
+        case MPU6050_CAL_NONE:
+            return "none";
+    }
+    return "?";
+}
@@ -0,0 +1,61 @@
+#ifndef MPU6050_CAL_H
+#define MPU6050_CAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "mpu6050.h"
+
+/* Bias calibration at startup. Averages a window of samples from the
+ * running stream while the board rests, rejects the window if the gyro or
+ * accelerometer spread shows it moved, and keeps the result in NVS with
+ * the die temperature it was taken at. Later boots reload the stored
+ * offsets after a single block, unless the temperature has drifted or
+ * the full-scale ranges changed since.
+ *
+ * The accelerometer offsets assume the board rests level on one face:
+ * the axis closest to vertical keeps exactly 1 g. */
+typedef struct {
+    uint16_t samples;          // window length
+    uint16_t gyro_noise_mdps;  // motion: gyro standard deviation above this
+    uint16_t accel_noise_mg;   // motion: accel standard deviation above this
+    uint8_t max_temp_drift_c;  // recalibrate beyond this from the stored one
+    uint8_t attempts;          // windows to try before giving up
+    bool accel;                // also calibrate the accelerometer
+    bool force;                // ignore the stored offsets
+} mpu6050_cal_config_t;
+
+#if CONFIG_MPU6050_CAL_ACCEL
+#define MPU6050_CAL_ACCEL_ENABLED true
+#else
+#define MPU6050_CAL_ACCEL_ENABLED false
+#endif
+
+#define MPU6050_CAL_DEFAULT_CONFIG()                             \
+    {                                                            \
+        .samples = CONFIG_MPU6050_CAL_SAMPLES,                   \
+        .gyro_noise_mdps = CONFIG_MPU6050_CAL_GYRO_NOISE_MDPS,   \
+        .accel_noise_mg = CONFIG_MPU6050_CAL_ACCEL_NOISE_MG,     \
+        .max_temp_drift_c = CONFIG_MPU6050_CAL_MAX_TEMP_DRIFT_C, \
+        .attempts = 3,                                           \
+        .accel = MPU6050_CAL_ACCEL_ENABLED,                      \
+        .force = false,                                          \
+    }
+
+typedef enum {
+    MPU6050_CAL_LOADED,    // stored offsets, temperature within range
+    MPU6050_CAL_MEASURED,  // fresh window, stored for the next boot
+    MPU6050_CAL_STALE,     // every window moved; stored offsets kept anyway
+    MPU6050_CAL_NONE,      // every window moved and nothing stored
+} mpu6050_cal_result_t;
+
+/* Call after mpu6050_start() and before consuming blocks; takes blocks
+ * from the stream itself and sets the offsets it settles on. Needs
+ * nvs_flash_init() first. Errors only for a stalled stream. */
+esp_err_t mpu6050_calibrate(const mpu6050_cal_config_t *config,
+                            mpu6050_cal_result_t *result);
+
+const char *mpu6050_cal_result_name(mpu6050_cal_result_t result);
+
+#endif  // MPU6050_CAL_H
@@ -1,95 +1,219 @@
 #include <stdio.h>
 
-#include "driver/i2c.h"
+#include "components/i2c_bus/i2c_bus.h"
+#include "components/imu_fusion/imu_fusion.h"
+#include "components/mpu6050/mpu6050.h"
+#include "components/mpu6050/mpu6050_cal.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "nvs_flash.h"
+#include "sensor_log.h"
 
 #define TAG "MPU6050"
 
 #define I2C_MASTER_SCL_IO 25
 #define I2C_MASTER_SDA_IO 26
+#define MPU6050_INT_IO 27  // wired to the sensor's INT pin
 #define I2C_MASTER_NUM I2C_NUM_0
 #define I2C_MASTER_FREQ_HZ 400000
 
-#define MPU6050_ADDR 0x68
-#define MPU6050_PWR_MGMT_1 0x6B
-#define MPU6050_ACCEL_CONFIG 0x1C
-#define MPU6050_GYRO_CONFIG 0x1B
-#define MPU6050_CONFIG 0x1A
-#define MPU6050_ACCEL_XOUT_H 0x3B
-
-static esp_err_t mpu6050_write_byte(uint8_t reg, uint8_t data) {
-    return i2c_master_write_to_device(I2C_MASTER_NUM, MPU6050_ADDR,
-                                      (uint8_t[]){reg, data}, 2,
-                                      1000 / portTICK_PERIOD_MS);
-}
+#define PRINT_INTERVAL_US 500000
+#define STATS_INTERVAL_US 1000000
+
+#if CONFIG_IMU_FUSION_MADGWICK
+#define FUSION_ALGO IMU_FUSION_MADGWICK
+#define FUSION_GAIN (CONFIG_IMU_FUSION_MADGWICK_BETA / 1000.0f)
+#else
+#define FUSION_ALGO IMU_FUSION_COMPLEMENTARY
+#define FUSION_GAIN (CONFIG_IMU_FUSION_TIME_CONSTANT_MS / 1000.0f)
+#endif
+
+#define RAD_TO_DEG (180.0f / 3.1415926f)
+
+static imu_fusion_t s_fusion;
+static uint32_t s_fusion_updates;
+static int64_t s_fusion_us;  // time spent in imu_fusion_update_raw()
+
+/* Every CONFIG_IMU_LOG_DECIMATION-th raw sample, timed back from the
+ * block's newest, and the orientation after the block */
+static void log_block(const mpu6050_block_t *block, uint32_t period_us) {
+#if CONFIG_IMU_LOG_DECIMATION > 0
+    static uint32_t skipped;
+    for (uint16_t i = 0; i < block->count; i++) {
+        if (++skipped < CONFIG_IMU_LOG_DECIMATION) {
+            continue;
+        }
+        skipped = 0;
+        int64_t t_us =
+            block->last_us - (int64_t)(block->count - 1 - i) * period_us;
+        // mpu6050_raw_t has the logged layout
+        sensor_log_write(SENSOR_LOG_IMU_RAW, t_us, &block->samples[i],
+                         sizeof(sensor_log_imu_raw_t));
+    }
 
-static esp_err_t mpu6050_read_bytes(uint8_t reg, uint8_t *buf, size_t len) {
-    return i2c_master_write_read_device(I2C_MASTER_NUM, MPU6050_ADDR, &reg, 1,
-                                        buf, len, 1000 / portTICK_PERIOD_MS);
+    float roll, pitch, yaw;
+    imu_fusion_get_euler(&s_fusion, &roll, &pitch, &yaw);
+    sensor_log_orientation_t orientation = {
+        roll * RAD_TO_DEG, pitch * RAD_TO_DEG, yaw * RAD_TO_DEG};
+    sensor_log_write(SENSOR_LOG_ORIENTATION, block->last_us, &orientation,
+                     sizeof(orientation));
+#endif
 }
 
-static void mpu6050_init() {
-    mpu6050_write_byte(MPU6050_PWR_MGMT_1, 0x00);    // Wake up
-    mpu6050_write_byte(MPU6050_ACCEL_CONFIG, 0x10);  // ±8g → bits 3:4 = 10
-    mpu6050_write_byte(MPU6050_GYRO_CONFIG, 0x08);   // ±500°/s → bits 3:4 = 01
-    mpu6050_write_byte(MPU6050_CONFIG, 0x04);        // DLPF = 21 Hz → value = 4
+static void print_sample(const mpu6050_raw_t *sample) {
+    printf("Accel: X=%.2f Y=%.2f Z=%.2f m/s²\n",
+           sample->accel[0] * MPU6050_ACCEL_SCALE,
+           sample->accel[1] * MPU6050_ACCEL_SCALE,
+           sample->accel[2] * MPU6050_ACCEL_SCALE);
+
+    printf("Gyro: X=%.2f Y=%.2f Z=%.2f rad/s\n",
+           sample->gyro[0] * MPU6050_GYRO_SCALE,
+           sample->gyro[1] * MPU6050_GYRO_SCALE,
+           sample->gyro[2] * MPU6050_GYRO_SCALE);
+
+    printf("Temp: %.2f °C\n", MPU6050_TEMP_C(sample->temp));
+
+    float roll, pitch, yaw;
+    imu_fusion_get_euler(&s_fusion, &roll, &pitch, &yaw);
+    printf("Roll=%.1f Pitch=%.1f Yaw=%.1f °\n\n", roll * RAD_TO_DEG,
+           pitch * RAD_TO_DEG, yaw * RAD_TO_DEG);
 }
 
-static void i2c_master_init() {
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ,
-    };
-    i2c_param_config(I2C_MASTER_NUM, &conf);
-    i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
+static void print_stats(int64_t elapsed_us) {
+    static mpu6050_stats_t last;
+    mpu6050_stats_t stats;
+    mpu6050_get_stats(&stats);
+
+    ESP_LOGI(TAG, "%.0f samples/s, dropped %lu (+%lu), FIFO resets %lu, "
+             "I2C errors %lu",
+             (stats.samples - last.samples) * 1e6f / elapsed_us,
+             (unsigned long)stats.dropped,
+             (unsigned long)(stats.dropped - last.dropped),
+             (unsigned long)stats.overflows,
+             (unsigned long)stats.i2c_errors);
+    if (s_fusion_updates > 0) {
+        ESP_LOGI(TAG, "Fusion: %.2f us/update",
+                 (float)s_fusion_us / s_fusion_updates);
+    }
+    s_fusion_updates = 0;
+    s_fusion_us = 0;
+    last = stats;
 }
 
-static int16_t read_word(uint8_t *data, int idx) {
-    return (int16_t)((data[idx] << 8) | data[idx + 1]);
+static void print_bus_stats(i2c_bus_t *bus, int64_t elapsed_us) {
+    static i2c_bus_stats_t last;
+    i2c_bus_stats_t stats;
+    i2c_bus_get_stats(bus, &stats);
+
+    uint32_t transactions = stats.transactions - last.transactions;
+    if (transactions > 0) {
+        ESP_LOGI(TAG, "Bus: %lu transactions, %.0f us average latency, "
+                 "%lu us max, %.0f%% busy, queue depth %lu, errors %lu",
+                 (unsigned long)transactions,
+                 (float)(stats.total_latency_us - last.total_latency_us) /
+                     transactions,
+                 (unsigned long)stats.max_latency_us,
+                 (stats.busy_us - last.busy_us) * 100.0f / elapsed_us,
+                 (unsigned long)stats.max_depth,
+                 (unsigned long)stats.errors);
+    }
+    last = stats;
 }
 
 void app_main() {
-    i2c_master_init();
-    mpu6050_init();
+    esp_err_t nvs_err = nvs_flash_init();
+    if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES ||
+        nvs_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvs_err);
+
+    // One bus task owns the pins; more sensors can join with their own
+    // device handles
+    i2c_bus_master_config_t master_config = {
+        .port = I2C_MASTER_NUM,
+        .sda_io = I2C_MASTER_SDA_IO,
+        .scl_io = I2C_MASTER_SCL_IO,
+        .internal_pullup = true,
+    };
+    i2c_bus_config_t bus_config = I2C_BUS_DEFAULT_CONFIG();
+    i2c_bus_backend_t backend;
+    i2c_bus_t *bus;
+    if (i2c_bus_master_backend(&master_config, &backend) != ESP_OK ||
+        i2c_bus_start(&backend, &bus_config, &bus) != ESP_OK) {
+        ESP_LOGE(TAG, "I2C bus init failed. Stopping execution.");
+        return;
+    }
+#if CONFIG_I2C_BUS_BENCH
+    // WHO_AM_I, then one full sample (ACCEL_XOUT_H onwards)
+    i2c_bus_bench(bus, MPU6050_I2C_ADDR, I2C_MASTER_FREQ_HZ, 0x75, 1, 1000);
+    i2c_bus_bench(bus, MPU6050_I2C_ADDR, I2C_MASTER_FREQ_HZ, 0x3B, 14, 1000);
+#endif
+
+    mpu6050_config_t config = MPU6050_DEFAULT_CONFIG();
+    config.bus = bus;
+    config.int_io = MPU6050_INT_IO;
+    config.i2c_hz = I2C_MASTER_FREQ_HZ;
+    if (mpu6050_start(&config) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6050 init failed. Stopping execution.");
+        return;
+    }
 
     ESP_LOGI(TAG, "MPU6050 initialized");
 
+    // Offsets apply inside the driver, so every block below is corrected
+    mpu6050_cal_config_t cal_config = MPU6050_CAL_DEFAULT_CONFIG();
+    mpu6050_cal_result_t cal_result;
+    if (mpu6050_calibrate(&cal_config, &cal_result) != ESP_OK) {
+        ESP_LOGE(TAG, "Calibration failed. Stopping execution.");
+        return;
+    }
+    ESP_LOGI(TAG, "Calibration: %s", mpu6050_cal_result_name(cal_result));
+    imu_fusion_init(&s_fusion, FUSION_ALGO, 1.0f / config.sample_rate_hz,
+                    MPU6050_GYRO_SCALE, MPU6050_ACCEL_SCALE, FUSION_GAIN);
+
+    // Optional: without the partition the readings are only printed
+    sensor_log_config_t log_config = SENSOR_LOG_DEFAULT_CONFIG();
+    if (sensor_log_start(&log_config) != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor log unavailable");
+    }
+    uint32_t period_us = 1000000 / config.sample_rate_hz;
+
+    /* This task is the consumer: it runs the filter over each block and
+     * hands it back, so formatting never delays the reader */
+    mpu6050_raw_t latest;
+    int64_t last_print = esp_timer_get_time();
+    int64_t last_stats = last_print;
     while (1) {
-        uint8_t data[14];
-        if (mpu6050_read_bytes(MPU6050_ACCEL_XOUT_H, data, 14) != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to read sensor data");
-            vTaskDelay(pdMS_TO_TICKS(500));
+        mpu6050_block_t *block = mpu6050_get_block(pdMS_TO_TICKS(1000));
+        if (block == NULL) {
+            ESP_LOGE(TAG, "No sensor data");
             continue;
         }
-
-        int16_t ax = read_word(data, 0);
-        int16_t ay = read_word(data, 2);
-        int16_t az = read_word(data, 4);
-        int16_t temp_raw = read_word(data, 6);
-        int16_t gx = read_word(data, 8);
-        int16_t gy = read_word(data, 10);
-        int16_t gz = read_word(data, 12);
-
-        // Scaling factors
-        float accel_scale = 9.81f / 4096.0f;  // ±8g → 4096 LSB/g
-        float gyro_scale =
-            (3.1415926f / 180.0f) / 65.5f;  // ±500°/s → 65.5 LSB/(°/s) → rad/s
-        float temp = (temp_raw / 340.0f) + 36.53f;
-
-        printf("Accel: X=%.2f Y=%.2f Z=%.2f m/s²\n", ax * accel_scale,
-               ay * accel_scale, az * accel_scale);
-
-        printf("Gyro: X=%.2f Y=%.2f Z=%.2f rad/s\n", gx * gyro_scale,
-               gy * gyro_scale, gz * gyro_scale);
-
-        printf("Temp: %.2f °C\n\n", temp);
-
-        vTaskDelay(pdMS_TO_TICKS(500));
+        int64_t start = esp_timer_get_time();
+        for (uint16_t i = 0; i < block->count; i++) {
+            imu_fusion_update_raw(&s_fusion, block->samples[i].gyro,
+                                  block->samples[i].accel);
+        }
+        s_fusion_us += esp_timer_get_time() - start;
+        s_fusion_updates += block->count;
+        latest = block->samples[block->count - 1];
+        log_block(block, period_us);
+        mpu6050_release_block(block);
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_print >= PRINT_INTERVAL_US) {
+            print_sample(&latest);
+            last_print = now;
+        }
+        if (now - last_stats >= STATS_INTERVAL_US) {
+            print_stats(now - last_stats);
+            print_bus_stats(bus, now - last_stats);
+            sensor_log_print_stats();
+            last_stats = now;
+        }
     }
 }
@@ -0,0 +1,441 @@
+/* Host check and latency model for the shared I2C bus.
+ *
+ *   cc -O2 -I../main/components/i2c_bus i2c_bus_bench.c \
+ *       ../main/components/i2c_bus/i2c_bus_core.c \
+ *       ../main/components/i2c_bus/i2c_bus_mock.c -o i2c_bus_bench
+ *   ./i2c_bus_bench [scl_hz] [overhead_us] [block_samples] [burst_samples]
+ *                   [jitter_us]
+ *
+ * Checks the scheduler queue and the mock bus, then runs the bus task's
+ * loop in simulated time against mock devices: the MPU6050 sampling at
+ * about 1 kHz and draining its FIFO every block_samples samples (default 10:
+ * a count, then bursts of up to burst_samples, default 2 as in
+ * mpu6050.c), sharing the bus with a sensor read every 2 ms and another
+ * every 5 ms. Every request arrives up to jitter_us (default 200) late,
+ * as task wakeups do, and the streams start at random phases, so the
+ * order they meet on the bus varies. overhead_us is the driver's cost per
+ * transaction on top of the wire time (measure it on the chip with
+ * CONFIG_I2C_BUS_BENCH). Reports each stream's latency from request to
+ * completion with the MPU6050's count and first burst at high priority
+ * (later bursts at normal, as in the driver), then with one shared queue,
+ * and the queue's own cost per operation. A burst holds the bus until it
+ * ends, so burst_samples bounds how long the other sensors can wait, and
+ * matters far more than the priority: at the defaults, 2-sample bursts
+ * keep the 2 ms read under its period (10-sample bursts overrun it about
+ * 1000 times in 10 s), while the priority moves the latencies by tens of
+ * microseconds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2c_bus_core.h"
+#include "i2c_bus_mock.h"
+
+#define SIM_MS 10000
+#define MAX_LATENCIES 8192
+
+#define MPU6050_ADDR 0x68
+#define MPU6050_FIFO_COUNT_H 0x72
+#define MPU6050_FIFO_R_W 0x74
+#define SAMPLE_BYTES 14
+#define BLOCK_MAX 32
+// The MPU6050 runs off its own oscillator, here 0.3% slow, so its drains
+// drift through the other streams' phases instead of locking to them
+#define IMU_SAMPLE_US 1003
+
+static int failures;
+
+#define CHECK(cond)                                               \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                           \
+        }                                                         \
+    } while (0)
+
+static int64_t now_ns;  // simulated time
+static uint32_t rng_state;
+
+// xorshift32: the same arrivals for both queue orders
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* ---- MPU6050 FIFO model: one sample per IMU_SAMPLE_US, 1 KB deep ---- */
+
+static uint32_t fifo_read_bytes;
+
+static bool fifo_overflowed;
+
+static uint32_t fifo_bytes(void) {
+    uint32_t produced =
+        (uint32_t)(now_ns / (IMU_SAMPLE_US * 1000)) * SAMPLE_BYTES;
+    uint32_t bytes = produced - fifo_read_bytes;
+    if (bytes > 1024) {
+        fifo_overflowed = true;
+        return 1024;
+    }
+    return bytes;
+}
+
+static uint8_t mpu6050_read(i2c_bus_mock_dev_t *dev, uint8_t reg) {
+    if (reg == MPU6050_FIFO_COUNT_H) {
+        return (uint8_t)(fifo_bytes() >> 8);
+    }
+    if (reg == MPU6050_FIFO_COUNT_H + 1) {
+        return (uint8_t)fifo_bytes();
+    }
+    if (reg == MPU6050_FIFO_R_W) {
+        // The FIFO port does not auto-increment
+        dev->pointer = MPU6050_FIFO_R_W;
+        fifo_read_bytes++;
+        return 0;
+    }
+    return dev->regs[reg];
+}
+
+/* ---- Streams: one outstanding request each ---- */
+
+typedef struct {
+    const char *name;
+    uint32_t period_us;
+    i2c_bus_prio_t prio;
+    i2c_bus_device_t dev;
+    i2c_bus_txn_t txn;
+    uint8_t reg;
+    uint8_t rx[BLOCK_MAX * SAMPLE_BYTES];
+    int64_t base_ns;  // when the next request is due, without jitter
+    int64_t next_ns;  // when it arrives
+    int64_t request_ns;
+    bool busy;
+    uint32_t overruns;  // requests skipped, the previous still running
+    uint32_t latency_us[MAX_LATENCIES];
+    size_t latency_count;
+} stream_t;
+
+typedef struct {
+    i2c_bus_queue_t queue;
+    i2c_bus_backend_t backend;
+    i2c_bus_mock_t mock;
+    int64_t overhead_ns;
+    int64_t jitter_ns;
+    uint16_t burst_samples;
+    int64_t busy_ns;
+} sim_t;
+
+static sim_t sim;
+static uint16_t imu_pending;
+static uint8_t fifo_reg = MPU6050_FIFO_R_W;
+
+static void finish(stream_t *s) {
+    if (s->latency_count < MAX_LATENCIES) {
+        s->latency_us[s->latency_count++] =
+            (uint32_t)((now_ns - s->request_ns) / 1000);
+    }
+    s->busy = false;
+}
+
+static void plain_done(i2c_bus_txn_t *txn) { finish(txn->arg); }
+
+/* The same chain as mpu6050.c: count, then bursts of up to
+ * burst_samples, the ones after the first at normal priority */
+static void imu_burst_done(i2c_bus_txn_t *txn);
+
+static void imu_next(stream_t *s, i2c_bus_prio_t prio) {
+    if (imu_pending == 0) {
+        finish(s);
+        return;
+    }
+    uint16_t n = imu_pending < sim.burst_samples ? imu_pending
+                                                 : sim.burst_samples;
+    s->txn.tx = &fifo_reg;
+    s->txn.rx_len = n * SAMPLE_BYTES;
+    s->txn.done = imu_burst_done;
+    i2c_bus_queue_push(&sim.queue, &s->txn, prio);
+}
+
+static void imu_burst_done(i2c_bus_txn_t *txn) {
+    imu_pending -= txn->rx_len / SAMPLE_BYTES;
+    imu_next(txn->arg, I2C_BUS_PRIO_NORMAL);
+}
+
+static void imu_count_done(i2c_bus_txn_t *txn) {
+    stream_t *s = txn->arg;
+    imu_pending = ((s->rx[0] << 8) | s->rx[1]) / SAMPLE_BYTES;
+    imu_next(s, s->prio);
+}
+
+static void schedule(stream_t *s) {
+    s->next_ns = s->base_ns +
+                 (sim.jitter_ns > 0 ? rng_next() % sim.jitter_ns : 0);
+}
+
+// Taken between transfers, but timed from when it was due
+static void request(stream_t *s) {
+    int64_t due_ns = s->base_ns;
+    s->base_ns += (int64_t)s->period_us * 1000;
+    schedule(s);
+    if (s->busy) {
+        s->overruns++;
+        return;
+    }
+    s->busy = true;
+    s->request_ns = due_ns;
+    s->txn.tx = &s->reg;
+    s->txn.rx_len = s->dev.address == MPU6050_ADDR ? 2 : s->txn.rx_len;
+    s->txn.done = s->dev.address == MPU6050_ADDR ? imu_count_done
+                                                 : plain_done;
+    s->txn.queued_us = due_ns / 1000;
+    if (!i2c_bus_queue_push(&sim.queue, &s->txn, s->prio)) {
+        s->overruns++;
+        s->busy = false;
+    }
+}
+
+static stream_t streams[] = {
+    {.name = "MPU6050 drain", .dev.address = MPU6050_ADDR,
+     .reg = MPU6050_FIFO_COUNT_H},
+    {.name = "0x77, 6 B / 2 ms", .period_us = 2000, .dev.address = 0x77,
+     .txn.rx_len = 6},
+    {.name = "0x40, 32 B / 5 ms", .period_us = 5000, .dev.address = 0x40,
+     .txn.rx_len = 32},
+};
+#define STREAM_COUNT (sizeof(streams) / sizeof(streams[0]))
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Queues, in time order, every request that has arrived by now
+static void take_arrivals(void) {
+    while (true) {
+        stream_t *due = NULL;
+        for (size_t i = 0; i < STREAM_COUNT; i++) {
+            if (streams[i].next_ns <= now_ns &&
+                (due == NULL || streams[i].next_ns < due->next_ns)) {
+                due = &streams[i];
+            }
+        }
+        if (due == NULL) {
+            return;
+        }
+        request(due);
+    }
+}
+
+/* The bus task's loop. Requests that arrive during a transfer are queued
+ * before its completion callback runs, as they would be on the chip. */
+static void simulate(uint32_t scl_hz, uint32_t block_samples,
+                     bool imu_high) {
+    memset(&sim.queue, 0, sizeof(sim.queue));
+    i2c_bus_mock_init(&sim.mock);
+    i2c_bus_mock_backend(&sim.mock, &sim.backend);
+    sim.busy_ns = 0;
+    now_ns = 0;
+    fifo_read_bytes = 0;
+    fifo_overflowed = false;
+    rng_state = 0x12345678;
+
+    streams[0].period_us = block_samples * IMU_SAMPLE_US;
+    for (size_t i = 0; i < STREAM_COUNT; i++) {
+        stream_t *s = &streams[i];
+        i2c_bus_mock_dev_t *mock_dev = i2c_bus_mock_add(&sim.mock,
+                                                        s->dev.address);
+        if (s->dev.address == MPU6050_ADDR) {
+            mock_dev->read_hook = mpu6050_read;
+        }
+        sim.backend.add_device(sim.backend.ctx, s->dev.address, scl_hz,
+                               &s->dev.handle);
+        s->prio =
+            i == 0 && imu_high ? I2C_BUS_PRIO_HIGH : I2C_BUS_PRIO_NORMAL;
+        s->txn.dev = &s->dev;
+        s->txn.tx_len = 1;
+        s->txn.rx = s->rx;
+        s->txn.arg = s;
+        s->base_ns = rng_next() % (s->period_us * 1000);
+        schedule(s);
+        s->busy = false;
+        s->overruns = 0;
+        s->latency_count = 0;
+    }
+
+    int64_t end_ns = (int64_t)SIM_MS * 1000000;
+    while (now_ns < end_ns) {
+        take_arrivals();
+        i2c_bus_txn_t *txn = i2c_bus_queue_pop(&sim.queue);
+        if (txn == NULL) {
+            int64_t next = end_ns;
+            for (size_t i = 0; i < STREAM_COUNT; i++) {
+                if (streams[i].next_ns < next) {
+                    next = streams[i].next_ns;
+                }
+            }
+            now_ns = next;
+            continue;
+        }
+        uint64_t wire_before = sim.mock.wire_ns;
+        txn->err = sim.backend.transfer(sim.backend.ctx, txn->dev->handle,
+                                        txn->tx, txn->tx_len, txn->rx,
+                                        txn->rx_len, 20);
+        int64_t spent =
+            (int64_t)(sim.mock.wire_ns - wire_before) + sim.overhead_ns;
+        now_ns += spent;
+        sim.busy_ns += spent;
+        take_arrivals();
+        txn->done(txn);
+    }
+
+    printf("\n%s, bus %.0f%% busy\n",
+           imu_high ? "MPU6050 drain starts at high priority"
+                    : "One shared queue",
+           sim.busy_ns * 100.0 / end_ns);
+    printf("  %-18s %8s %8s %8s %9s\n", "stream", "p50 us", "p99 us",
+           "max us", "overruns");
+    for (size_t i = 0; i < STREAM_COUNT; i++) {
+        stream_t *s = &streams[i];
+        if (s->latency_count == 0) {
+            printf("  %-18s never completed\n", s->name);
+            continue;
+        }
+        qsort(s->latency_us, s->latency_count, sizeof(uint32_t),
+              compare_u32);
+        printf("  %-18s %8lu %8lu %8lu %9lu\n", s->name,
+               (unsigned long)s->latency_us[s->latency_count / 2],
+               (unsigned long)s->latency_us[s->latency_count * 99 / 100],
+               (unsigned long)s->latency_us[s->latency_count - 1],
+               (unsigned long)s->overruns);
+    }
+    if (fifo_overflowed) {
+        printf("  The MPU6050 FIFO overflowed: the bus cannot keep up\n");
+    }
+}
+
+/* ---- Checks ---- */
+
+static void check_queue(void) {
+    i2c_bus_queue_t q;
+    i2c_bus_txn_t txns[I2C_BUS_QUEUE_LEN + 1];
+    i2c_bus_queue_init(&q);
+    CHECK(i2c_bus_queue_pop(&q) == NULL);
+
+    i2c_bus_queue_push(&q, &txns[0], I2C_BUS_PRIO_NORMAL);
+    i2c_bus_queue_push(&q, &txns[1], I2C_BUS_PRIO_NORMAL);
+    i2c_bus_queue_push(&q, &txns[2], I2C_BUS_PRIO_HIGH);
+    CHECK(i2c_bus_queue_depth(&q) == 3);
+    CHECK(i2c_bus_queue_pop(&q) == &txns[2]);
+    CHECK(i2c_bus_queue_pop(&q) == &txns[0]);
+    CHECK(i2c_bus_queue_pop(&q) == &txns[1]);
+    CHECK(i2c_bus_queue_pop(&q) == NULL);
+    CHECK(q.max_depth == 3);
+
+    for (int i = 0; i < I2C_BUS_QUEUE_LEN; i++) {
+        CHECK(i2c_bus_queue_push(&q, &txns[i], I2C_BUS_PRIO_NORMAL));
+    }
+    CHECK(!i2c_bus_queue_push(&q, &txns[I2C_BUS_QUEUE_LEN],
+                              I2C_BUS_PRIO_NORMAL));
+    CHECK(i2c_bus_queue_push(&q, &txns[I2C_BUS_QUEUE_LEN],
+                             I2C_BUS_PRIO_HIGH));
+    CHECK(i2c_bus_queue_pop(&q) == &txns[I2C_BUS_QUEUE_LEN]);
+    for (int i = 0; i < I2C_BUS_QUEUE_LEN; i++) {
+        CHECK(i2c_bus_queue_pop(&q) == &txns[i]);  // wrapped in order
+    }
+}
+
+static void check_mock(void) {
+    i2c_bus_mock_t mock;
+    i2c_bus_backend_t backend;
+    i2c_bus_mock_init(&mock);
+    i2c_bus_mock_backend(&mock, &backend);
+    i2c_bus_mock_dev_t *mock_dev = i2c_bus_mock_add(&mock, 0x68);
+    mock_dev->regs[0x75] = 0x68;
+
+    void *dev, *absent;
+    CHECK(backend.add_device(backend.ctx, 0x68, 400000, &dev) == ESP_OK);
+    CHECK(backend.add_device(backend.ctx, 0x50, 400000, &absent) == ESP_OK);
+
+    uint8_t reg = 0x75, value = 0;
+    CHECK(backend.transfer(backend.ctx, dev, &reg, 1, &value, 1, 20) ==
+          ESP_OK);
+    CHECK(value == 0x68);
+    CHECK(backend.transfer(backend.ctx, absent, &reg, 1, &value, 1, 20) ==
+          ESP_FAIL);
+
+    // Register writes auto-increment, and so do reads
+    const uint8_t write[] = {0x19, 0x00, 0x04, 0x08};
+    uint8_t back[3];
+    CHECK(backend.transfer(backend.ctx, dev, write, sizeof(write), NULL, 0,
+                           20) == ESP_OK);
+    reg = 0x19;
+    CHECK(backend.transfer(backend.ctx, dev, &reg, 1, back, 3, 20) ==
+          ESP_OK);
+    CHECK(memcmp(back, &write[1], 3) == 0);
+
+    mock.fail_every = 2;
+    mock.transfers = 0;
+    CHECK(backend.transfer(backend.ctx, dev, &reg, 1, back, 1, 20) ==
+          ESP_OK);
+    CHECK(backend.transfer(backend.ctx, dev, &reg, 1, back, 1, 20) ==
+          ESP_FAIL);
+
+    // 1 + 1 bytes out, 1 + 140 in, start, repeated start, stop
+    CHECK(i2c_bus_mock_wire_ns(400000, 1, 140) == (143 * 9 + 3) * 2500u);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_queue(void) {
+    i2c_bus_queue_t q;
+    i2c_bus_txn_t txn;
+    i2c_bus_queue_init(&q);
+    const int rounds = 10000000;
+    size_t sink = 0;
+    double start = now_s();
+    for (int i = 0; i < rounds; i++) {
+        i2c_bus_queue_push(&q, &txn, (i2c_bus_prio_t)(i & 1));
+        sink += (size_t)i2c_bus_queue_pop(&q);
+    }
+    double elapsed = now_s() - start;
+    printf("\nQueue push + pop: %.1f ns%s\n", elapsed * 1e9 / rounds,
+           sink == 0 ? "!" : "");
+}
+
+int main(int argc, char **argv) {
+    uint32_t scl_hz = argc > 1 ? (uint32_t)atol(argv[1]) : 400000;
+    sim.overhead_ns = (argc > 2 ? atol(argv[2]) : 30) * 1000;
+    uint32_t block_samples = argc > 3 ? (uint32_t)atol(argv[3]) : 10;
+    uint32_t burst_samples = argc > 4 ? (uint32_t)atol(argv[4]) : 2;
+    sim.jitter_ns = (argc > 5 ? atol(argv[5]) : 200) * 1000;
+    if (scl_hz == 0 || block_samples == 0 || block_samples > BLOCK_MAX ||
+        burst_samples == 0 || burst_samples > BLOCK_MAX ||
+        sim.jitter_ns < 0) {
+        fprintf(stderr, "usage: %s [scl_hz] [overhead_us] [block_samples "
+                "1..%d] [burst_samples 1..%d] [jitter_us]\n", argv[0],
+                BLOCK_MAX, BLOCK_MAX);
+        return 2;
+    }
+    sim.burst_samples = burst_samples;
+
+    check_queue();
+    check_mock();
+    printf("%lu Hz, %ld us overhead per transaction, %lu-sample blocks "
+           "in bursts of %lu, up to %ld us jitter, %d ms simulated\n",
+           (unsigned long)scl_hz, (long)(sim.overhead_ns / 1000),
+           (unsigned long)block_samples, (unsigned long)burst_samples,
+           (long)(sim.jitter_ns / 1000), SIM_MS);
+    simulate(scl_hz, block_samples, true);
+    simulate(scl_hz, block_samples, false);
+    bench_queue();
+
+    printf("%s\n", failures == 0 ? "All checks passed" : "Checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/* Host check and benchmark for the orientation filters.
+ *
+ *   cc -O2 -I../main/components/imu_fusion imu_fusion_bench.c \
+ *       ../main/components/imu_fusion/imu_fusion.c -lm -o imu_fusion_bench
+ *   ./imu_fusion_bench                 # synthetic check + benchmark
+ *   ./imu_fusion_bench trace.csv > orientation.csv
+ *
+ * Without arguments it synthesises a 1 kHz trace (roll, then pitch
+ * swinging ±30°, with gyro bias and noise, quantised like the sensor),
+ * checks both filters track it, and reports µs per update. With a trace
+ * it replays it through both filters and prints roll, pitch and yaw in
+ * degrees as CSV. Trace lines are raw counts at the firmware's default
+ * ranges (±8 g, ±500 °/s):
+ *
+ *   t_us,ax,ay,az,temp,gx,gy,gz
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "imu_fusion.h"
+
+#define ACCEL_LSB_PER_G 4096.0f
+#define GYRO_LSB_PER_DPS 65.5f
+#define GYRO_SCALE ((3.1415926f / 180.0f) / GYRO_LSB_PER_DPS)
+#define ACCEL_SCALE (9.81f / ACCEL_LSB_PER_G)
+#define DEG (180.0f / 3.1415926f)
+
+// Same gains as the firmware defaults
+#define COMPLEMENTARY_TAU_S 0.5f
+#define MADGWICK_BETA 0.05f
+
+typedef struct {
+    int64_t t_us;
+    int16_t accel[3];
+    int16_t gyro[3];
+    float roll, pitch;  // truth, synthetic traces only
+} trace_sample_t;
+
+static int16_t quantise(float value) {
+    float rounded = roundf(value);
+    return (int16_t)fmaxf(-32768.0f, fminf(32767.0f, rounded));
+}
+
+static float noise(float amplitude) {
+    return amplitude * ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+}
+
+/* Single-axis swings keep body rates equal to Euler rates, so the truth
+ * is exact: roll for the first half, then pitch */
+static size_t synthesise(trace_sample_t *trace, size_t n, float rate_hz) {
+    const float amplitude = 0.5236f;  // 30°
+    const float omega = 2.0f * 3.1415926f * 0.5f;
+    const float bias[3] = {0.01f, -0.008f, 0.005f};  // rad/s
+    for (size_t i = 0; i < n; i++) {
+        float t = i / rate_hz;
+        bool roll_phase = i < n / 2;
+        float angle = amplitude * sinf(omega * t);
+        float rate = amplitude * omega * cosf(omega * t);
+        float roll = roll_phase ? angle : 0.0f;
+        float pitch = roll_phase ? 0.0f : angle;
+
+        float g[3] = {roll_phase ? rate : 0.0f, roll_phase ? 0.0f : rate,
+                      0.0f};
+        float a[3] = {-sinf(pitch), cosf(pitch) * sinf(roll),
+                      cosf(pitch) * cosf(roll)};  // in g
+        trace_sample_t *s = &trace[i];
+        s->t_us = (int64_t)(t * 1e6f);
+        for (int axis = 0; axis < 3; axis++) {
+            s->gyro[axis] = quantise((g[axis] + bias[axis] + noise(0.02f)) /
+                                     GYRO_SCALE);
+            s->accel[axis] =
+                quantise((a[axis] + noise(0.02f)) * ACCEL_LSB_PER_G);
+        }
+        s->roll = roll;
+        s->pitch = pitch;
+    }
+    return n;
+}
+
+static size_t load(const char *path, trace_sample_t **out) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    size_t capacity = 4096, n = 0;
+    trace_sample_t *trace = malloc(capacity * sizeof(*trace));
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        long long t;
+        int ax, ay, az, temp, gx, gy, gz;
+        if (sscanf(line, "%lld,%d,%d,%d,%d,%d,%d,%d", &t, &ax, &ay, &az,
+                   &temp, &gx, &gy, &gz) != 8) {
+            continue;  // header or comment
+        }
+        if (n == capacity) {
+            capacity *= 2;
+            trace = realloc(trace, capacity * sizeof(*trace));
+        }
+        trace[n++] = (trace_sample_t){.t_us = t,
+                                      .accel = {ax, ay, az},
+                                      .gyro = {gx, gy, gz}};
+    }
+    fclose(file);
+    *out = trace;
+    return n;
+}
+
+static float rate_of(const trace_sample_t *trace, size_t n) {
+    if (n < 2 || trace[n - 1].t_us <= trace[0].t_us) {
+        return 1000.0f;
+    }
+    return (n - 1) * 1e6f / (float)(trace[n - 1].t_us - trace[0].t_us);
+}
+
+static void replay(const trace_sample_t *trace, size_t n) {
+    float dt = 1.0f / rate_of(trace, n);
+    imu_fusion_t comp, madg;
+    imu_fusion_init(&comp, IMU_FUSION_COMPLEMENTARY, dt, GYRO_SCALE,
+                    ACCEL_SCALE, COMPLEMENTARY_TAU_S);
+    imu_fusion_init(&madg, IMU_FUSION_MADGWICK, dt, GYRO_SCALE, ACCEL_SCALE,
+                    MADGWICK_BETA);
+    printf("t_us,comp_roll,comp_pitch,comp_yaw,"
+           "madg_roll,madg_pitch,madg_yaw\n");
+    for (size_t i = 0; i < n; i++) {
+        float r[2], p[2], y[2];
+        imu_fusion_update_raw(&comp, trace[i].gyro, trace[i].accel);
+        imu_fusion_update_raw(&madg, trace[i].gyro, trace[i].accel);
+        imu_fusion_get_euler(&comp, &r[0], &p[0], &y[0]);
+        imu_fusion_get_euler(&madg, &r[1], &p[1], &y[1]);
+        printf("%lld", (long long)trace[i].t_us);
+        for (int k = 0; k < 2; k++) {
+            printf(",%.3f,%.3f,%.3f", (double)(r[k] * DEG),
+                   (double)(p[k] * DEG), (double)(y[k] * DEG));
+        }
+        printf("\n");
+    }
+}
+
+// RMS roll/pitch error in degrees, after the filter has converged
+static bool check(const char *name, imu_fusion_algo_t algo, float gain,
+                  const trace_sample_t *trace, size_t n, float rate_hz) {
+    imu_fusion_t f;
+    imu_fusion_init(&f, algo, 1.0f / rate_hz, GYRO_SCALE, ACCEL_SCALE, gain);
+    size_t settle = (size_t)(2.0f * rate_hz);
+    double sum_sq = 0.0;
+    float worst = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        float roll, pitch, yaw;
+        imu_fusion_update_raw(&f, trace[i].gyro, trace[i].accel);
+        imu_fusion_get_euler(&f, &roll, &pitch, &yaw);
+        if (i >= settle) {
+            float err = fmaxf(fabsf(roll - trace[i].roll),
+                              fabsf(pitch - trace[i].pitch)) * DEG;
+            sum_sq += (double)(err * err);
+            worst = fmaxf(worst, err);
+        }
+    }
+    float rms = (float)sqrt(sum_sq / (double)(n - settle));
+    bool ok = rms < 2.0f && worst < 6.0f;
+    printf("%-14s rms %.2f° max %.2f°  %s\n", name, (double)rms,
+           (double)worst, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(const char *name, imu_fusion_algo_t algo, float gain,
+                  const trace_sample_t *trace, size_t n) {
+    imu_fusion_t f;
+    imu_fusion_init(&f, algo, 0.001f, GYRO_SCALE, ACCEL_SCALE, gain);
+    const int passes = 50;
+    double start = now_s();
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            imu_fusion_update_raw(&f, trace[i].gyro, trace[i].accel);
+        }
+    }
+    double elapsed = now_s() - start;
+    float roll, pitch, yaw;
+    imu_fusion_get_euler(&f, &roll, &pitch, &yaw);  // keep the work live
+    printf("%-14s %.3f us/update (%.0f ns)%s\n", name,
+           elapsed * 1e6 / ((double)passes * n),
+           elapsed * 1e9 / ((double)passes * n), roll > 1e9f ? "!" : "");
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        trace_sample_t *trace;
+        size_t n = load(argv[1], &trace);
+        fprintf(stderr, "%zu samples at %.0f Hz\n", n,
+                (double)rate_of(trace, n));
+        replay(trace, n);
+        free(trace);
+        return 0;
+    }
+
+    const float rate_hz = 1000.0f;
+    size_t n = 20000;
+    trace_sample_t *trace = malloc(n * sizeof(*trace));
+    srand(1);
+    synthesise(trace, n, rate_hz);
+
+    bool ok = check("complementary", IMU_FUSION_COMPLEMENTARY,
+                    COMPLEMENTARY_TAU_S, trace, n, rate_hz);
+    ok &= check("madgwick", IMU_FUSION_MADGWICK, MADGWICK_BETA, trace, n,
+                rate_hz);
+    bench("complementary", IMU_FUSION_COMPLEMENTARY, COMPLEMENTARY_TAU_S,
+          trace, n);
+    bench("madgwick", IMU_FUSION_MADGWICK, MADGWICK_BETA, trace, n);
+    free(trace);
+    return ok ? 0 : 1;
+}
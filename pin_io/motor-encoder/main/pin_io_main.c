@@ -8,6 +8,8 @@
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "metrics.h"
+#include "sensor_log.h"
 
 static const char *MOTOR_TAG = "MOTOR_CONTROL";
 static const char *ENCODER_TAG = "ENCODER";
@@ -26,6 +28,8 @@ static const char *ENCODER_TAG = "ENCODER";
 /* Encoder definitions */
 #define ENCODER_PIN GPIO_NUM_2
 #define ENCODER_LOG_INTERVAL_MS 1000
+#define ENCODER_RECORD_INTERVAL_MS 50  // to the sensor log
+#define LOG_STATS_INTERVAL_MS 10000
 #define ENCODER_MAX_COUNT INT32_MAX
 #define ENCODER_DEBOUNCE_US 1000
 
@@ -38,6 +42,9 @@ typedef struct {
     volatile int64_t last_pulse_time_us;
 } encoder_state_t;
 
+METRIC_COUNTER(encoder_pulses_metric, "encoder_pulses_total",
+               "Debounced encoder pulses counted by the ISR");
+
 static encoder_state_t encoder_state = {
     .pulse_count = 0,
     .encoder_pin = ENCODER_PIN,
@@ -63,6 +70,8 @@ static void IRAM_ATTR encoder_isr_handler(void *arg) {
         encoder_state.pulse_count = 0;
     }
     portEXIT_CRITICAL_ISR(&encoder_state.spinlock);
+
+    metric_inc(&encoder_pulses_metric);
 }
 
 esp_err_t encoder_init(void) {
@@ -98,6 +107,7 @@ esp_err_t encoder_init(void) {
         return ret;
     }
 
+    metrics_register(&encoder_pulses_metric);
     encoder_state.pulse_count = 0;
     encoder_state.last_pulse_time_us = esp_timer_get_time();
     encoder_state.initialized = true;
@@ -158,6 +168,9 @@ esp_err_t drive_motor(int direction, int speed) {
     }
 
     esp_err_t ret = ESP_OK;
+    sensor_log_motor_t record = {.direction = direction, .duty = speed};
+    sensor_log_write(SENSOR_LOG_MOTOR, esp_timer_get_time(), &record,
+                     sizeof(record));
 
     if (direction == 0) {
         ret |= ledc_set_duty(LEDC_MODE, LEDC_CHANNEL_PIN1, 0);
@@ -210,14 +223,33 @@ void motor_task(void *param) {
     }
 }
 
+/* Records the count to the sensor log every ENCODER_RECORD_INTERVAL_MS
+ * and prints it every ENCODER_LOG_INTERVAL_MS */
 void encoder_logger_task(void *param) {
     long last_encoder_count = 0;
+    long last_record_count = 0;
+    uint32_t ticks = 0;
+    TickType_t wake = xTaskGetTickCount();
 
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(ENCODER_LOG_INTERVAL_MS));
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(ENCODER_RECORD_INTERVAL_MS));
+        ticks++;
+        if (!encoder_state.initialized) {
+            continue;
+        }
 
-        if (encoder_state.initialized) {
-            long current_encoder_count = encoder_get_count();
+        long current_encoder_count = encoder_get_count();
+        sensor_log_encoder_t record = {
+            .count = current_encoder_count,
+            .pulses_per_s = (current_encoder_count - last_record_count) *
+                            1000.0f / ENCODER_RECORD_INTERVAL_MS,
+        };
+        sensor_log_write(SENSOR_LOG_ENCODER, esp_timer_get_time(), &record,
+                         sizeof(record));
+        last_record_count = current_encoder_count;
+
+        if (ticks % (ENCODER_LOG_INTERVAL_MS / ENCODER_RECORD_INTERVAL_MS) ==
+            0) {
             long diff = current_encoder_count - last_encoder_count;
 
             ESP_LOGI(ENCODER_TAG, "Encoder count: %ld (change: %ld)",
@@ -226,6 +258,10 @@ void encoder_logger_task(void *param) {
 
             last_encoder_count = current_encoder_count;
         }
+        if (ticks % (LOG_STATS_INTERVAL_MS / ENCODER_RECORD_INTERVAL_MS) ==
+            0) {
+            sensor_log_print_stats();
+        }
     }
 }
 
@@ -260,6 +296,11 @@ void app_main(void) {
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_pin1_channel));
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_pin2_channel));
 
+    sensor_log_config_t log_config = SENSOR_LOG_DEFAULT_CONFIG();
+    if (sensor_log_start(&log_config) != ESP_OK) {
+        ESP_LOGW(MOTOR_TAG, "Sensor log unavailable");
+    }
+
     if (encoder_init() != ESP_OK) {
         ESP_LOGE(ENCODER_TAG, "Encoder init failed");
     } else {
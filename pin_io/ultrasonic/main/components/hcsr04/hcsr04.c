@@ -0,0 +1,213 @@
+#include "hcsr04.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "driver/mcpwm_cap.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "soc/soc_caps.h"
+
+static const char *TAG = "hcsr04";
+
+#define TRIG_PULSE_US 10
+
+struct hcsr04 {
+    hcsr04_config_t config;
+    mcpwm_cap_channel_handle_t channel;
+    uint32_t resolution_hz;  // of the capture timer
+    int64_t last_trigger_us;
+
+    // Shared with the capture ISR
+    portMUX_TYPE lock;
+    TaskHandle_t waiter;  // NULL unless a ping is in flight
+    uint32_t rise;        // timer value at the echo's rising edge
+    bool high;
+};
+
+/* One free-running capture timer per group, shared by its channels.
+ * Created by the first sensor in the group, so create sensors from one
+ * task. */
+static mcpwm_cap_timer_handle_t s_timers[SOC_MCPWM_GROUPS];
+
+static bool IRAM_ATTR on_capture(mcpwm_cap_channel_handle_t channel,
+                                 const mcpwm_capture_event_data_t *edata,
+                                 void *arg) {
+    hcsr04_t *sensor = arg;
+    TaskHandle_t waiter = NULL;
+    uint32_t ticks = 0;
+
+    portENTER_CRITICAL_ISR(&sensor->lock);
+    if (edata->cap_edge == MCPWM_CAP_EDGE_POS) {
+        sensor->rise = edata->cap_value;
+        sensor->high = true;
+    } else {
+        if (sensor->high) {
+            // Unsigned, so a timer wrap during the echo still subtracts
+            ticks = edata->cap_value - sensor->rise;
+            waiter = sensor->waiter;
+            sensor->waiter = NULL;
+        }
+        sensor->high = false;
+    }
+    portEXIT_CRITICAL_ISR(&sensor->lock);
+
+    BaseType_t woken = pdFALSE;
+    if (waiter != NULL) {
+        xTaskNotifyFromISR(waiter, ticks, eSetValueWithOverwrite, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+static esp_err_t start_timer(int group_id) {
+    if (s_timers[group_id] != NULL) {
+        return ESP_OK;
+    }
+    mcpwm_capture_timer_config_t timer_config = {
+        .group_id = group_id,
+        .clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT,
+    };
+    mcpwm_cap_timer_handle_t timer;
+    esp_err_t err = mcpwm_new_capture_timer(&timer_config, &timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = mcpwm_capture_timer_enable(timer);
+    if (err != ESP_OK) {
+        mcpwm_del_capture_timer(timer);
+        return err;
+    }
+    err = mcpwm_capture_timer_start(timer);
+    if (err != ESP_OK) {
+        mcpwm_capture_timer_disable(timer);
+        mcpwm_del_capture_timer(timer);
+        return err;
+    }
+    s_timers[group_id] = timer;
+    return ESP_OK;
+}
+
+static esp_err_t start_channel(hcsr04_t *sensor) {
+    mcpwm_cap_timer_handle_t timer = s_timers[sensor->config.group_id];
+    esp_err_t err =
+        mcpwm_capture_timer_get_resolution(timer, &sensor->resolution_hz);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mcpwm_capture_channel_config_t channel_config = {
+        .gpio_num = sensor->config.echo_io,
+        .prescale = 1,
+        .flags.pos_edge = true,
+        .flags.neg_edge = true,
+        .flags.pull_down = true,  // reads as no echo when unplugged
+    };
+    err = mcpwm_new_capture_channel(timer, &channel_config, &sensor->channel);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mcpwm_capture_event_callbacks_t callbacks = {.on_cap = on_capture};
+    err = mcpwm_capture_channel_register_event_callbacks(
+        sensor->channel, &callbacks, sensor);
+    if (err == ESP_OK) {
+        err = mcpwm_capture_channel_enable(sensor->channel);
+    }
+    if (err != ESP_OK) {
+        mcpwm_del_capture_channel(sensor->channel);
+    }
+    return err;
+}
+
+esp_err_t hcsr04_new(const hcsr04_config_t *config, hcsr04_t **out) {
+    if (config->group_id < 0 || config->group_id >= SOC_MCPWM_GROUPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gpio_config_t trig_config = {
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+        .pin_bit_mask = (1ULL << config->trig_io),
+    };
+    esp_err_t err = gpio_config(&trig_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure trigger GPIO %d",
+                 config->trig_io);
+        return err;
+    }
+    gpio_set_level(config->trig_io, 0);
+
+    hcsr04_t *sensor = calloc(1, sizeof(*sensor));
+    if (sensor == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor->config = *config;
+    sensor->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+
+    err = start_timer(config->group_id);
+    if (err == ESP_OK) {
+        err = start_channel(sensor);
+    }
+    if (err != ESP_OK) {
+        // ESP_ERR_NOT_FOUND: the group's capture channels are all taken
+        ESP_LOGE(TAG, "No capture channel for echo GPIO %d in group %d: %s",
+                 config->echo_io, config->group_id, esp_err_to_name(err));
+        free(sensor);
+        return err;
+    }
+    *out = sensor;
+    return ESP_OK;
+}
+
+static TickType_t ticks_for_us(int64_t us) {
+    return (TickType_t)((us * configTICK_RATE_HZ + 999999) / 1000000);
+}
+
+// Sleeps until esp_timer time due_us
+static void sleep_until(int64_t due_us) {
+    int64_t now;
+    while ((now = esp_timer_get_time()) < due_us) {
+        vTaskDelay(ticks_for_us(due_us - now));
+    }
+}
+
+esp_err_t hcsr04_measure(hcsr04_t *sensor, uint32_t *echo_us) {
+    sleep_until(sensor->last_trigger_us + sensor->config.min_cycle_us);
+
+    // After a timeout the sensor can still be holding the echo high
+    int64_t deadline = esp_timer_get_time() + sensor->config.timeout_us;
+    while (gpio_get_level(sensor->config.echo_io) == 1) {
+        if (esp_timer_get_time() > deadline) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        vTaskDelay(1);
+    }
+
+    xTaskNotifyStateClear(NULL);  // a late echo from an earlier ping
+    portENTER_CRITICAL(&sensor->lock);
+    sensor->high = false;
+    sensor->waiter = xTaskGetCurrentTaskHandle();
+    portEXIT_CRITICAL(&sensor->lock);
+
+    gpio_set_level(sensor->config.trig_io, 1);
+    esp_rom_delay_us(TRIG_PULSE_US);
+    gpio_set_level(sensor->config.trig_io, 0);
+    sensor->last_trigger_us = esp_timer_get_time();
+
+    // One tick more, so a tick boundary cannot cut the wait short
+    uint32_t count;
+    BaseType_t notified = xTaskNotifyWait(
+        0, UINT32_MAX, &count, ticks_for_us(sensor->config.timeout_us) + 1);
+    portENTER_CRITICAL(&sensor->lock);
+    sensor->waiter = NULL;
+    portEXIT_CRITICAL(&sensor->lock);
+    if (notified != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    *echo_us = (uint32_t)((uint64_t)count * 1000000 / sensor->resolution_hz);
+    return *echo_us > sensor->config.max_echo_us ? ESP_ERR_TIMEOUT : ESP_OK;
+}
@@ -0,0 +1,47 @@
+#ifndef HCSR04_H
+#define HCSR04_H
+
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+/* HC-SR04 style ranging with the echo timed in hardware. The echo pin
+ * feeds an MCPWM capture channel, which latches the capture timer on both
+ * edges; its ISR takes the difference and notifies the measuring task,
+ * which sleeps in the meantime instead of polling the pin. Each sensor
+ * has its own channel (three per MCPWM group, two groups on the ESP32),
+ * so one task per sensor measures them all in parallel. Sensors facing
+ * the same way hear each other's pings and should take turns. */
+typedef struct hcsr04 hcsr04_t;
+
+typedef struct {
+    gpio_num_t trig_io;
+    gpio_num_t echo_io;
+    int group_id;           // MCPWM group for the capture channel
+    uint32_t timeout_us;    // from the trigger to the end of the echo
+    uint32_t max_echo_us;   // longer echoes are misses, not distances
+    uint32_t min_cycle_us;  // trigger to trigger, so old echoes die out
+} hcsr04_config_t;
+
+#define HCSR04_DEFAULT_CONFIG() \
+    {                           \
+        .trig_io = GPIO_NUM_NC, \
+        .echo_io = GPIO_NUM_NC, \
+        .group_id = 0,          \
+        .timeout_us = 40000,    \
+        .max_echo_us = 25000,   \
+        .min_cycle_us = 60000,  \
+    }
+
+esp_err_t hcsr04_new(const hcsr04_config_t *config, hcsr04_t **sensor);
+
+/* Pings and blocks until the echo ends, at least min_cycle_us after the
+ * previous ping. ESP_ERR_TIMEOUT when nothing came back in time, or the
+ * echo ran past max_echo_us: an HC-SR04 that hears nothing still ends
+ * the echo, after ~38 ms, so timeout_us alone can't tell a miss from a
+ * distance. Uses the calling task's notification, and only one task may
+ * measure a given sensor. */
+esp_err_t hcsr04_measure(hcsr04_t *sensor, uint32_t *echo_us);
+
+#endif  // HCSR04_H
@@ -1,24 +1,48 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "driver/gpio.h"
+#include "components/hcsr04/hcsr04.h"
+#include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "rom/ets_sys.h"
+#include "sensor_log.h"
 
-#define TRIG_PIN GPIO_NUM_18
-#define ECHO_PIN GPIO_NUM_19
-#define SOUND_SPEED 0.034
-#define TIMEOUT_US 50000
+#define SOUND_SPEED 0.034  // cm/us
+#define TIMEOUT_US 40000   // HC-SR04 ends a missed echo after ~38 ms
+#define MAX_ECHO_US 25000  // ~4 m, the rated range; longer is a miss
 #define FILTER_SIZE 5
+#define PRINT_INTERVAL_US 500000
+#define LOG_STATS_INTERVAL_MS 10000
+
+static const char *TAG = "ULTRASONIC";
 
 typedef struct {
     float buffer[FILTER_SIZE];
     int index;
 } DistanceFilter;
 
-DistanceFilter filter = {{0}, 0};
+/* One row per sensor. Each gets its own task and MCPWM capture channel,
+ * three to a group, so up to six ping at their own full rate. */
+static const struct {
+    gpio_num_t trig;
+    gpio_num_t echo;
+} SENSOR_PINS[] = {
+    {GPIO_NUM_18, GPIO_NUM_19},
+};
+
+#define SENSOR_COUNT (sizeof(SENSOR_PINS) / sizeof(SENSOR_PINS[0]))
+
+typedef struct {
+    uint8_t index;
+    hcsr04_t *hcsr04;
+    DistanceFilter filter;
+    float filtered_cm;
+    uint32_t pings;  // read by the stats loop
+    uint32_t timeouts;
+} Sensor;
+
+static Sensor sensors[SENSOR_COUNT];
 
 static float get_median(float *buffer, int size) {
     float temp[FILTER_SIZE];
@@ -42,55 +66,73 @@ static float update_filter(DistanceFilter *f, float new_val) {
     return get_median(f->buffer, FILTER_SIZE);
 }
 
-void send_pulse() {
-    gpio_set_level(TRIG_PIN, 1);
-    esp_rom_delay_us(10);
-    gpio_set_level(TRIG_PIN, 0);
-}
+/* Pings back to back; the driver paces the pings and the task sleeps
+ * while the echo is timed in hardware */
+static void sensor_task(void *arg) {
+    Sensor *sensor = arg;
+    int64_t last_print = 0;
 
-uint32_t measure_pulse() {
-    uint32_t start_time = esp_timer_get_time();
-    uint32_t timeout_time = start_time + TIMEOUT_US;
-    while (gpio_get_level(ECHO_PIN) == 0) {
-        if (esp_timer_get_time() > timeout_time) {
-            return 0;
+    while (1) {
+        uint32_t echo_us;
+        esp_err_t err = hcsr04_measure(sensor->hcsr04, &echo_us);
+        int64_t now = esp_timer_get_time();
+        sensor->pings++;
+        if (err == ESP_OK) {
+            sensor->filtered_cm =
+                update_filter(&sensor->filter, echo_us * SOUND_SPEED / 2.0);
+        } else {
+            // Nothing in range: keep the last distance out of the median
+            sensor->timeouts++;
+            echo_us = 0;
         }
-    }
 
-    start_time = esp_timer_get_time();
-    timeout_time = start_time + TIMEOUT_US;
-    while (gpio_get_level(ECHO_PIN) == 1) {
-        if (esp_timer_get_time() > timeout_time) {
-            return 0;
+        sensor_log_range_t range = {
+            .sensor = sensor->index,
+            .echo_us = echo_us > UINT16_MAX ? UINT16_MAX : echo_us,
+            .filtered_mm = sensor->filtered_cm * 10,
+        };
+        sensor_log_write(SENSOR_LOG_RANGE, now, &range, sizeof(range));
+
+        if (now - last_print >= PRINT_INTERVAL_US) {
+            printf("Sensor %u Filtered Distance: %.2f cm\n", sensor->index,
+                   sensor->filtered_cm);
+            last_print = now;
         }
     }
-
-    return esp_timer_get_time() - start_time;
 }
 
 void app_main(void) {
-    gpio_config_t trig_config = {.mode = GPIO_MODE_OUTPUT,
-                                 .pull_up_en = GPIO_PULLUP_DISABLE,
-                                 .pull_down_en = GPIO_PULLDOWN_DISABLE,
-                                 .intr_type = GPIO_INTR_DISABLE,
-                                 .pin_bit_mask = (1ULL << TRIG_PIN)};
-    gpio_config(&trig_config);
-
-    gpio_config_t echo_config = {.mode = GPIO_MODE_INPUT,
-                                 .pull_up_en = GPIO_PULLUP_DISABLE,
-                                 .pull_down_en = GPIO_PULLDOWN_DISABLE,
-                                 .intr_type = GPIO_INTR_DISABLE,
-                                 .pin_bit_mask = (1ULL << ECHO_PIN)};
-    gpio_config(&echo_config);
-
-    while (1) {
-        send_pulse();
-        uint32_t pulse_duration = measure_pulse();
-        float distance = (pulse_duration * SOUND_SPEED) / 2.0;
+    sensor_log_config_t log_config = SENSOR_LOG_DEFAULT_CONFIG();
+    if (sensor_log_start(&log_config) != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor log unavailable");
+    }
 
-        float filtered_distance = update_filter(&filter, distance);
-        printf("Filtered Distance: %.2f cm\n", filtered_distance);
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        hcsr04_config_t config = HCSR04_DEFAULT_CONFIG();
+        config.trig_io = SENSOR_PINS[i].trig;
+        config.echo_io = SENSOR_PINS[i].echo;
+        config.group_id = i / 3;
+        config.timeout_us = TIMEOUT_US;
+        config.max_echo_us = MAX_ECHO_US;
+        sensors[i].index = i;
+        if (hcsr04_new(&config, &sensors[i].hcsr04) != ESP_OK) {
+            ESP_LOGE(TAG, "Sensor %u init failed", (unsigned)i);
+            continue;
+        }
+        xTaskCreate(sensor_task, "ultrasonic", 3072, &sensors[i], 5, NULL);
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+    uint32_t last_pings[SENSOR_COUNT] = {0};
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(LOG_STATS_INTERVAL_MS));
+        for (size_t i = 0; i < SENSOR_COUNT; i++) {
+            uint32_t pings = sensors[i].pings;
+            ESP_LOGI(TAG, "Sensor %u: %.1f pings/s, %lu timeouts",
+                     (unsigned)i,
+                     (pings - last_pings[i]) * 1000.0f / LOG_STATS_INTERVAL_MS,
+                     (unsigned long)sensors[i].timeouts);
+            last_pings[i] = pings;
+        }
+        sensor_log_print_stats();
     }
 }
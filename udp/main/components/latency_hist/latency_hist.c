@@ -0,0 +1,35 @@
+#include "latency_hist.h"
+
+#include <string.h>
+
+void latency_hist_record(latency_hist_t *hist, uint32_t us) {
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if (bucket >= LATENCY_HIST_BUCKETS) {
+        bucket = LATENCY_HIST_BUCKETS - 1;
+    }
+    hist->buckets[bucket]++;
+}
+
+void latency_hist_reset(latency_hist_t *hist) {
+    memset(hist->buckets, 0, sizeof(hist->buckets));
+}
+
+uint32_t latency_hist_count(const latency_hist_t *hist) {
+    uint32_t total = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        total += hist->buckets[i];
+    }
+    return total;
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percent) {
+    uint32_t target = (uint64_t)latency_hist_count(hist) * percent / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > target) {
+            return i == 0 ? 0 : (uint32_t)((1ull << i) - 1);
+        }
+    }
+    return UINT32_MAX;
+}
@@ -0,0 +1,21 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+/* Log2 latency histogram: bucket 0 counts 0us, bucket i counts
+ * [2^(i-1), 2^i - 1] us. The last bucket also takes everything above. */
+#define LATENCY_HIST_BUCKETS 32
+
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+} latency_hist_t;
+
+void latency_hist_record(latency_hist_t *hist, uint32_t us);
+void latency_hist_reset(latency_hist_t *hist);
+uint32_t latency_hist_count(const latency_hist_t *hist);
+
+// Upper bound (us) of the bucket holding the given percentile
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percent);
+
+#endif  // LATENCY_HIST_H
@@ -1,106 +1,475 @@
 #include "udp_server.h"
 
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
+#include "metrics.h"
+#include "robot_cmd_seq.h"
+
+#define UDP_RING_MASK (UDP_RING_SLOTS - 1)
+
+_Static_assert((UDP_RING_SLOTS & UDP_RING_MASK) == 0,
+               "UDP_RING_SLOTS must be a power of two");
+
+/* One bound socket with its receive task (producer) and consumer task.
+ * The slot ring between them is single-producer/single-consumer and
+ * lock-free: head is only written by the receive task, tail only by the
+ * consumer. */
+typedef struct {
+    uint16_t port;
+    int sock;
+    TaskHandle_t rx_task;
+    TaskHandle_t consumer_task;
+
+    udp_slot_t ring[UDP_RING_SLOTS];
+    atomic_uint ring_head;
+    atomic_uint ring_tail;
+
+    // Written by the receive task, read and cleared by the consumer
+    atomic_uint rx_packets;
+    atomic_uint ring_full_waits;
+    atomic_uint cmd_rejects[ROBOT_CMD_STATUS_COUNT];
+
+    // Receive-to-dispatch latency, owned by the consumer task
+    latency_hist_t dispatch_latency;
+} udp_listener_t;
 
 static const char* TAG = "udp_server";
-static int sock = -1;
-static TaskHandle_t udp_task_handle = NULL;
-
-static void udp_server_task(void* pvParameters) {
-    char rx_buffer[128];
-    char addr_str[128];
-    int addr_family = AF_INET;
-    int ip_protocol = IPPROTO_IP;
-    struct sockaddr_in dest_addr;
 
-    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(UDP_PORT);
+METRIC_COUNTER(rx_packets_metric, "udp_rx_packets_total",
+               "Datagrams received on all listeners");
+METRIC_COUNTER(cmd_rejected_metric, "udp_cmd_rejected_total",
+               "Command frames rejected by the decoder or dispatch table");
+METRIC_COUNTER(cmd_stale_metric, "udp_cmd_stale_total",
+               "Command frames dropped as stale or duplicate");
+METRIC_HISTOGRAM(dispatch_latency_metric, "udp_dispatch_latency_us",
+                 "Receive-to-dispatch latency in microseconds", 50, 100, 250,
+                 500, 1000, 2500, 5000, 10000);
 
-    sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-    if (sock < 0) {
-        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-        vTaskDelete(NULL);
+static udp_server_config_t server_config;
+static udp_listener_t* listeners[UDP_SERVER_MAX_LISTENERS];
+static size_t listener_count = 0;
+static volatile bool running = false;
+static SemaphoreHandle_t exit_sem = NULL;
+
+/* Sequence tracking and one-way latency, shared by all receive tasks and
+ * copied out by udp_server_get_cmd_stats() under cmd_stats_lock */
+static robot_cmd_seq_t cmd_seq;
+static latency_hist_t one_way_latency;
+static portMUX_TYPE cmd_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static udp_slot_t* ring_producer_slot(udp_listener_t* l) {
+    unsigned head = atomic_load_explicit(&l->ring_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&l->ring_tail, memory_order_acquire);
+    if (head - tail == UDP_RING_SLOTS) {
+        return NULL;
+    }
+    return &l->ring[head & UDP_RING_MASK];
+}
+
+static void ring_commit(udp_listener_t* l) {
+    unsigned head = atomic_load_explicit(&l->ring_head, memory_order_relaxed);
+    atomic_store_explicit(&l->ring_head, head + 1, memory_order_release);
+}
+
+static udp_slot_t* ring_consumer_slot(udp_listener_t* l) {
+    unsigned tail = atomic_load_explicit(&l->ring_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&l->ring_head, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    return &l->ring[tail & UDP_RING_MASK];
+}
+
+static void ring_release(udp_listener_t* l) {
+    unsigned tail = atomic_load_explicit(&l->ring_tail, memory_order_relaxed);
+    atomic_store_explicit(&l->ring_tail, tail + 1, memory_order_release);
+}
+
+static void report_stats(udp_listener_t* l, int64_t elapsed_us) {
+    uint32_t rx = atomic_exchange(&l->rx_packets, 0);
+    if (latency_hist_count(&l->dispatch_latency) > 0) {
+        ESP_LOGI(TAG, "port %u: %lu pkt/s, rx->dispatch p50<=%luus "
+                      "p99<=%luus, ring full waits %u",
+                 l->port, (unsigned long)((uint64_t)rx * 1000000 / elapsed_us),
+                 (unsigned long)latency_hist_percentile(&l->dispatch_latency,
+                                                        50),
+                 (unsigned long)latency_hist_percentile(&l->dispatch_latency,
+                                                        99),
+                 atomic_exchange(&l->ring_full_waits, 0));
+    }
+    latency_hist_reset(&l->dispatch_latency);
+
+    if (server_config.commands == NULL) {
         return;
     }
-    ESP_LOGI(TAG, "Socket created");
+    for (int i = ROBOT_CMD_OK + 1; i < ROBOT_CMD_STATUS_COUNT; i++) {
+        unsigned rejects = atomic_exchange(&l->cmd_rejects[i], 0);
+        if (rejects > 0) {
+            ESP_LOGW(TAG, "port %u: %u frames rejected: %s", l->port, rejects,
+                     robot_cmd_status_str(i));
+        }
+    }
 
-    int err = bind(sock, (struct sockaddr*)&dest_addr, sizeof(dest_addr));
-    if (err < 0) {
-        ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
-        close(sock);
-        vTaskDelete(NULL);
+    // Sequencing is shared, report it once
+    if (l != listeners[0]) {
         return;
     }
-    ESP_LOGI(TAG, "Socket bound, port %d", UDP_PORT);
+    udp_cmd_stats_t stats;
+    udp_server_get_cmd_stats(&stats);
+    if (latency_hist_count(&stats.one_way) > 0) {
+        ESP_LOGI(TAG, "commands: %lu applied, %lu stale, %lu lost, "
+                      "one-way p50<=%luus p99<=%luus",
+                 (unsigned long)stats.accepted,
+                 (unsigned long)(stats.stale + stats.duplicate),
+                 (unsigned long)stats.lost,
+                 (unsigned long)latency_hist_percentile(&stats.one_way, 50),
+                 (unsigned long)latency_hist_percentile(&stats.one_way, 99));
+    }
+}
 
-    while (1) {
-        struct sockaddr_storage source_addr;
-        socklen_t socklen = sizeof(source_addr);
-        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0,
-                          (struct sockaddr*)&source_addr, &socklen);
+static uint64_t sender_id(const struct sockaddr_storage* addr) {
+    if (addr->ss_family != PF_INET) {
+        return 0;
+    }
+    const struct sockaddr_in* in = (const struct sockaddr_in*)addr;
+    return ((uint64_t)in->sin_addr.s_addr << 16) | in->sin_port;
+}
 
-        if (len < 0) {
-            ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
-            break;
-        } else {
-            rx_buffer[len] = 0;
+/* Runs on the receive task: decode and sequence-check the frame so only
+ * in-order commands are queued. Returns false if the consumer has nothing
+ * to do with the slot. */
+static bool decode_slot(udp_listener_t* l, udp_slot_t* slot) {
+    slot->has_cmd = false;
 
-            if (source_addr.ss_family == PF_INET) {
-                inet_ntoa_r(((struct sockaddr_in*)&source_addr)->sin_addr,
-                           addr_str, sizeof(addr_str) - 1);
+    if (server_config.commands != NULL) {
+        robot_cmd_status_t status =
+            robot_cmd_decode(slot->data, slot->len, &slot->cmd);
+        if (status != ROBOT_CMD_OK) {
+            atomic_fetch_add(&l->cmd_rejects[status], 1);
+            metric_inc(&cmd_rejected_metric);
+        } else {
+            // Never apply a command older than one already applied
+            uint32_t one_way_us;
+            taskENTER_CRITICAL(&cmd_stats_lock);
+            slot->has_cmd =
+                robot_cmd_seq_check(&cmd_seq, sender_id(&slot->source_addr),
+                                    &slot->cmd, slot->rx_time_us,
+                                    &one_way_us) == ROBOT_CMD_SEQ_ACCEPT;
+            if (slot->has_cmd) {
+                latency_hist_record(&one_way_latency, one_way_us);
             }
+            taskEXIT_CRITICAL(&cmd_stats_lock);
+            if (!slot->has_cmd) {
+                metric_inc(&cmd_stale_metric);
+            }
+        }
+    }
+
+    return slot->has_cmd || server_config.handler != NULL ||
+           server_config.echo || server_config.log_packets;
+}
+
+static void handle_slot(udp_listener_t* l, const udp_slot_t* slot) {
+    if (server_config.log_packets) {
+        char addr_str[16] = "?";
+        if (slot->source_addr.ss_family == PF_INET) {
+            inet_ntoa_r(((struct sockaddr_in*)&slot->source_addr)->sin_addr,
+                        addr_str, sizeof(addr_str) - 1);
+        }
+        ESP_LOGI(TAG, "Received %d bytes from %s on port %u: %.*s",
+                 slot->len, addr_str, slot->port, slot->len,
+                 (const char*)slot->data);
+    }
+
+    if (slot->has_cmd) {
+        robot_cmd_status_t status =
+            robot_cmd_handle(server_config.commands, &slot->cmd);
+        if (status != ROBOT_CMD_OK) {
+            atomic_fetch_add(&l->cmd_rejects[status], 1);
+            metric_inc(&cmd_rejected_metric);
+        }
+    }
+
+    if (server_config.handler != NULL) {
+        server_config.handler(slot, server_config.handler_ctx);
+    }
+
+    if (server_config.echo) {
+        int err = sendto(l->sock, slot->data, slot->len, 0,
+                         (struct sockaddr*)&slot->source_addr,
+                         sizeof(slot->source_addr));
+        if (err < 0) {
+            ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+        }
+    }
+}
+
+static void udp_consumer_task(void* pvParameters) {
+    udp_listener_t* l = pvParameters;
+    int64_t last_report = esp_timer_get_time();
+
+    // Outlive the rx task, which notifies this one until it exits
+    while (running || l->rx_task != NULL) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(running ? UDP_STATS_INTERVAL_MS
+                                                       : UDP_RX_POLL_MS));
+
+        udp_slot_t* slot;
+        while ((slot = ring_consumer_slot(l)) != NULL) {
+            int64_t latency_us = esp_timer_get_time() - slot->rx_time_us;
+            latency_hist_record(&l->dispatch_latency, MAX(latency_us, 0));
+            metric_observe(&dispatch_latency_metric, MAX(latency_us, 0));
+            handle_slot(l, slot);
+            ring_release(l);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_report >= UDP_STATS_INTERVAL_MS * 1000LL) {
+            report_stats(l, now - last_report);
+            last_report = now;
+        }
+    }
+
+    l->consumer_task = NULL;
+    xSemaphoreGive(exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void udp_rx_task(void* pvParameters) {
+    udp_listener_t* l = pvParameters;
+
+    // Block for the first datagram of a batch, then drain the socket
+    // without blocking and wake the consumer once per batch.
+    bool draining = false;
+    while (running) {
+        udp_slot_t* slot = ring_producer_slot(l);
+        if (slot == NULL) {
+            // Consumer is behind; leave the rest queued in lwIP
+            atomic_fetch_add(&l->ring_full_waits, 1);
+            xTaskNotifyGive(l->consumer_task);
+            vTaskDelay(1);
+            continue;
+        }
 
-            ESP_LOGI(TAG, "Received %d bytes from %s:", len, addr_str);
-            ESP_LOGI(TAG, "%s", rx_buffer);
+        socklen_t socklen = sizeof(slot->source_addr);
+        int len = recvfrom(l->sock, slot->data, sizeof(slot->data),
+                           draining ? MSG_DONTWAIT : 0,
+                           (struct sockaddr*)&slot->source_addr, &socklen);
 
-            // Echo back the received data
-            int err = sendto(sock, rx_buffer, len, 0,
-                           (struct sockaddr*)&source_addr, sizeof(source_addr));
-            if (err < 0) {
-                ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                break;
+        if (len < 0) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                // Socket drained, or the poll timeout to check for stop
+                if (draining) {
+                    draining = false;
+                    xTaskNotifyGive(l->consumer_task);
+                }
+                continue;
             }
+            if (running) {
+                ESP_LOGE(TAG, "recvfrom failed on port %u: errno %d", l->port,
+                         errno);
+            }
+            break;
         }
+
+        slot->rx_time_us = esp_timer_get_time();
+        slot->port = l->port;
+        slot->len = len;
+        atomic_fetch_add(&l->rx_packets, 1);
+        metric_inc(&rx_packets_metric);
+        if (decode_slot(l, slot)) {
+            ring_commit(l);
+            draining = true;
+        }
+    }
+
+    // The consumer stays up until rx_task is cleared, so notify it first
+    xTaskNotifyGive(l->consumer_task);
+    l->rx_task = NULL;
+    xSemaphoreGive(exit_sem);
+    vTaskDelete(NULL);
+}
+
+static int open_socket(uint16_t port) {
+    struct sockaddr_in dest_addr;
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(port);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
     }
 
-    if (sock != -1) {
-        ESP_LOGE(TAG, "Shutting down socket");
-        shutdown(sock, 0);
+    // Bounded blocking so the receive task notices udp_server_stop()
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = UDP_RX_POLL_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int err = bind(sock, (struct sockaddr*)&dest_addr, sizeof(dest_addr));
+    if (err < 0) {
+        ESP_LOGE(TAG, "Socket unable to bind port %u: errno %d", port, errno);
         close(sock);
+        return -1;
     }
-    vTaskDelete(NULL);
+    ESP_LOGI(TAG, "Socket bound, port %u", port);
+    return sock;
 }
 
-esp_err_t udp_server_start(void) {
-    BaseType_t xReturned = xTaskCreate(udp_server_task, "udp_server",
-                                       4096, NULL, 5, &udp_task_handle);
+static esp_err_t listener_start(const udp_listener_config_t* config,
+                                udp_listener_t** out) {
+    udp_listener_t* l = calloc(1, sizeof(*l));
+    if (l == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate listener for port %u", config->port);
+        return ESP_ERR_NO_MEM;
+    }
+    l->port = config->port;
+    l->sock = open_socket(config->port);
+    *out = l;
+    if (l->sock < 0) {
+        return ESP_FAIL;
+    }
+
+    // Consumer first so the receive task always has someone to notify
+    BaseType_t xReturned = xTaskCreatePinnedToCore(
+        udp_consumer_task, "udp_consumer", server_config.task_stack_size, l,
+        server_config.consumer_priority, &l->consumer_task,
+        server_config.consumer_core);
     if (xReturned != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create UDP server task");
+        ESP_LOGE(TAG, "Failed to create UDP consumer task");
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "UDP server started on port %d", UDP_PORT);
+    xReturned = xTaskCreatePinnedToCore(
+        udp_rx_task, "udp_rx", server_config.task_stack_size, l,
+        server_config.rx_priority, &l->rx_task, config->rx_core);
+    if (xReturned != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create UDP receive task");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t udp_server_start(const udp_server_config_t* config) {
+    if (listener_count > 0) {
+        ESP_LOGE(TAG, "UDP server already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->listener_count == 0 ||
+        config->listener_count > UDP_SERVER_MAX_LISTENERS) {
+        ESP_LOGE(TAG, "Invalid listener count: %u",
+                 (unsigned)config->listener_count);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    metrics_register(&rx_packets_metric);
+    metrics_register(&cmd_rejected_metric);
+    metrics_register(&cmd_stale_metric);
+    metrics_register(&dispatch_latency_metric);
+
+    server_config = *config;
+    exit_sem = xSemaphoreCreateCounting(2 * UDP_SERVER_MAX_LISTENERS, 0);
+    if (exit_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to create UDP server semaphore");
+        return ESP_ERR_NO_MEM;
+    }
+
+    running = true;
+    for (size_t i = 0; i < config->listener_count; i++) {
+        esp_err_t err = listener_start(&config->listeners[i], &listeners[i]);
+        if (listeners[i] != NULL) {
+            listener_count = i + 1;
+        }
+        if (err != ESP_OK) {
+            udp_server_stop();
+            return err;
+        }
+    }
+
+    ESP_LOGI(TAG, "UDP server started on %u port(s) (echo %s, packet log %s)",
+             (unsigned)listener_count, config->echo ? "on" : "off",
+             config->log_packets ? "on" : "off");
     return ESP_OK;
 }
 
+void udp_server_get_cmd_stats(udp_cmd_stats_t* stats) {
+    taskENTER_CRITICAL(&cmd_stats_lock);
+    stats->accepted = cmd_seq.accepted;
+    stats->stale = cmd_seq.stale;
+    stats->duplicate = cmd_seq.duplicate;
+    stats->lost = cmd_seq.lost;
+    stats->reordered = cmd_seq.reordered;
+    stats->resyncs = cmd_seq.resyncs;
+    stats->one_way = one_way_latency;
+    taskEXIT_CRITICAL(&cmd_stats_lock);
+}
+
+void udp_server_reset_cmd_stats(void) {
+    taskENTER_CRITICAL(&cmd_stats_lock);
+    cmd_seq.accepted = 0;
+    cmd_seq.stale = 0;
+    cmd_seq.duplicate = 0;
+    cmd_seq.lost = 0;
+    cmd_seq.reordered = 0;
+    cmd_seq.resyncs = 0;
+    latency_hist_reset(&one_way_latency);
+    taskEXIT_CRITICAL(&cmd_stats_lock);
+}
+
 void udp_server_stop(void) {
-    if (udp_task_handle != NULL) {
-        vTaskDelete(udp_task_handle);
-        udp_task_handle = NULL;
+    running = false;
+
+    // Shut the sockets down first so blocked receives return, then wait
+    // for every task to exit on its own. Deleting one could leave it mid
+    // lwIP call or holding cmd_stats_lock, and it still signals exit_sem.
+    int tasks = 0;
+    for (size_t i = 0; i < listener_count; i++) {
+        udp_listener_t* l = listeners[i];
+        if (l->sock != -1) {
+            shutdown(l->sock, SHUT_RDWR);
+        }
+        if (l->rx_task != NULL) {
+            tasks++;
+        }
+        if (l->consumer_task != NULL) {
+            xTaskNotifyGive(l->consumer_task);
+            tasks++;
+        }
     }
-    if (sock != -1) {
-        shutdown(sock, 0);
-        close(sock);
-        sock = -1;
+
+    while (tasks > 0) {
+        if (xSemaphoreTake(exit_sem, pdMS_TO_TICKS(2 * UDP_RX_POLL_MS)) ==
+            pdTRUE) {
+            tasks--;
+        } else {
+            ESP_LOGW(TAG, "Waiting for %d UDP server task(s) to exit", tasks);
+        }
+    }
+
+    for (size_t i = 0; i < listener_count; i++) {
+        udp_listener_t* l = listeners[i];
+        if (l->sock != -1) {
+            close(l->sock);
+        }
+        free(l);
+        listeners[i] = NULL;
+    }
+    listener_count = 0;
+
+    if (exit_sem != NULL) {
+        vSemaphoreDelete(exit_sem);
+        exit_sem = NULL;
     }
     ESP_LOGI(TAG, "UDP server stopped");
 }
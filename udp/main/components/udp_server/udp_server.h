@@ -1,11 +1,105 @@
 #ifndef UDP_SERVER_H
 #define UDP_SERVER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "components/latency_hist/latency_hist.h"
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "robot_cmd.h"
+#include "lwip/sockets.h"
 
 #define UDP_PORT 3333
+#define UDP_SERVER_MAX_LISTENERS 4
+
+/* Receive ring: every datagram is received straight into one of these
+ * preallocated slots and handed to the consumer by pointer. Each listener
+ * has its own ring. */
+#define UDP_SLOT_SIZE 128
+#define UDP_RING_SLOTS 32  // must be a power of two
+
+#define UDP_STATS_INTERVAL_MS 5000
+#define UDP_RX_POLL_MS 200  // how often a blocked receive checks for stop
+
+/* Keep the receive tasks next to the Wi-Fi/lwIP tasks on core 0 and leave
+ * core 1 to the consumers and the control loop. */
+#if CONFIG_FREERTOS_UNICORE
+#define UDP_SERVER_RX_CORE tskNO_AFFINITY
+#define UDP_SERVER_CONSUMER_CORE tskNO_AFFINITY
+#else
+#define UDP_SERVER_RX_CORE 0
+#define UDP_SERVER_CONSUMER_CORE 1
+#endif
+
+typedef struct {
+    struct sockaddr_storage source_addr;
+    int64_t rx_time_us;
+    uint16_t port;  // local port the datagram arrived on
+    uint16_t len;
+    uint8_t data[UDP_SLOT_SIZE];
+    bool has_cmd;  // cmd holds a decoded, in-sequence command
+    robot_cmd_t cmd;
+} udp_slot_t;
+
+/* Called from a consumer task for every received datagram. The slot is
+ * only valid until the handler returns. */
+typedef void (*udp_rx_handler_t)(const udp_slot_t* slot, void* ctx);
 
-esp_err_t udp_server_start(void);
+typedef struct {
+    uint16_t port;
+    BaseType_t rx_core;  // core for the receive task, or tskNO_AFFINITY
+} udp_listener_config_t;
+
+typedef struct {
+    udp_listener_config_t listeners[UDP_SERVER_MAX_LISTENERS];
+    size_t listener_count;
+    BaseType_t consumer_core;  // core for the consumer tasks
+    UBaseType_t rx_priority;
+    UBaseType_t consumer_priority;
+    uint32_t task_stack_size;
+
+    const robot_cmd_table_t* commands;  // decode datagrams as command frames
+    udp_rx_handler_t handler;           // raw datagram hook
+    void* handler_ctx;
+    bool echo;         // send every datagram back to its sender
+    bool log_packets;  // log every datagram (slow, debugging only)
+} udp_server_config_t;
+
+#define UDP_SERVER_DEFAULT_CONFIG()                                \
+    {                                                              \
+        .listeners = {{.port = UDP_PORT,                           \
+                       .rx_core = UDP_SERVER_RX_CORE}},            \
+        .listener_count = 1,                                       \
+        .consumer_core = UDP_SERVER_CONSUMER_CORE,                 \
+        .rx_priority = 6,                                          \
+        .consumer_priority = 5,                                    \
+        .task_stack_size = 4096,                                   \
+        .commands = NULL,                                          \
+        .handler = NULL,                                           \
+        .handler_ctx = NULL,                                       \
+        .echo = false,                                             \
+        .log_packets = false,                                      \
+    }
+
+/* Command sequencing counters since start (or the last reset) and the
+ * one-way latency histogram of applied commands */
+typedef struct {
+    uint32_t accepted;
+    uint32_t stale;
+    uint32_t duplicate;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t resyncs;
+    latency_hist_t one_way;
+} udp_cmd_stats_t;
+
+esp_err_t udp_server_start(const udp_server_config_t* config);
 void udp_server_stop(void);
 
+void udp_server_get_cmd_stats(udp_cmd_stats_t* stats);
+void udp_server_reset_cmd_stats(void);
+
 #endif // UDP_SERVER_H
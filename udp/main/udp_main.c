@@ -10,6 +10,39 @@
 
 static const char* TAG = "UDP_MAIN";
 
+static void on_stop(const robot_cmd_t* cmd, void* ctx) {
+    ESP_LOGD(TAG, "STOP seq=%u", cmd->seq);
+}
+
+static void on_drive(const robot_cmd_t* cmd, void* ctx) {
+    int16_t left = (int16_t)(cmd->payload[0] | (cmd->payload[1] << 8));
+    int16_t right = (int16_t)(cmd->payload[2] | (cmd->payload[3] << 8));
+    ESP_LOGD(TAG, "DRIVE seq=%u left=%d right=%d", cmd->seq, left, right);
+}
+
+// Ping from udp_ping.py; the echo is the reply
+static void on_nop(const robot_cmd_t* cmd, void* ctx) {}
+
+#if CONFIG_UDP_REMOTE_WIFI_PROFILE
+static void on_wifi_profile(const robot_cmd_t* cmd, void* ctx) {
+    if (cmd->payload_len < 1 || wifi_set_profile(cmd->payload[0]) != ESP_OK) {
+        ESP_LOGW(TAG, "Rejected Wi-Fi profile change seq=%u", cmd->seq);
+    }
+}
+#endif
+
+static const robot_cmd_table_t command_table = {
+    .handlers =
+        {
+            [ROBOT_CMD_NOP] = on_nop,
+            [ROBOT_CMD_STOP] = on_stop,
+            [ROBOT_CMD_DRIVE] = on_drive,
+#if CONFIG_UDP_REMOTE_WIFI_PROFILE
+            [ROBOT_CMD_WIFI_PROFILE] = on_wifi_profile,
+#endif
+        },
+};
+
 void app_main() {
     esp_err_t nvs_err = nvs_flash_init();
     if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES ||
@@ -19,15 +52,21 @@ void app_main() {
     }
     ESP_ERROR_CHECK(nvs_err);
 
+    // The socket is bound to INADDR_ANY and starts receiving once the
+    // station gets an address
     ESP_LOGI(TAG, "Connecting to wi-fi ESP_WIFI_MODE_STA...");
-    wifi_status_t status = wifi_init_sta();
-    if (status == WIFI_STATUS_FAIL) {
-        ESP_LOGE(TAG, "Wi-Fi connection failed. Stopping execution.");
+    if (wifi_start_async() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi failed to start. Stopping execution.");
         return;
     }
 
     ESP_LOGI(TAG, "Starting UDP server...");
-    esp_err_t udp_err = udp_server_start();
+    udp_server_config_t udp_config = UDP_SERVER_DEFAULT_CONFIG();
+    udp_config.commands = &command_table;
+#if CONFIG_UDP_SERVER_ECHO
+    udp_config.echo = true;
+#endif
+    esp_err_t udp_err = udp_server_start(&udp_config);
     if (udp_err != ESP_OK) {
         ESP_LOGE(TAG, "UDP server initialization failed. Stopping execution.");
         return;
@@ -0,0 +1,385 @@
+/* Host checks and throughput benchmark for the robot_cmd codec.
+ *
+ *   cc -O2 -Wall -Wextra -I../../components/robot_cmd robot_cmd_bench.c \
+ *       ../../components/robot_cmd/robot_cmd.c \
+ *       ../../components/robot_cmd/robot_cmd_seq.c -o robot_cmd_bench
+ *   ./robot_cmd_bench [frames]
+ *
+ * Runs the codec checks first (lengths, CRC, opcode bounds, field round
+ * trips, every robot_cmd_status_t) and the sequence checks (late, stale,
+ * duplicate and restarted senders), and exits non-zero if any fails, then
+ * times encode and dispatch over [frames] frames.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "robot_cmd.h"
+#include "robot_cmd_seq.h"
+
+#define FRAME_POOL 256
+
+static int failures;
+static bool status_seen[ROBOT_CMD_STATUS_COUNT];
+
+#define CHECK(cond)                                               \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                           \
+        }                                                         \
+    } while (0)
+
+// Checks a status and remembers it was produced
+#define CHECK_STATUS(expr, expected)                      \
+    do {                                                  \
+        robot_cmd_status_t status_ = (expr);              \
+        CHECK(status_ == (expected));                     \
+        if (status_ < ROBOT_CMD_STATUS_COUNT) {           \
+            status_seen[status_] = true;                  \
+        }                                                 \
+    } while (0)
+
+typedef struct {
+    robot_cmd_t last;
+    uint32_t calls;
+} capture_t;
+
+static void capture(const robot_cmd_t *cmd, void *ctx) {
+    capture_t *c = ctx;
+    c->last = *cmd;
+    c->calls++;
+}
+
+static capture_t captured;
+
+// ROBOT_CMD_WIFI_PROFILE is left out: a valid opcode with no handler
+static const robot_cmd_table_t check_table = {
+    .handlers =
+        {
+            [ROBOT_CMD_NOP] = capture,
+            [ROBOT_CMD_STOP] = capture,
+            [ROBOT_CMD_DRIVE] = capture,
+        },
+    .ctx = &captured,
+};
+
+static void encode_raw(uint8_t opcode, uint8_t payload_len,
+                       uint8_t *frame) {
+    robot_cmd_t cmd = {.opcode = opcode, .payload_len = payload_len};
+    robot_cmd_encode(&cmd, frame);
+    // encode clamps the length, so patch it in and re-seal the frame
+    frame[1] = payload_len;
+    uint16_t crc = robot_cmd_crc16(frame, ROBOT_CMD_FRAME_SIZE - 2);
+    frame[ROBOT_CMD_FRAME_SIZE - 2] = crc & 0xff;
+    frame[ROBOT_CMD_FRAME_SIZE - 1] = crc >> 8;
+}
+
+static void check_crc(void) {
+    // CRC-16/CCITT-FALSE check value
+    CHECK(robot_cmd_crc16((const uint8_t *)"123456789", 9) == 0x29b1);
+    CHECK(robot_cmd_crc16(NULL, 0) == 0xffff);
+}
+
+static void check_length(void) {
+    uint8_t frame[ROBOT_CMD_FRAME_SIZE + 1] = {0};
+    robot_cmd_t cmd;
+    encode_raw(ROBOT_CMD_NOP, 0, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE, &cmd),
+                 ROBOT_CMD_OK);
+    CHECK_STATUS(robot_cmd_decode(frame, 0, &cmd), ROBOT_CMD_ERR_LENGTH);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE - 1, &cmd),
+                 ROBOT_CMD_ERR_LENGTH);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE + 1, &cmd),
+                 ROBOT_CMD_ERR_LENGTH);
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame,
+                                    ROBOT_CMD_FRAME_SIZE - 1),
+                 ROBOT_CMD_ERR_LENGTH);
+
+    // A payload length past the frame, even with a valid CRC
+    encode_raw(ROBOT_CMD_DRIVE, ROBOT_CMD_MAX_PAYLOAD, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE, &cmd),
+                 ROBOT_CMD_OK);
+    encode_raw(ROBOT_CMD_DRIVE, ROBOT_CMD_MAX_PAYLOAD + 1, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE, &cmd),
+                 ROBOT_CMD_ERR_LENGTH);
+    encode_raw(ROBOT_CMD_DRIVE, 0xff, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, ROBOT_CMD_FRAME_SIZE, &cmd),
+                 ROBOT_CMD_ERR_LENGTH);
+}
+
+static void check_corruption(void) {
+    robot_cmd_t cmd = {.opcode = ROBOT_CMD_DRIVE,
+                       .payload_len = 4,
+                       .seq = 0x1234,
+                       .timestamp_us = 0xdeadbeef,
+                       .payload = {1, 2, 3, 4}};
+    uint8_t frame[ROBOT_CMD_FRAME_SIZE];
+    robot_cmd_encode(&cmd, frame);
+
+    // Any single bit flip, CRC bytes included, is caught
+    for (int byte = 0; byte < ROBOT_CMD_FRAME_SIZE; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t bad[ROBOT_CMD_FRAME_SIZE];
+            memcpy(bad, frame, sizeof(bad));
+            bad[byte] ^= 1u << bit;
+            robot_cmd_t out;
+            robot_cmd_status_t status =
+                robot_cmd_decode(bad, sizeof(bad), &out);
+            // The length byte is range-checked before the CRC
+            CHECK(status == ROBOT_CMD_ERR_CRC ||
+                  (byte == 1 && status == ROBOT_CMD_ERR_LENGTH));
+        }
+    }
+    frame[8] ^= 0x01;
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame, sizeof(frame)),
+                 ROBOT_CMD_ERR_CRC);
+}
+
+static void check_opcode(void) {
+    uint8_t frame[ROBOT_CMD_FRAME_SIZE];
+    robot_cmd_t cmd;
+
+    // Past the end of the handler table
+    encode_raw(ROBOT_CMD_OP_COUNT, 0, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, sizeof(frame), &cmd),
+                 ROBOT_CMD_ERR_OPCODE);
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame, sizeof(frame)),
+                 ROBOT_CMD_ERR_OPCODE);
+    encode_raw(0xff, 0, frame);
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame, sizeof(frame)),
+                 ROBOT_CMD_ERR_OPCODE);
+
+    // robot_cmd_handle bounds-checks commands that did not come from decode
+    robot_cmd_t bogus = {.opcode = ROBOT_CMD_OP_COUNT};
+    CHECK_STATUS(robot_cmd_handle(&check_table, &bogus),
+                 ROBOT_CMD_ERR_OPCODE);
+    bogus.opcode = 0xff;
+    CHECK_STATUS(robot_cmd_handle(&check_table, &bogus),
+                 ROBOT_CMD_ERR_OPCODE);
+
+    // Known, but the table has no handler for it
+    captured.calls = 0;
+    encode_raw(ROBOT_CMD_WIFI_PROFILE, 1, frame);
+    CHECK_STATUS(robot_cmd_decode(frame, sizeof(frame), &cmd),
+                 ROBOT_CMD_OK);
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame, sizeof(frame)),
+                 ROBOT_CMD_ERR_OPCODE);
+    CHECK(captured.calls == 0);
+}
+
+static void check_round_trip(void) {
+    for (int op = 0; op < ROBOT_CMD_OP_COUNT; op++) {
+        for (int len = 0; len <= ROBOT_CMD_MAX_PAYLOAD; len++) {
+            robot_cmd_t in = {.opcode = (uint8_t)op,
+                              .payload_len = (uint8_t)len,
+                              .seq = (uint16_t)(0xfff0 + len),
+                              .timestamp_us = 0xfffffff0u + (uint32_t)op};
+            for (int i = 0; i < ROBOT_CMD_MAX_PAYLOAD; i++) {
+                in.payload[i] = (uint8_t)(0xa0 + i);  // padding must clear
+            }
+            uint8_t frame[ROBOT_CMD_FRAME_SIZE];
+            robot_cmd_encode(&in, frame);
+
+            robot_cmd_t out;
+            memset(&out, 0x55, sizeof(out));
+            CHECK_STATUS(robot_cmd_decode(frame, sizeof(frame), &out),
+                         ROBOT_CMD_OK);
+            CHECK(out.opcode == in.opcode);
+            CHECK(out.payload_len == in.payload_len);
+            CHECK(out.seq == in.seq);
+            CHECK(out.timestamp_us == in.timestamp_us);
+            CHECK(memcmp(out.payload, in.payload, len) == 0);
+            for (int i = len; i < ROBOT_CMD_MAX_PAYLOAD; i++) {
+                CHECK(out.payload[i] == 0);
+            }
+        }
+    }
+
+    // Little-endian on the wire, whatever the host
+    robot_cmd_t in = {.opcode = ROBOT_CMD_DRIVE,
+                      .payload_len = 4,
+                      .seq = 0x0102,
+                      .timestamp_us = 0x03040506,
+                      .payload = {0x01, 0xfc, 0xff, 0x03}};  // -1023, 1023
+    uint8_t frame[ROBOT_CMD_FRAME_SIZE];
+    robot_cmd_encode(&in, frame);
+    CHECK(frame[0] == ROBOT_CMD_DRIVE && frame[1] == 4);
+    CHECK(frame[2] == 0x02 && frame[3] == 0x01);
+    CHECK(frame[4] == 0x06 && frame[7] == 0x03);
+
+    // Through the table, to the right handler with the table's context
+    captured.calls = 0;
+    CHECK_STATUS(robot_cmd_dispatch(&check_table, frame, sizeof(frame)),
+                 ROBOT_CMD_OK);
+    CHECK(captured.calls == 1);
+    CHECK(captured.last.opcode == ROBOT_CMD_DRIVE);
+    CHECK(captured.last.seq == 0x0102);
+    int16_t left = (int16_t)(captured.last.payload[0] |
+                             captured.last.payload[1] << 8);
+    int16_t right = (int16_t)(captured.last.payload[2] |
+                              captured.last.payload[3] << 8);
+    CHECK(left == -1023 && right == 1023);
+
+    // An oversized length is clamped on encode
+    in.payload_len = ROBOT_CMD_MAX_PAYLOAD + 5;
+    robot_cmd_encode(&in, frame);
+    robot_cmd_t out;
+    CHECK_STATUS(robot_cmd_decode(frame, sizeof(frame), &out),
+                 ROBOT_CMD_OK);
+    CHECK(out.payload_len == ROBOT_CMD_MAX_PAYLOAD);
+}
+
+static void check_statuses(void) {
+    for (int s = 0; s < ROBOT_CMD_STATUS_COUNT; s++) {
+        if (!status_seen[s]) {
+            printf("FAIL: %s never returned\n",
+                   robot_cmd_status_str((robot_cmd_status_t)s));
+            failures++;
+        }
+        CHECK(strcmp(robot_cmd_status_str((robot_cmd_status_t)s),
+                     "unknown") != 0);
+    }
+    CHECK(strcmp(robot_cmd_status_str(ROBOT_CMD_STATUS_COUNT), "unknown") ==
+          0);
+}
+
+#define SENDER_CLOCK_US 5000000  // how far the sender's clock is behind
+
+static robot_cmd_seq_verdict_t seq_frame(robot_cmd_seq_t *seq, uint16_t n,
+                                         int64_t sent_us, int64_t now_us) {
+    robot_cmd_t cmd = {.opcode = ROBOT_CMD_DRIVE,
+                       .seq = n,
+                       .timestamp_us = (uint32_t)(sent_us - SENDER_CLOCK_US)};
+    uint32_t one_way;
+    return robot_cmd_seq_check(seq, 1, &cmd, now_us, &one_way);
+}
+
+static void check_seq(void) {
+    robot_cmd_seq_t seq = {0};
+    const int64_t tick = 10000;  // 100 Hz
+    int64_t t = 10000000;
+
+    CHECK(seq_frame(&seq, 1000, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    t += tick;
+    CHECK(seq_frame(&seq, 1000, t, t) == ROBOT_CMD_SEQ_DUPLICATE);
+    int64_t gap_sent = t += tick;
+    CHECK(seq_frame(&seq, 1002, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    CHECK(seq.lost == 1);
+
+    // Late within the window: dropped, and fills the gap it left
+    t += tick;
+    CHECK(seq_frame(&seq, 1001, gap_sent - tick / 2, t) ==
+          ROBOT_CMD_SEQ_STALE);
+    CHECK(seq.reordered == 1 && seq.lost == 0);
+
+    /* N+100, then N sent before it: a delayed command, not a restart. It
+     * must not reach the handler, nor skew the stats for the next one. */
+    int64_t old_sent = t;
+    t += tick;
+    CHECK(seq_frame(&seq, 1100, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    uint32_t lost = seq.lost;
+    t += tick;
+    CHECK(seq_frame(&seq, 1000, old_sent, t) == ROBOT_CMD_SEQ_STALE);
+    CHECK(seq.resyncs == 0 && seq.reordered == 1);
+    t += tick;
+    CHECK(seq_frame(&seq, 1101, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    CHECK(seq.lost == lost);
+
+    // Restarts: seq 0, a count behind but sent later, then silence
+    t += tick;
+    CHECK(seq_frame(&seq, 0, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    CHECK(seq.resyncs == 1);
+    t += tick;
+    CHECK(seq_frame(&seq, 500, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    t += tick;
+    CHECK(seq_frame(&seq, 7, t, t) == ROBOT_CMD_SEQ_ACCEPT);
+    CHECK(seq.resyncs == 2);
+    t += ROBOT_CMD_SEQ_IDLE_US;
+    CHECK(seq_frame(&seq, 3, 0, t) == ROBOT_CMD_SEQ_ACCEPT);
+    CHECK(seq.resyncs == 3);
+}
+
+/* ---- Benchmark ---- */
+
+static void on_command(const robot_cmd_t *cmd, void *ctx) {
+    *(volatile uint32_t *)ctx += cmd->seq;
+}
+
+static uint32_t handled;
+
+static const robot_cmd_table_t table = {
+    .handlers =
+        {
+            [ROBOT_CMD_NOP] = on_command,
+            [ROBOT_CMD_STOP] = on_command,
+            [ROBOT_CMD_DRIVE] = on_command,
+        },
+    .ctx = &handled,
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, long frames, double elapsed) {
+    printf("%-10s %10.0f frames/s  %7.1f ns/frame  %7.1f MB/s\n", name,
+           frames / elapsed, elapsed * 1e9 / frames,
+           frames * (double)ROBOT_CMD_FRAME_SIZE / elapsed / 1e6);
+}
+
+static void bench(long frames) {
+    static uint8_t pool[FRAME_POOL][ROBOT_CMD_FRAME_SIZE];
+
+    robot_cmd_t cmd = {.opcode = ROBOT_CMD_DRIVE, .payload_len = 4};
+    double start = now_sec();
+    for (long i = 0; i < frames; i++) {
+        cmd.seq = (uint16_t)i;
+        cmd.timestamp_us = (uint32_t)i * 5000;
+        cmd.payload[0] = (uint8_t)i;
+        robot_cmd_encode(&cmd, pool[i % FRAME_POOL]);
+    }
+    report("encode", frames, now_sec() - start);
+
+    long rejected = 0;
+    start = now_sec();
+    for (long i = 0; i < frames; i++) {
+        if (robot_cmd_dispatch(&table, pool[i % FRAME_POOL],
+                               ROBOT_CMD_FRAME_SIZE) != ROBOT_CMD_OK) {
+            rejected++;
+        }
+    }
+    report("dispatch", frames, now_sec() - start);
+    if (rejected > 0) {
+        printf("FAIL: %ld valid frames rejected\n", rejected);
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    long frames = argc > 1 ? atol(argv[1]) : 10000000;
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 2;
+    }
+
+    check_crc();
+    check_length();
+    check_corruption();
+    check_opcode();
+    check_round_trip();
+    check_statuses();
+    check_seq();
+    if (failures > 0) {
+        printf("Checks FAILED (%d)\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+
+    bench(frames);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""UDP load generator for the udp project.
+
+Sends DRIVE command frames (see robot_cmd.h) to the board at a target rate
+and reports the achieved packets/sec. If the server runs with echo enabled,
+echoed frames are matched by sequence number and the round-trip p50/p99 is
+reported too. The board itself logs packets/sec and the p99
+receive-to-dispatch latency every UDP_STATS_INTERVAL_MS.
+
+    python3 udp_load.py 192.168.1.50 --rate 500 --duration 10
+"""
+
+import argparse
+import binascii
+import select
+import socket
+import struct
+import time
+
+# opcode, payload length, sequence, timestamp (us), payload
+FRAME = struct.Struct("<BBHI16s")
+OP_DRIVE = 2
+
+
+def encode_drive(seq, timestamp_us, left, right):
+    payload = struct.pack("<hh", left, right)
+    frame = FRAME.pack(OP_DRIVE, len(payload), seq & 0xFFFF,
+                       timestamp_us & 0xFFFFFFFF, payload)
+    # CRC-16/CCITT-FALSE, as robot_cmd_crc16()
+    return frame + struct.pack("<H", binascii.crc_hqx(frame, 0xFFFF))
+
+
+def percentile(values, pct):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=3333)
+    parser.add_argument("--rate", type=float, default=200.0, help="packets/sec")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds")
+    parser.add_argument("--speed", type=int, default=512, help="drive duty")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setblocking(False)
+    dest = (args.host, args.port)
+
+    interval = 1.0 / args.rate
+    sent = 0
+    rtts = []
+    pending = {}  # sequence -> send time (ns)
+    start = time.perf_counter()
+    next_send = start
+    end = start + args.duration
+
+    # Keep listening briefly after the last send to collect late echoes
+    while time.perf_counter() < end + 0.5:
+        now = time.perf_counter()
+        if now < end and now >= next_send:
+            sent_ns = time.perf_counter_ns()
+            pending[sent & 0xFFFF] = sent_ns
+            sock.sendto(encode_drive(sent, sent_ns // 1000, args.speed,
+                                     args.speed), dest)
+            sent += 1
+            next_send += interval
+            continue
+
+        timeout = max(0.0, min(next_send, end + 0.5) - now)
+        readable, _, _ = select.select([sock], [], [], timeout)
+        while readable:
+            try:
+                data, _ = sock.recvfrom(2048)
+            except BlockingIOError:
+                break
+            if len(data) >= FRAME.size:
+                _, _, seq, _, _ = FRAME.unpack_from(data)
+                sent_ns = pending.pop(seq, None)
+                if sent_ns is not None:
+                    rtts.append((time.perf_counter_ns() - sent_ns) / 1000.0)
+
+    elapsed = min(time.perf_counter(), end) - start
+    print(f"sent      {sent} packets in {elapsed:.2f}s ({sent / elapsed:.0f} pkt/s)")
+    if rtts:
+        print(f"echoed    {len(rtts)} packets ({len(rtts) / elapsed:.0f} pkt/s, "
+              f"{100.0 * (sent - len(rtts)) / sent:.1f}% lost)")
+        print(f"rtt       p50 {percentile(rtts, 50):.0f}us "
+              f"p99 {percentile(rtts, 99):.0f}us max {max(rtts):.0f}us")
+    else:
+        print("no echoes received (server echo disabled?)")
+
+
+if __name__ == "__main__":
+    main()
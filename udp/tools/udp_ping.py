@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""UDP round-trip time per Wi-Fi profile for the udp project.
+
+Sends NOP command frames (see robot_cmd.h) to the board at a fixed
+interval and times their echoes (UDP_SERVER_ECHO, on by default). With
+--profiles, each named Wi-Fi profile is selected first with a
+WIFI_PROFILE frame and given --settle seconds to take effect, so the RTT
+distributions can be compared side by side.
+The board only acts on it with UDP_REMOTE_WIFI_PROFILE enabled in
+menuconfig (off by default); otherwise the frame is echoed but ignored.
+
+    python3 udp_ping.py 192.168.1.50 --profiles low-latency,balanced,low-power
+"""
+
+import argparse
+import binascii
+import math
+import select
+import socket
+import struct
+import time
+
+# opcode, payload length, sequence, timestamp (us), payload
+FRAME = struct.Struct("<BBHI16s")
+OP_NOP = 0
+OP_WIFI_PROFILE = 3
+
+# wifi_profile_t
+PROFILES = {"low-latency": 0, "balanced": 1, "low-power": 2}
+
+# Histogram bucket upper bounds in ms
+BUCKETS_MS = [1, 2, 5, 10, 20, 50, 100, 200, 500]
+
+
+class Pinger:
+    def __init__(self, host, port):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setblocking(False)
+        self.dest = (host, port)
+        self.seq = 0
+
+    def send(self, opcode, payload=b""):
+        seq = self.seq & 0xFFFF
+        self.seq += 1
+        frame = FRAME.pack(opcode, len(payload), seq,
+                           (time.perf_counter_ns() // 1000) & 0xFFFFFFFF,
+                           payload)
+        # CRC-16/CCITT-FALSE, as robot_cmd_crc16()
+        self.sock.sendto(frame + struct.pack("<H",
+                                             binascii.crc_hqx(frame, 0xFFFF)),
+                         self.dest)
+        return seq
+
+    def receive(self, timeout):
+        """Yields the sequence numbers echoed within timeout seconds."""
+        readable, _, _ = select.select([self.sock], [], [], timeout)
+        while readable:
+            try:
+                data, _ = self.sock.recvfrom(2048)
+            except BlockingIOError:
+                return
+            if len(data) >= FRAME.size:
+                yield FRAME.unpack_from(data)[2]
+
+    def set_profile(self, name, attempts=5):
+        """Returns True once the board echoed the profile frame."""
+        for _ in range(attempts):
+            seq = self.send(OP_WIFI_PROFILE, bytes([PROFILES[name]]))
+            deadline = time.perf_counter() + 0.5
+            while time.perf_counter() < deadline:
+                if seq in self.receive(deadline - time.perf_counter()):
+                    return True
+        return False
+
+    def ping(self, count, interval, timeout):
+        """Returns the RTTs in ms of the echoed pings and the number sent."""
+        rtts = []
+        pending = {}  # sequence -> send time (ns)
+        next_send = time.perf_counter()
+        sent = 0
+        end = None
+        while end is None or time.perf_counter() < end:
+            now = time.perf_counter()
+            if sent < count and now >= next_send:
+                pending[self.send(OP_NOP)] = time.perf_counter_ns()
+                sent += 1
+                next_send += interval
+                if sent == count:
+                    end = now + timeout
+                continue
+            wait = (next_send if sent < count else end) - now
+            for seq in self.receive(max(0.0, wait)):
+                sent_ns = pending.pop(seq, None)
+                if sent_ns is not None:
+                    rtts.append((time.perf_counter_ns() - sent_ns) / 1e6)
+        return rtts, sent
+
+
+def percentile(values, pct):
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+def report(label, rtts, sent):
+    lost = sent - len(rtts)
+    print(f"{label}: {len(rtts)}/{sent} echoed "
+          f"({100.0 * lost / sent:.1f}% lost)")
+    if not rtts:
+        return
+    rtts = sorted(rtts)
+    mean = sum(rtts) / len(rtts)
+    stdev = math.sqrt(sum((r - mean) ** 2 for r in rtts) / len(rtts))
+    print(f"  rtt ms  min {rtts[0]:.2f}  p50 {percentile(rtts, 50):.2f}  "
+          f"p90 {percentile(rtts, 90):.2f}  p99 {percentile(rtts, 99):.2f}  "
+          f"max {rtts[-1]:.2f}  stdev {stdev:.2f}")
+
+    counts = [0] * (len(BUCKETS_MS) + 1)
+    for r in rtts:
+        counts[next((i for i, b in enumerate(BUCKETS_MS) if r <= b),
+                    len(BUCKETS_MS))] += 1
+    widest = max(counts)
+    for i, n in enumerate(counts):
+        if n == 0:
+            continue
+        bound = (f"<= {BUCKETS_MS[i]:>3} ms" if i < len(BUCKETS_MS)
+                 else f" > {BUCKETS_MS[-1]:>3} ms")
+        bar = "#" * max(1, round(40 * n / widest))
+        print(f"  {bound} {n:6d} {bar}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=3333)
+    parser.add_argument("--count", type=int, default=500)
+    parser.add_argument("--interval", type=float, default=0.02,
+                        help="seconds between pings")
+    parser.add_argument("--timeout", type=float, default=1.0,
+                        help="seconds to wait for the last echoes")
+    parser.add_argument("--profiles", default="",
+                        help="comma separated: " + ", ".join(PROFILES))
+    parser.add_argument("--settle", type=float, default=2.0,
+                        help="seconds to wait after switching profile")
+    args = parser.parse_args()
+
+    names = [n for n in args.profiles.split(",") if n]
+    for name in names:
+        if name not in PROFILES:
+            parser.error(f"unknown profile {name!r}")
+
+    pinger = Pinger(args.host, args.port)
+    for name in names or [None]:
+        if name is not None:
+            if not pinger.set_profile(name):
+                print(f"{name}: no echo for the profile change, skipped")
+                continue
+            time.sleep(args.settle)
+        rtts, sent = pinger.ping(args.count, args.interval, args.timeout)
+        report(name or "current profile", rtts, sent)
+
+
+if __name__ == "__main__":
+    main()